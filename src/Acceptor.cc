@@ -10,13 +10,39 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
 
 Acceptor::Acceptor(EventLoop* loop, std::string ip, uint16_t port)
+    : Acceptor(loop, SockAddr(ip, port))
+{}
+
+Acceptor::Acceptor(EventLoop* loop, const SockAddr& listen_addr)
+    : loop_(loop)
+    , listen_addr_(listen_addr)
+    , listenfd_(create_and_bind_())
+    , listen_channel_(loop_, listenfd_)
+    , idlefd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , owns_path_(listen_addr_.is_unix() && !listen_addr_.is_abstract())
+{
+    listen_channel_.set_read_callback(std::bind(&Acceptor::handle_read_, this));
+}
+
+Acceptor::Acceptor(EventLoop* loop, int listenfd)
     : loop_(loop)
-    , listenfd_(create_and_bind_(std::move(ip), port))
+    , listenfd_(listenfd)
     , listen_channel_(loop_, listenfd_)
-    , idlefd_(::open("dev/null", O_RDONLY | O_CLOEXEC))
+    , idlefd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , owns_path_(false)
 {
+    socklen_t len = SockAddr::capacity();
+    if (::getsockname(listenfd_, listen_addr_.get_mutable(), &len) < 0)
+        handle_err("getsockname()");
+    listen_addr_.set_length(len);
+
+    /* 继承来的fd不一定是非阻塞的 */
+    int flags = ::fcntl(listenfd_, F_GETFL, 0);
+    ::fcntl(listenfd_, F_SETFL, flags | O_NONBLOCK);
+    ::fcntl(listenfd_, F_SETFD, FD_CLOEXEC);
     listen_channel_.set_read_callback(std::bind(&Acceptor::handle_read_, this));
 }
 
@@ -25,6 +51,10 @@ Acceptor::~Acceptor()
     listen_channel_.disable_all();
     ::close(listenfd_);
     ::close(idlefd_);
+    if (owns_path_)
+    {
+        ::unlink(listen_addr_.path().c_str());
+    }
 }
 
 void Acceptor::listen()
@@ -37,53 +67,78 @@ void Acceptor::listen()
     listen_channel_.enable_reading();
 }
 
-int Acceptor::create_and_bind_(std::string ip, uint16_t port)
+void Acceptor::stop()
+{
+    loop_->assert_in_loop_thread();
+    listen_channel_.disable_all();
+    owns_path_ = false;
+}
+
+int Acceptor::create_and_bind_()
 {
-    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    int sockfd = socket(listen_addr_.family(), SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
     if (sockfd < 0)
         handle_err("socket()");
     
-    int optval = 1;
-    ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &optval, static_cast<socklen_t>(sizeof(optval)));
-    ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, static_cast<socklen_t>(sizeof(optval)));
-    
-    struct sockaddr_in server_address;
-    memset(&server_address, 0, sizeof(server_address));
-    server_address.sin_family = AF_INET;
-    server_address.sin_port = static_cast<in_port_t>(htons(port));
-    inet_pton(AF_INET, ip.c_str(), &server_address.sin_addr);
-    // server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (listen_addr_.is_unix())
+    {
+        /* 上次运行遗留的socket文件会导致bind失败 */
+        if (!listen_addr_.is_abstract())
+        {
+            ::unlink(listen_addr_.path().c_str());
+        }
+    }
+    else
+    {
+        int optval = 1;
+        ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &optval, static_cast<socklen_t>(sizeof(optval)));
+        ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, static_cast<socklen_t>(sizeof(optval)));
+    }
 
-    int ret = ::bind(sockfd, reinterpret_cast<struct sockaddr*>(&server_address), sizeof(server_address));
+    int ret = ::bind(sockfd, listen_addr_.get(), listen_addr_.length());
     if (ret < 0)
         handle_err("bind()");
     
     return sockfd;
 }
 
+/* 边沿之外也可能积压了多个连接，一次处理到EAGAIN或者kMaxAcceptPerEvent个 */
 void Acceptor::handle_read_()
 {
     loop_->assert_in_loop_thread();
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = static_cast<socklen_t>(sizeof(client_addr));
-    
-    int clientfd = accept4(listenfd_, reinterpret_cast<struct sockaddr*>(&client_addr),
-        &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
-    if (clientfd < 0)
+    for (int i = 0; i < kMaxAcceptPerEvent; ++i)
     {
-        if (errno == EMFILE)
+        SockAddr client_addr;
+        socklen_t client_addr_len = SockAddr::capacity();
+
+        int clientfd = accept4(listenfd_, client_addr.get_mutable(), &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientfd < 0)
         {
-            ::close(idlefd_);
-            idlefd_ = ::accept(listenfd_, nullptr, nullptr);
-            ::close(idlefd_);
-            ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            int saved_errno = errno;
+            if (saved_errno == EMFILE || saved_errno == ENFILE)
+            {
+                /* fd用完了，腾出预留的idlefd接受并立即关闭这个连接，否则它会一直触发可读事件 */
+                ::close(idlefd_);
+                idlefd_ = ::accept(listenfd_, nullptr, nullptr);
+                if (idlefd_ >= 0)
+                {
+                    ::close(idlefd_);
+                }
+                idlefd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                printf("Acceptor::handle_read_(): %s, connection dropped\n", strerror(saved_errno));
+            }
+            else if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK && saved_errno != EINTR
+                && saved_errno != ECONNABORTED)
+            {
+                printf("accept4(): %s\n", strerror(saved_errno));
+            }
+            return;
         }
+
+        client_addr.set_length(client_addr_len);
+        if (new_connection_callback_)
+            new_connection_callback_(clientfd, client_addr);
         else
-            handle_err("accept4");
+            ::close(clientfd);
     }
-
-    if (new_connection_callback_)
-        new_connection_callback_(clientfd, client_addr);
-    else
-        ::close(clientfd);
-}
\ No newline at end of file
+}
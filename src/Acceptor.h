@@ -2,34 +2,47 @@
 
 #include "src/EventLoop.h"
 #include "src/Channel.h"
+#include "src/SockAddr.h"
+
+#include <sys/socket.h>
 
 class Acceptor
 {
 public:
-    using new_connection_callback = std::function<void(int sockfd, struct sockaddr_in addr)>;
+    using new_connection_callback = std::function<void(int sockfd, const SockAddr& addr)>;
     
     Acceptor(EventLoop* loop, std::string ip, uint16_t port);
+    Acceptor(EventLoop* loop, const SockAddr& listen_addr);
+    /* 接管一个已经bind（可能已经listen）的fd，例如从上一个进程继承来的，见ListenerHandoff */
+    Acceptor(EventLoop* loop, int listenfd);
     ~Acceptor();
 
     Acceptor(const Acceptor&) = delete;
     Acceptor& operator=(const Acceptor&) = delete;
 
     void listen();
+    /* 停止accept但不关闭fd，此后析构时也不删除socket文件，因为fd可能已经交给了其他进程 */
+    void stop();
+    int listen_fd() const { return listenfd_; }
+    const SockAddr& listen_addr() const { return listen_addr_; }
     void set_new_connection_callback(new_connection_callback cb)
     {
         new_connection_callback_ = std::move(cb);
     }
 
 private:
-    int create_and_bind_(std::string ip, uint16_t port);   /* socket -> bind */
+    int create_and_bind_();     /* socket -> bind */
     void handle_read_();         /* 处理监听套接字可读事件的回调函数，通常表示有新连接到来 */
 
 private:
-    static const int kMaxListen = 10;
+    static const int kMaxListen = SOMAXCONN;
+    static const int kMaxAcceptPerEvent = 64;  /* 每次可读事件最多accept的连接数，避免饿死其他事件 */
     
     EventLoop* loop_;           /* 所属EventLoop */
+    SockAddr listen_addr_;      /* 监听地址 */
     int listenfd_;              /* 监听套接字对应的fd */
     Channel listen_channel_;    /* 监听套接字对应的Channel */
     int idlefd_;                /* 用于防止fd达到上限新的用户无法连接的情况 */
+    bool owns_path_;            /* 析构时是否删除AF_UNIX的socket文件，只有自己bind的才删除 */
     new_connection_callback new_connection_callback_;   /* 新连接到来 如何处理 由TcpServer提供*/
 };
\ No newline at end of file
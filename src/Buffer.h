@@ -19,7 +19,7 @@
 class Buffer
 {
 public:
-    static const size_t kCheapPrepend = 8;
+    static const size_t kCheapPrepend = 16;     /* 放得下最长的WebSocket服务端帧头(10字节) */
     static const size_t kInitialSize = 1024;
 
     explicit Buffer(size_t initial_size = kInitialSize);
@@ -42,6 +42,11 @@ public:
         return begin() + reader_index_;
     }
 
+    char* peek()
+    {
+        return begin() + reader_index_;
+    }
+
     /* 回收len长度的空间 */
     void retrieve(size_t len)
     {
@@ -91,6 +96,24 @@ public:
         writer_index_ -= len;
     }
 
+    /* 删除可读数据中从offset开始的len个字节，后面的数据前移 */
+    void erase(size_t offset, size_t len)
+    {
+        assert(offset + len <= readable_bytes());
+        char* start = peek() + offset;
+        std::copy(start + len, begin_write(), start);
+        writer_index_ -= len;
+    }
+
+    /* 在可读数据之前写入数据，不移动可读数据，len不能超过prependable_bytes() */
+    void prepend(const void* data, size_t len)
+    {
+        assert(len <= prependable_bytes());
+        reader_index_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + reader_index_);
+    }
+
     std::string retrieve_all_as_string()
     {
         return retrieve_as_string(readable_bytes());
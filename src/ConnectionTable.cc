@@ -0,0 +1,32 @@
+#include "src/ConnectionTable.h"
+#include "src/TcpConnection.h"
+
+#include <algorithm>
+#include <cassert>
+
+uint32_t ConnectionTable::insert(const tcp_conn_ptr& conn)
+{
+    size_t fd = static_cast<size_t>(conn->fd());
+    if (fd >= slots_.size())
+    {
+        slots_.resize(std::max(fd + 1, slots_.size() * 2));
+    }
+
+    Slot& slot = slots_[fd];
+    assert(!slot.conn);
+    slot.conn = conn;
+    ++size_;
+    return ++slot.generation;
+}
+
+bool ConnectionTable::remove(int fd, uint32_t generation)
+{
+    size_t index = static_cast<size_t>(fd);
+    if (index >= slots_.size() || !slots_[index].conn || slots_[index].generation != generation)
+    {
+        return false;
+    }
+    slots_[index].conn.reset();
+    --size_;
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <vector>
+
+/**
+ *  每个IO线程一个的连接表，以fd为下标的数组，只在所属IO线程访问，不需要加锁
+ *
+ *  fd关闭后会被内核复用，每次插入时递增该槽位的generation，
+ *  remove时据此确认删除的还是原来那个连接，不会误删复用了同一个fd的新连接
+ */
+class ConnectionTable
+{
+public:
+    ConnectionTable() : size_(0) {}
+
+    ConnectionTable(const ConnectionTable&) = delete;
+    ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+    /* conn的fd对应的槽位必须为空，返回该连接的generation */
+    uint32_t insert(const tcp_conn_ptr& conn);
+    /* generation不匹配时不删除，返回false */
+    bool remove(int fd, uint32_t generation);
+
+    size_t size() const { return size_; }
+
+    template <typename Func>
+    void for_each(Func&& func) const
+    {
+        for (const Slot& slot : slots_)
+        {
+            if (slot.conn)
+            {
+                func(slot.conn);
+            }
+        }
+    }
+
+private:
+    struct Slot
+    {
+        tcp_conn_ptr conn;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Slot> slots_;
+    size_t size_;
+};
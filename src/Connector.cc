@@ -0,0 +1,210 @@
+#include "src/Connector.h"
+#include "src/Channel.h"
+#include "src/EventLoop.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+
+Connector::Connector(EventLoop* loop, const SockAddr& server_addr)
+    : loop_(loop)
+    , server_addr_(server_addr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , retry_(true)
+    , retry_delay_ms_(kInitRetryDelayMs)
+{}
+
+Connector::~Connector()
+{
+    assert(!channel_);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->run_in_loop(std::bind(&Connector::start_in_loop_, shared_from_this()));
+}
+
+void Connector::restart()
+{
+    loop_->assert_in_loop_thread();
+    set_state_(kDisconnected);
+    retry_delay_ms_ = kInitRetryDelayMs;
+    connect_ = true;
+    start_in_loop_();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queue_in_loop(std::bind(&Connector::stop_in_loop_, shared_from_this()), EventLoop::kUrgent);
+}
+
+void Connector::start_in_loop_()
+{
+    loop_->assert_in_loop_thread();
+    assert(state_ == kDisconnected);
+    if (connect_)
+    {
+        connect_to_server_();
+    }
+}
+
+void Connector::stop_in_loop_()
+{
+    loop_->assert_in_loop_thread();
+    if (retry_timer_)
+    {
+        loop_->cancel(retry_timer_);
+        retry_timer_.reset();
+    }
+    if (state_ == kConnecting)
+    {
+        set_state_(kDisconnected);
+        ::close(remove_and_reset_channel_());
+    }
+}
+
+void Connector::connect_to_server_()
+{
+    int sockfd = ::socket(server_addr_.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+        /* fd用完（EMFILE/ENFILE）不能让整个进程退出，当作一次连接失败：按退避重试或者交给失败回调 */
+        printf("Connector::connect_to_server_() socket: %s\n", strerror(errno));
+        schedule_retry_(-1);
+        return;
+    }
+
+    int ret = ::connect(sockfd, server_addr_.get(), server_addr_.length());
+    int saved_errno = (ret == 0) ? 0 : errno;
+    switch (saved_errno)
+    {
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting_(sockfd);
+        break;
+
+    /* 暂时性的错误，稍后重试 */
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+    case ENOENT:        /* AF_UNIX的socket文件还不存在 */
+        schedule_retry_(sockfd);
+        break;
+
+    default:
+        printf("Connector::connect_to_server_() to %s: %s\n", server_addr_.to_string().c_str(), strerror(saved_errno));
+        ::close(sockfd);
+        if (connect_failed_callback_)
+        {
+            connect_failed_callback_();
+        }
+        break;
+    }
+}
+
+/* 等待fd可写，可写时connect的结果由SO_ERROR给出 */
+void Connector::connecting_(int sockfd)
+{
+    set_state_(kConnecting);
+    assert(!channel_);
+    channel_ = std::make_unique<Channel>(loop_, sockfd);
+    channel_->set_write_callback(std::bind(&Connector::handle_write_, this));
+    channel_->tie(shared_from_this());
+    channel_->enable_writing();
+}
+
+int Connector::remove_and_reset_channel_()
+{
+    channel_->disable_all();
+    int sockfd = channel_->fd();
+    /* 此时可能正在Channel的回调中，不能直接析构 */
+    loop_->queue_in_loop(std::bind(&Connector::reset_channel_, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::reset_channel_()
+{
+    channel_.reset();
+}
+
+void Connector::handle_write_()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+
+    int sockfd = remove_and_reset_channel_();
+    int err = 0;
+    socklen_t len = static_cast<socklen_t>(sizeof(err));
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+    {
+        err = errno;
+    }
+
+    SockAddr local_addr;
+    SockAddr peer_addr;
+    socklen_t local_len = SockAddr::capacity();
+    socklen_t peer_len = SockAddr::capacity();
+    if (err == 0 && !server_addr_.is_unix()
+        && ::getsockname(sockfd, local_addr.get_mutable(), &local_len) == 0
+        && ::getpeername(sockfd, peer_addr.get_mutable(), &peer_len) == 0
+        && local_len == peer_len && memcmp(local_addr.get(), peer_addr.get(), local_len) == 0)
+    {
+        /* 连接本机未监听的端口时，可能连到自己（源端口恰好等于目标端口） */
+        printf("Connector: self connect to %s\n", server_addr_.to_string().c_str());
+        err = ECONNREFUSED;
+    }
+
+    if (err)
+    {
+        schedule_retry_(sockfd);
+    }
+    else
+    {
+        set_state_(kConnected);
+        if (connect_)
+        {
+            new_connection_callback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+/* sockfd小于0表示连socket都没有创建成功 */
+void Connector::schedule_retry_(int sockfd)
+{
+    if (sockfd >= 0)
+    {
+        ::close(sockfd);
+    }
+    set_state_(kDisconnected);
+    if (!connect_)
+    {
+        return;
+    }
+    if (!retry_)
+    {
+        if (connect_failed_callback_)
+        {
+            connect_failed_callback_();
+        }
+        return;
+    }
+
+    retry_timer_ = loop_->run_after(std::chrono::milliseconds(retry_delay_ms_),
+        std::bind(&Connector::start_in_loop_, shared_from_this()));
+    retry_delay_ms_ = std::min(retry_delay_ms_ * 2, kMaxRetryDelayMs);
+}
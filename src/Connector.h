@@ -0,0 +1,66 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/SockAddr.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ *  非阻塞connect，失败后按指数退避重试，连接建立后把fd交给new_connection_callback
+ *  由TcpClient和UpstreamPool使用，所有操作都在所属EventLoop中执行
+ */
+class Connector : public std::enable_shared_from_this<Connector>
+{
+public:
+    using new_connection_callback = std::function<void(int sockfd)>;
+    using connect_failed_callback = std::function<void()>;
+
+    Connector(EventLoop* loop, const SockAddr& server_addr);
+    ~Connector();
+
+    Connector(const Connector&) = delete;
+    Connector& operator=(const Connector&) = delete;
+
+    void set_new_connection_callback(new_connection_callback cb) { new_connection_callback_ = std::move(cb); }
+    /* 关闭重试时，连接失败后调用 */
+    void set_connect_failed_callback(connect_failed_callback cb) { connect_failed_callback_ = std::move(cb); }
+    /* 默认失败后一直重试 */
+    void set_retry(bool on) { retry_ = on; }
+
+    const SockAddr& server_addr() const { return server_addr_; }
+
+    void start();       /* 可以在任意线程调用 */
+    void restart();     /* 只能在所属EventLoop中调用，重置退避时间 */
+    void stop();        /* 可以在任意线程调用 */
+
+private:
+    enum states { kDisconnected, kConnecting, kConnected };
+
+    void set_state_(states s) { state_ = s; }
+    void start_in_loop_();
+    void stop_in_loop_();
+    void connect_to_server_();
+    void connecting_(int sockfd);
+    void handle_write_();
+    void schedule_retry_(int sockfd);
+    int remove_and_reset_channel_();
+    void reset_channel_();
+
+private:
+    static constexpr int kInitRetryDelayMs = 500;
+    static constexpr int kMaxRetryDelayMs = 30 * 1000;
+
+    EventLoop* loop_;
+    SockAddr server_addr_;
+    std::atomic<bool> connect_;         /* 是否需要连接，stop()后为false */
+    states state_;
+    std::unique_ptr<Channel> channel_;  /* 连接中的fd对应的Channel */
+    bool retry_;
+    int retry_delay_ms_;
+    TimerId retry_timer_;
+    new_connection_callback new_connection_callback_;
+    connect_failed_callback connect_failed_callback_;
+};
+
+using connector_ptr = std::shared_ptr<Connector>;
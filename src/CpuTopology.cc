@@ -0,0 +1,182 @@
+#include "src/CpuTopology.h"
+
+#include <sched.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <set>
+#include <map>
+#include <utility>
+
+int read_int_file(const char* path, int default_value)
+{
+    FILE* fp = ::fopen(path, "r");
+    if (!fp)
+    {
+        return default_value;
+    }
+    int value = default_value;
+    if (::fscanf(fp, "%d", &value) != 1)
+    {
+        value = default_value;
+    }
+    ::fclose(fp);
+    return value;
+}
+
+std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    else
+    {
+        long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < n; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> physical_core_cpus()
+{
+    /* (package, core) 相同的逻辑CPU是同一个物理核上的超线程 */
+    std::set<std::pair<int, int>> seen;
+    std::map<int, std::vector<int>> by_node;
+    char path[128];
+
+    for (int cpu : allowed_cpus())
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = read_int_file(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        int core = read_int_file(path, cpu);
+
+        if (seen.insert({package, core}).second)
+        {
+            by_node[cpu_numa_node(cpu)].push_back(cpu);
+        }
+    }
+
+    /* 按节点交错，这样只开少量线程时也能分散到各个节点 */
+    std::vector<int> cores;
+    for (size_t i = 0; ; ++i)
+    {
+        bool more = false;
+        for (const auto& node : by_node)
+        {
+            if (i < node.second.size())
+            {
+                cores.push_back(node.second[i]);
+                more = true;
+            }
+        }
+        if (!more)
+        {
+            break;
+        }
+    }
+    return cores;
+}
+
+int cpu_numa_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = ::opendir(path);
+    if (!dir)
+    {
+        return 0;
+    }
+
+    int node = 0;
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0)
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+int numa_node_count()
+{
+    DIR* dir = ::opendir("/sys/devices/system/node");
+    if (!dir)
+    {
+        return 1;
+    }
+
+    int count = 0;
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+        {
+            ++count;
+        }
+    }
+    ::closedir(dir);
+    return count > 0 ? count : 1;
+}
+
+bool bind_current_thread(const std::vector<int>& cpus)
+{
+    if (cpus.empty())
+    {
+        return true;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        printf("pthread_setaffinity_np(): %s\n", strerror(ret));
+    }
+    return ret == 0;
+}
+
+bool prefer_numa_node(int node)
+{
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8))
+    {
+        return false;
+    }
+
+    /* 没有依赖libnuma，直接调用set_mempolicy系统调用 */
+    unsigned long mask = 1UL << node;
+    long ret = ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8);
+    if (ret != 0)
+    {
+        printf("set_mempolicy(): %s\n", strerror(errno));
+    }
+    return ret == 0;
+}
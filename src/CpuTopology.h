@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+/**
+ *  从/sys/devices/system/cpu读取CPU拓扑，用于IO线程绑核
+ *  读取失败时退化为"每个可用CPU都是一个物理核、只有一个NUMA节点"
+ */
+
+/* 当前进程允许运行的CPU */
+std::vector<int> allowed_cpus();
+
+/* 每个物理核取一个逻辑CPU（超线程的兄弟CPU被跳过），按NUMA节点交错排列 */
+std::vector<int> physical_core_cpus();
+
+/* cpu所在的NUMA节点，未知时返回0 */
+int cpu_numa_node(int cpu);
+
+/* 系统中的NUMA节点数 */
+int numa_node_count();
+
+/* 将调用线程绑定到cpus上，cpus为空时什么也不做 */
+bool bind_current_thread(const std::vector<int>& cpus);
+
+/* 调用线程之后分配的内存优先落在node节点上 */
+bool prefer_numa_node(int node);
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <sys/epoll.h>
 #include <string.h>
+#include <errno.h>
 
 const int kNew = -1;
 const int kAdded = 1;
@@ -22,11 +23,16 @@ EpollPoller::~EpollPoller()
     ::close(epollfd_);
 }
 
-void EpollPoller::poller(channel_list& active_channels)
+void EpollPoller::poller(channel_list& active_channels, int timeout_ms)
 {    
-    int nums = epoll_wait(epollfd_, events_.data(), static_cast<int>(events_.size()), -1);
+    int nums = epoll_wait(epollfd_, events_.data(), static_cast<int>(events_.size()), timeout_ms);
     if (nums < 0)
+    {
+        /* 被信号打断（例如LoopWatchdog打印调用栈）不是错误，当作没有事件 */
+        if (errno == EINTR)
+            return;
         handle_err("epoll_wait");
+    }
 
     /* 将所有活动fd转为对应的Channel */
     for (int i = 0; i < nums; ++i)
@@ -48,6 +54,11 @@ void EpollPoller::update_channel(Channel* channel)
     const int idx = channel->index();
     if (idx == kNew || idx == kDeleted)
     {
+        /* 没有关注任何事件时不加入epoll，否则EPOLLHUP会不停地触发 */
+        if (channel->is_none_event())
+        {
+            return;
+        }
         channel->set_index(kAdded);
         update_(EPOLL_CTL_ADD, channel);
     }
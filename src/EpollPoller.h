@@ -15,8 +15,9 @@ public:
     EpollPoller(const EpollPoller&) = delete;
     EpollPoller& operator=(const EpollPoller&) = delete;
 
-    void poller(channel_list& active_channels);
+    void poller(channel_list& active_channels, int timeout_ms = -1);
     void update_channel(Channel* channel);
+    int fd() const { return epollfd_; }
 
 private:
     void update_(int operation, Channel* channel);
@@ -6,6 +6,7 @@
 #include <signal.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
+#include <algorithm>
 
 #pragma GCC diagnostic ignored "-Wold-style-cast"
 class IgnoreSigPipe
@@ -32,6 +33,11 @@ int create_eventfd()
 
 thread_local EventLoop* t_loop_in_this_thread = nullptr;
 
+uint64_t to_ns(timer_clock::duration d)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
 EventLoop::EventLoop()
     : quit_(false)
     , thread_id_(thread_id())
@@ -40,6 +46,8 @@ EventLoop::EventLoop()
     , wakeupfd_(create_eventfd())
     , wakeup_channel_(std::make_unique<Channel>(this, wakeupfd_))
     , calling_pending_functors_(false)
+    , has_urgent_(false)
+    , bulk_budget_(std::chrono::milliseconds(1))
 {
     if (t_loop_in_this_thread)
     {
@@ -51,6 +59,7 @@ EventLoop::EventLoop()
     {
         t_loop_in_this_thread = this;
     }
+    heartbeat_.tid.store(thread_id_, std::memory_order_relaxed);
 
     wakeup_channel_->set_read_callback(std::bind(&EventLoop::handle_read_, this));
     wakeup_channel_->enable_reading();
@@ -67,21 +76,46 @@ void EventLoop::loop()
 {
     assert_in_loop_thread();
     quit_.store(false, std::memory_order_relaxed);
+    EventLoopStats& stats = stats_.local();
+    timer_clock::time_point poll_start = timer_clock::now();
     
     while (!quit_)
     {
 
         active_channels_.clear();
-        poller_->poller(active_channels_);
+        heartbeat_.enter_poll();
+        /* 还有积压的bulk任务时不阻塞，处理完IO事件后继续执行 */
+        poller_->poller(active_channels_, bulk_backlog_.empty() ? -1 : 0);
+        timer_clock::time_point poll_end = timer_clock::now();
+        heartbeat_.leave_poll(poll_end);
 
         /* 对所有活动Channel调用处理函数 */
         for (Channel* channel : active_channels_)
         {
+            heartbeat_.set_channel(channel->fd());
             channel->handle_event();
         }
+        timer_clock::time_point channels_end = timer_clock::now();
         
         do_pending_functors_();
+        timer_clock::time_point iteration_end = timer_clock::now();
+
+        /* 统计只做本地累加，每轮发布一次 */
+        uint64_t busy_ns = to_ns(iteration_end - poll_end);
+        ++stats.iterations;
+        stats.events += active_channels_.size();
+        ++stats.events_histogram[EventLoopStats::events_bucket(active_channels_.size())];
+        stats.blocked_ns += to_ns(poll_end - poll_start);
+        stats.busy_ns += busy_ns;
+        ++stats.busy_histogram[EventLoopStats::busy_bucket(busy_ns)];
+        stats.channel_ns += to_ns(channels_end - poll_end);
+        stats.functor_ns += to_ns(iteration_end - channels_end);
+        stats.timers_fired = timer_queue_->fired_count();
+        stats_.publish();
+
+        poll_start = iteration_end;
     }
+    heartbeat_.enter_poll();
 }
 
 void EventLoop::update_channel(Channel* channel)
@@ -99,6 +133,13 @@ void EventLoop::quit()
     }
 }
 
+void EventLoop::close_after_fork()
+{
+    ::close(poller_->fd());
+    ::close(timer_queue_->fd());
+    ::close(wakeupfd_);
+}
+
 TimerId EventLoop::run_at(timer_clock::time_point time, timer_callback cb)
 {
     return timer_queue_->add_timer(std::move(cb), time, timer_clock::duration::zero());
@@ -119,7 +160,7 @@ void EventLoop::cancel(TimerId timerid)
     timer_queue_->cancel(timerid);
 }
 
-void EventLoop::run_in_loop(functor cb)
+void EventLoop::run_in_loop(functor cb, functor_priority priority)
 {
     // 如果是当前线程调用这个函数，则同步执行
     if (is_in_loop_thread())
@@ -129,15 +170,19 @@ void EventLoop::run_in_loop(functor cb)
     // 如果在其他线程中调用这个函数，则将cb加入队列
     else
     {
-        queue_in_loop(std::move(cb));
+        queue_in_loop(std::move(cb), priority);
     }
 }
 
-void EventLoop::queue_in_loop(functor cb)
+void EventLoop::queue_in_loop(functor cb, functor_priority priority)
 {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        pending_functors_.push_back(std::move(cb));
+        pending_functors_[priority].push_back(std::move(cb));
+    }
+    if (priority == kUrgent)
+    {
+        has_urgent_.store(true, std::memory_order_release);
     }
 
     /**
@@ -175,22 +220,89 @@ void EventLoop::handle_read_()
     if (n != sizeof(one))
     {
         printf("EventLoop::handle_read_() writes %ld bytes instead of 8\n", n);
-    }    
+    }
+    ++stats_.local().wakeups;
 }
 
 void EventLoop::do_pending_functors_()
 {
-    std::vector<functor> functors;
+    std::vector<functor> functors[kNumPriorities];
     calling_pending_functors_ = true;
     
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        functors.swap(pending_functors_);
+        for (int i = 0; i < kNumPriorities; ++i)
+        {
+            functors[i].swap(pending_functors_[i]);
+        }
+        has_urgent_.store(false, std::memory_order_relaxed);
     }
 
-    for (const functor& f : functors)
+    EventLoopStats& stats = stats_.local();
+    stats.pending_depth = functors[kUrgent].size() + functors[kNormal].size() + functors[kBulk].size()
+        + bulk_backlog_.size();
+    stats.max_pending_depth = std::max(stats.max_pending_depth, stats.pending_depth);
+    stats.functors += functors[kUrgent].size() + functors[kNormal].size();
+
+    for (const functor& f : functors[kUrgent])
     {
+        heartbeat_.set_functor(f.target_type());
         f();
     }
+    for (const functor& f : functors[kNormal])
+    {
+        heartbeat_.set_functor(f.target_type());
+        f();
+    }
+
+    for (functor& f : functors[kBulk])
+    {
+        bulk_backlog_.push_back(std::move(f));
+    }
+
+    /**
+     * bulk任务按预算执行，每执行kCheckInterval个检查一次时间，
+     * 同时看看有没有新到的urgent任务，有就先执行
+     */
+    const size_t kCheckInterval = 16;
+    const timer_clock::time_point deadline = timer_clock::now() + bulk_budget_;
+    size_t count = 0;
+    while (!bulk_backlog_.empty())
+    {
+        functor f = std::move(bulk_backlog_.front());
+        bulk_backlog_.pop_front();
+        heartbeat_.set_functor(f.target_type());
+        f();
+        ++stats.functors;
+
+        if (++count % kCheckInterval == 0)
+        {
+            if (has_urgent_.load(std::memory_order_acquire))
+            {
+                run_urgent_functors_();
+            }
+            if (timer_clock::now() >= deadline)
+            {
+                break;
+            }
+        }
+    }
     calling_pending_functors_ = false;
-}
\ No newline at end of file
+}
+
+void EventLoop::run_urgent_functors_()
+{
+    std::vector<functor> functors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        functors.swap(pending_functors_[kUrgent]);
+        has_urgent_.store(false, std::memory_order_relaxed);
+    }
+
+    stats_.local().functors += functors.size();
+    for (const functor& f : functors)
+    {
+        heartbeat_.set_functor(f.target_type());
+        f();
+    }
+}
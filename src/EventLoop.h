@@ -1,8 +1,11 @@
 #pragma once
 
 #include "src/common.h"
+#include "src/EventLoopStats.h"
+#include "src/LoopHeartbeat.h"
 
 #include <atomic>
+#include <deque>
 #include <mutex>
 
 class EpollPoller;
@@ -13,6 +16,15 @@ class EventLoop
 {
 public:
     using functor = std::function<void()>;
+
+    /* 跨线程投递任务的优先级 */
+    enum functor_priority
+    {
+        kUrgent,    /* 控制类任务：建立/关闭连接、取消定时器，每轮最先执行 */
+        kNormal,
+        kBulk,      /* 大批量任务（跨线程send），每轮只在时间预算内执行，其余留到下一轮 */
+        kNumPriorities
+    };
     
     EventLoop();
     ~EventLoop();
@@ -23,6 +35,11 @@ public:
     void loop();
     void update_channel(Channel* Channel);
     void quit();
+    /**
+     *  fork出的子进程不再使用继承来的EventLoop时调用，只关闭epoll、eventfd和timerfd，
+     *  之后这个EventLoop不能再使用，也不能析构（子进程最终以_exit退出）
+     */
+    void close_after_fork();
 
     /* 定时器相关 */
     TimerId run_at(timer_clock::time_point time, timer_callback cb);
@@ -30,10 +47,19 @@ public:
     TimerId run_every(timer_clock::duration interval, timer_callback cb);
     void cancel(TimerId timerid);
 
-    void run_in_loop(functor cb);
-    void queue_in_loop(functor cb);
+    void run_in_loop(functor cb, functor_priority priority = kNormal);
+    void queue_in_loop(functor cb, functor_priority priority = kNormal);
     void wakeup();
 
+    /* 每轮循环执行kBulk任务的时间预算，超出后先回到epoll处理IO事件 */
+    void set_bulk_budget(timer_clock::duration budget) { bulk_budget_ = budget; }
+
+    /* 可以在任意线程调用，返回最近一轮循环结束时的统计 */
+    EventLoopStats stats() const { return stats_.snapshot(); }
+
+    /* IO线程更新、LoopWatchdog读取的心跳 */
+    LoopHeartbeat& heartbeat() { return heartbeat_; }
+
     void assert_in_loop_thread()
     {
         if (!is_in_loop_thread())
@@ -47,6 +73,7 @@ private:
     bool abort_not_in_loop_thread_();
     void handle_read_();
     void do_pending_functors_();
+    void run_urgent_functors_();
 
 private:
     std::atomic<bool> quit_;
@@ -60,5 +87,10 @@ private:
     
     mutable std::mutex mutex_;
     bool calling_pending_functors_;             /* 用于标识是否正在执行do_pending_functors_()函数 */
-    std::vector<functor> pending_functors_;
+    std::vector<functor> pending_functors_[kNumPriorities];    /* 每个优先级一个队列 */
+    std::atomic<bool> has_urgent_;              /* kUrgent队列非空，执行bulk任务时据此插队 */
+    std::deque<functor> bulk_backlog_;          /* 上一轮没在预算内执行完的kBulk任务，只在IO线程访问 */
+    timer_clock::duration bulk_budget_;
+    EventLoopStatsRecorder stats_;              /* 运行统计，只有IO线程更新 */
+    LoopHeartbeat heartbeat_;
 };
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/* EventLoop运行统计的快照，时间单位都是纳秒，计数都是从EventLoop创建开始累计 */
+struct EventLoopStats
+{
+    /* 每次epoll_wait返回事件数的直方图：0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, >=64 */
+    static const int kEventBuckets = 8;
+    /* 每轮循环忙碌时间的直方图：<10us, <100us, <1ms, <10ms, <100ms, >=100ms */
+    static const int kBusyBuckets = 6;
+
+    uint64_t iterations = 0;            /* 循环次数，即epoll_wait调用次数 */
+    uint64_t events = 0;                /* epoll_wait返回的事件总数 */
+    uint64_t events_histogram[kEventBuckets] = {};
+    uint64_t blocked_ns = 0;            /* 阻塞在epoll_wait中的时间 */
+    uint64_t busy_ns = 0;               /* epoll_wait之外的时间 */
+    uint64_t busy_histogram[kBusyBuckets] = {};
+    uint64_t channel_ns = 0;            /* Channel回调（包括定时器回调）花费的时间 */
+    uint64_t functor_ns = 0;            /* do_pending_functors_花费的时间 */
+    uint64_t functors = 0;              /* 执行的pending functor数 */
+    uint64_t pending_depth = 0;         /* 最近一次do_pending_functors_开始时的队列长度 */
+    uint64_t max_pending_depth = 0;
+    uint64_t wakeups = 0;               /* 被wakeup()唤醒的次数 */
+    uint64_t timers_fired = 0;          /* 到期执行的定时器数 */
+
+    static int events_bucket(size_t n)
+    {
+        int bucket = 0;
+        while (n > 0 && bucket < kEventBuckets - 1)
+        {
+            n >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    static int busy_bucket(uint64_t ns)
+    {
+        int bucket = 0;
+        for (uint64_t limit = 10000; ns >= limit && bucket < kBusyBuckets - 1; limit *= 10)
+        {
+            ++bucket;
+        }
+        return bucket;
+    }
+};
+
+/**
+ *  只有IO线程写、任意线程读的统计
+ *  IO线程在local()上做普通的累加，每轮循环末尾publish()一次，
+ *  publish用seqlock保护，读者不加锁也能拿到同一轮循环的一致快照
+ */
+class EventLoopStatsRecorder
+{
+public:
+    EventLoopStatsRecorder()
+        : seq_(0)
+    {
+        for (auto& field : published_)
+        {
+            field.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    EventLoopStatsRecorder(const EventLoopStatsRecorder&) = delete;
+    EventLoopStatsRecorder& operator=(const EventLoopStatsRecorder&) = delete;
+
+    EventLoopStats& local() { return local_; }
+
+    void publish()
+    {
+        uint64_t fields[kNumFields];
+        memcpy(fields, &local_, sizeof(fields));
+
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kNumFields; ++i)
+        {
+            published_[i].store(fields[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    EventLoopStats snapshot() const
+    {
+        uint64_t fields[kNumFields];
+        uint32_t before;
+        uint32_t after;
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kNumFields; ++i)
+            {
+                fields[i] = published_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        EventLoopStats stats;
+        memcpy(&stats, fields, sizeof(fields));
+        return stats;
+    }
+
+private:
+    static const size_t kNumFields = sizeof(EventLoopStats) / sizeof(uint64_t);
+    static_assert(sizeof(EventLoopStats) == kNumFields * sizeof(uint64_t), "EventLoopStats must only contain uint64_t");
+
+    EventLoopStats local_;
+    std::atomic<uint32_t> seq_;
+    std::atomic<uint64_t> published_[kNumFields];
+};
@@ -1,16 +1,26 @@
 #include "src/EventLoopThread.h"
 #include "src/EventLoop.h"
+#include "src/CpuTopology.h"
 
-EventLoopThread::EventLoopThread(thread_init_callback cb)
+EventLoopThread::EventLoopThread(thread_init_callback cb, std::string name, std::vector<int> cpus)
     : loop_(nullptr)
     , callback_(std::move(cb))
+    , name_(std::move(name))
+    , cpus_(std::move(cpus))
 {}
 
 EventLoopThread::~EventLoopThread()
 {
-    if (loop_ != nullptr)
     {
-        loop_->quit();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loop_ != nullptr)
+        {
+            loop_->quit();
+        }
+    }
+    /* loop可能已经被别人quit，线程已经退出，但仍然要join */
+    if (thread_.joinable())
+    {
         thread_.join();
     }
 }
@@ -31,8 +41,34 @@ EventLoop* EventLoopThread::start_loop()
     return loop;
 }
 
+/* loop_在锁内置空之后EventLoop才析构，所以持锁时看到的loop_一定还有效 */
+bool EventLoopThread::queue_in_loop(std::function<void()> cb)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loop_ == nullptr)
+    {
+        return false;
+    }
+    loop_->queue_in_loop(std::move(cb));
+    return true;
+}
+
 void EventLoopThread::thread_func()
 {
+    if (!name_.empty())
+    {
+        set_thread_name(name_);
+    }
+
+    /**
+     * 先绑核再创建EventLoop，这样EventLoop以及之后在这个线程中分配的内存
+     * （连接对象、缓冲区）都优先落在这个核所在的NUMA节点上
+     */
+    if (!cpus_.empty() && bind_current_thread(cpus_) && numa_node_count() > 1)
+    {
+        prefer_numa_node(cpu_numa_node(cpus_.front()));
+    }
+
     EventLoop loop;
     
     if (callback_)
@@ -3,6 +3,8 @@
 #include "src/common.h"
 
 #include <functional>
+#include <string>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -12,13 +14,16 @@ class EventLoop;
 class EventLoopThread
 {
 public:
-    EventLoopThread(thread_init_callback cb = thread_init_callback());
+    EventLoopThread(thread_init_callback cb = thread_init_callback(),
+        std::string name = std::string(), std::vector<int> cpus = std::vector<int>());
     ~EventLoopThread();
 
     EventLoopThread(const EventLoopThread&) = delete;
     EventLoopThread& operator=(const EventLoopThread&) = delete;
     
     EventLoop* start_loop();            // 启动线程，启动之后，该线程成为IO线程
+    /* 向IO线程投递任务，loop已经退出（线程结束、EventLoop已经析构）时不投递，返回false */
+    bool queue_in_loop(std::function<void()> cb);
 
 private:
     void thread_func();
@@ -29,4 +34,6 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     thread_init_callback callback_;     // 回调函数在EventLoop::loop事件循环之前被调用
+    std::string name_;                  // 线程名
+    std::vector<int> cpus_;             // 绑定的CPU，为空则不绑核
 };
\ No newline at end of file
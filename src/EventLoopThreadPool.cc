@@ -1,5 +1,7 @@
 #include "src/EventLoopThreadPool.h"
 #include "src/EventLoopThread.h"
+#include "src/EventLoop.h"
+#include "src/CpuTopology.h"
 
 #include <cassert>
 
@@ -7,6 +9,8 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop)
     : baseloop_(baseloop)
     , started_(false)
     , num_threads_(0)
+    , name_("io")
+    , pin_per_core_(false)
     , next_(0)
 {}
 
@@ -17,9 +21,27 @@ void EventLoopThreadPool::start(const thread_init_callback& cb)
 {
     started_ = true;
 
+    if (pin_per_core_)
+    {
+        cpu_sets_.clear();
+        for (int cpu : physical_core_cpus())
+        {
+            cpu_sets_.push_back(std::vector<int>(1, cpu));
+        }
+        if (num_threads_ == 0)
+        {
+            num_threads_ = static_cast<int>(cpu_sets_.size());
+        }
+    }
+
     for (int i = 0; i < num_threads_; ++i)
     {
-        EventLoopThread* t = new EventLoopThread(cb);
+        std::vector<int> cpus;
+        if (!cpu_sets_.empty())
+        {
+            cpus = cpu_sets_[i % cpu_sets_.size()];
+        }
+        EventLoopThread* t = new EventLoopThread(cb, name_ + "-" + std::to_string(i), std::move(cpus));
         threads_.emplace_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->start_loop());
     }
@@ -58,6 +80,20 @@ EventLoop* EventLoopThreadPool::get_loop_for_hash(size_t hash_code)
     return loop;    
 }
 
+bool EventLoopThreadPool::queue_in_loop(EventLoop* loop, std::function<void()> cb)
+{
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        if (loops_[i] == loop)
+        {
+            return threads_[i]->queue_in_loop(std::move(cb));
+        }
+    }
+    assert(loop == baseloop_);
+    baseloop_->queue_in_loop(std::move(cb));
+    return true;
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::get_all_loops()
 {
     assert(started_);
@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <string>
 
 class EventLoop;
 class EventLoopThread;
@@ -19,12 +20,29 @@ public:
     EventLoopThreadPool& operator=(const EventLoopThreadPool&) = delete;
 
     void set_thread_num(int num_threads) { num_threads_ = num_threads; }
+
+    /* IO线程名为 name-序号，默认为 io-0, io-1 ... */
+    void set_name(std::string name) { name_ = std::move(name); }
+
+    /* 第i个IO线程绑定到cpu_sets[i % cpu_sets.size()] */
+    void set_cpu_affinity(std::vector<std::vector<int>> cpu_sets) { cpu_sets_ = std::move(cpu_sets); }
+
+    /**
+     * 每个IO线程绑定到一个物理核，超线程的兄弟CPU不使用
+     * 如果没有调用set_thread_num，则每个物理核启动一个IO线程
+     */
+    void set_pin_per_core(bool on) { pin_per_core_ = on; }
     void start(const thread_init_callback& cb = thread_init_callback());
 
     EventLoop* get_next_loop();
     EventLoop* get_loop_for_hash(size_t hash_code);
 
     std::vector<EventLoop*> get_all_loops();
+    /**
+     *  向get_all_loops()中的loop投递任务，可以在任意线程调用
+     *  IO线程的loop已经退出时不投递，返回false；loop退出时还没执行的任务直接析构，不会执行
+     */
+    bool queue_in_loop(EventLoop* loop, std::function<void()> cb);
 
     bool started() const { return started_; }
 
@@ -32,6 +50,9 @@ private:
     EventLoop* baseloop_;
     bool started_;
     int num_threads_;
+    std::string name_;
+    bool pin_per_core_;
+    std::vector<std::vector<int>> cpu_sets_;
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
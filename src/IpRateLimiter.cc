@@ -0,0 +1,101 @@
+#include "src/IpRateLimiter.h"
+
+#include <netinet/in.h>
+#include <algorithm>
+
+IpRateLimiter::IpRateLimiter(double rate, double burst)
+    : rate_(rate)
+    , burst_(std::max(burst, 1.0))
+    , overflow_{0, burst_, timer_clock::now()}
+{}
+
+/* 按网络字节序把地址的len个字节拼成整数，结果与主机字节序无关 */
+uint64_t big_endian_key(const unsigned char* bytes, size_t len)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        key = key << 8 | bytes[i];
+    }
+    return key;
+}
+
+bool IpRateLimiter::key_of_(const SockAddr& addr, uint64_t* key)
+{
+    /* IPv4地址的key是0000:ffff:a.b.c.d，落在保留的::/8前缀中，不会和真实的IPv6 /64前缀冲突 */
+    if (addr.family() == AF_INET)
+    {
+        const struct sockaddr_in* addr4 = reinterpret_cast<const struct sockaddr_in*>(addr.get());
+        *key = 0xffff00000000ULL | big_endian_key(reinterpret_cast<const unsigned char*>(&addr4->sin_addr), 4);
+        return true;
+    }
+    if (addr.family() == AF_INET6)
+    {
+        const struct sockaddr_in6* addr6 = reinterpret_cast<const struct sockaddr_in6*>(addr.get());
+        const unsigned char* bytes = addr6->sin6_addr.s6_addr;
+        /* 双栈监听时IPv4客户端的地址是::ffff:a.b.c.d，按IPv4计算，否则它们的/64前缀全是0 */
+        if (IN6_IS_ADDR_V4MAPPED(&addr6->sin6_addr))
+        {
+            *key = 0xffff00000000ULL | big_endian_key(bytes + 12, 4);
+        }
+        else
+        {
+            *key = big_endian_key(bytes, 8);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool IpRateLimiter::allow(const SockAddr& addr, timer_clock::time_point now)
+{
+    uint64_t ip;
+    if (!key_of_(addr, &ip))
+    {
+        return true;
+    }
+
+    auto it = buckets_.find(ip);
+    if (it != buckets_.end())
+    {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return take_(*it->second, now);
+    }
+
+    evict_(now);
+    if (buckets_.size() >= kMaxTracked)
+    {
+        return take_(overflow_, now);
+    }
+    lru_.push_front(Bucket{ip, burst_ - 1, now});
+    buckets_.emplace(ip, lru_.begin());
+    return true;
+}
+
+bool IpRateLimiter::take_(Bucket& bucket, timer_clock::time_point now)
+{
+    bucket.tokens = refill_(bucket, now);
+    bucket.last = now;
+    if (bucket.tokens < 1)
+    {
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+double IpRateLimiter::refill_(const Bucket& bucket, timer_clock::time_point now) const
+{
+    double elapsed = std::chrono::duration<double>(now - bucket.last).count();
+    return std::min(burst_, bucket.tokens + elapsed * rate_);
+}
+
+/* 从最久没用的一端删除令牌已经补满的桶，遇到没满的就停下 */
+void IpRateLimiter::evict_(timer_clock::time_point now)
+{
+    for (size_t i = 0; i < kEvictBatch && !lru_.empty() && refill_(lru_.back(), now) >= burst_; ++i)
+    {
+        buckets_.erase(lru_.back().ip);
+        lru_.pop_back();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/SockAddr.h"
+
+#include <list>
+#include <unordered_map>
+
+/**
+ *  按来源IP的令牌桶限速，每个IP每秒补充rate个令牌，最多积累burst个，每个新连接消耗一个
+ *  只在base loop（接受连接的线程）中使用
+ *
+ *  桶按最近使用的顺序排成链表，每来一个新IP就从最久没用的一端清理最多kEvictBatch个令牌已经补满的桶
+ *  （它们和新建的桶没有区别），所以内存只和最近活跃的IP数有关，每次调用的开销是常数；
+ *  kMaxTracked个桶都还在活跃时，新的IP共用一个溢出桶，不再单独记录
+ */
+class IpRateLimiter
+{
+public:
+    IpRateLimiter(double rate, double burst);
+
+    IpRateLimiter(const IpRateLimiter&) = delete;
+    IpRateLimiter& operator=(const IpRateLimiter&) = delete;
+
+    /* AF_UNIX总是允许，IPv6按/64前缀计算（同一主机通常分到整个/64） */
+    bool allow(const SockAddr& addr, timer_clock::time_point now);
+    size_t tracked() const { return buckets_.size(); }
+
+private:
+    struct Bucket
+    {
+        uint64_t ip;
+        double tokens;
+        timer_clock::time_point last;   /* 上次补充令牌的时刻 */
+    };
+
+    static bool key_of_(const SockAddr& addr, uint64_t* key);
+    double refill_(const Bucket& bucket, timer_clock::time_point now) const;
+    bool take_(Bucket& bucket, timer_clock::time_point now);
+    void evict_(timer_clock::time_point now);
+
+private:
+    static const size_t kMaxTracked = 65536;
+    static const size_t kEvictBatch = 2;
+
+    const double rate_;
+    const double burst_;
+    std::list<Bucket> lru_;             /* 最近使用的在前面 */
+    std::unordered_map<uint64_t, std::list<Bucket>::iterator> buckets_;
+    Bucket overflow_;                   /* 桶满时新IP共用的桶 */
+};
@@ -0,0 +1,227 @@
+#include "src/ListenerHandoff.h"
+#include "src/Acceptor.h"
+#include "src/Channel.h"
+#include "src/EventLoop.h"
+#include "src/TcpServer.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std::placeholders;
+
+/* 一次最多传递的fd数 */
+const size_t kMaxHandoffFds = 16;
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+/* 正文是fd的个数，fd本身放在SCM_RIGHTS控制消息中 */
+bool send_fds(int sockfd, const std::vector<int>& fds)
+{
+    if (fds.empty() || fds.size() > kMaxHandoffFds)
+    {
+        return false;
+    }
+
+    uint32_t count = static_cast<uint32_t>(fds.size());
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxHandoffFds)];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    return ::sendmsg(sockfd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(count));
+}
+
+std::vector<int> recv_fds(int sockfd)
+{
+    std::vector<int> fds;
+    uint32_t count = 0;
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = sizeof(count);
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxHandoffFds)];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if (n != static_cast<ssize_t>(sizeof(count)))
+    {
+        return fds;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            fds.resize(num);
+            memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * num);
+        }
+    }
+    if (fds.size() != count)
+    {
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+        fds.clear();
+    }
+    return fds;
+}
+#pragma GCC diagnostic error "-Wold-style-cast"
+
+ListenerHandoff::ListenerHandoff(EventLoop* loop, const SockAddr& control_addr)
+    : loop_(loop)
+    , control_addr_(control_addr)
+    , takeover_fd_(-1)
+    , control_fd_(-1)
+{}
+
+ListenerHandoff::~ListenerHandoff()
+{
+    if (takeover_fd_ >= 0)
+    {
+        ::close(takeover_fd_);
+    }
+    if (control_fd_ >= 0)
+    {
+        close_control_();
+    }
+}
+
+std::vector<int> ListenerHandoff::take_over()
+{
+    int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+        handle_err("socket()");
+
+    /* 连不上说明没有正在运行的旧进程 */
+    if (::connect(sockfd, control_addr_.get(), control_addr_.length()) < 0)
+    {
+        ::close(sockfd);
+        return std::vector<int>();
+    }
+
+    struct timeval timeout = {kTakeOverTimeoutSeconds, 0};
+    ::setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, static_cast<socklen_t>(sizeof(timeout)));
+    std::vector<int> fds = recv_fds(sockfd);
+    if (fds.empty())
+    {
+        printf("ListenerHandoff::take_over(): no listening fds received from %s\n", control_addr_.to_string().c_str());
+        ::close(sockfd);
+        return fds;
+    }
+
+    takeover_fd_ = sockfd;
+    return fds;
+}
+
+void ListenerHandoff::confirm()
+{
+    if (takeover_fd_ < 0)
+    {
+        return;
+    }
+    char ack = 'R';
+    if (::send(takeover_fd_, &ack, sizeof(ack), MSG_NOSIGNAL) != sizeof(ack))
+    {
+        printf("ListenerHandoff::confirm(): %s\n", strerror(errno));
+    }
+    ::close(takeover_fd_);
+    takeover_fd_ = -1;
+}
+
+void ListenerHandoff::serve(std::vector<TcpServer*> servers, handoff_callback cb)
+{
+    loop_->assert_in_loop_thread();
+    servers_ = std::move(servers);
+    handoff_callback_ = std::move(cb);
+    acceptor_ = std::make_unique<Acceptor>(loop_, control_addr_);
+    acceptor_->set_new_connection_callback(std::bind(&ListenerHandoff::handle_new_connection_, this, _1));
+    acceptor_->listen();
+}
+
+void ListenerHandoff::handle_new_connection_(int sockfd)
+{
+    /* 同一时刻只处理一个接管请求 */
+    if (control_fd_ >= 0)
+    {
+        ::close(sockfd);
+        return;
+    }
+
+    std::vector<int> fds;
+    for (TcpServer* server : servers_)
+    {
+        fds.push_back(server->listen_fd());
+    }
+    if (!send_fds(sockfd, fds))
+    {
+        printf("ListenerHandoff: failed to send listening fds: %s\n", strerror(errno));
+        ::close(sockfd);
+        return;
+    }
+
+    control_fd_ = sockfd;
+    control_channel_ = std::make_unique<Channel>(loop_, control_fd_);
+    control_channel_->set_read_callback(std::bind(&ListenerHandoff::handle_control_read_, this));
+    control_channel_->enable_reading();
+}
+
+void ListenerHandoff::handle_control_read_()
+{
+    char ack = 0;
+    ssize_t n = ::read(control_fd_, &ack, sizeof(ack));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+
+    /* 不能在Channel自己的回调中析构它 */
+    control_channel_->disable_all();
+    loop_->queue_in_loop(std::bind(&ListenerHandoff::close_control_, this));
+    if (n != sizeof(ack))
+    {
+        /* 新进程在确认之前退出了，继续由本进程accept */
+        printf("ListenerHandoff: successor went away before confirming\n");
+        return;
+    }
+
+    for (TcpServer* server : servers_)
+    {
+        server->stop_accepting();
+    }
+    acceptor_->stop();
+    if (handoff_callback_)
+    {
+        handoff_callback_();
+    }
+}
+
+void ListenerHandoff::close_control_()
+{
+    control_channel_->disable_all();
+    control_channel_.reset();
+    ::close(control_fd_);
+    control_fd_ = -1;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/SockAddr.h"
+
+#include <memory>
+#include <vector>
+
+class Acceptor;
+class Channel;
+class TcpServer;
+
+/**
+ *  通过AF_UNIX控制套接字把监听fd交给新进程（SCM_RIGHTS），实现不丢连接的重启
+ *
+ *  旧进程：serve()在control_addr上等待新进程，新进程连上后把各TcpServer的监听fd发过去，
+ *         收到新进程的确认后停止accept并调用handoff_callback（通常是TcpServer::drain()）
+ *  新进程：take_over()取得监听fd（没有旧进程时返回空，按正常方式bind），用它们构造TcpServer并start()后，
+ *         调用confirm()通知旧进程，然后自己再调用serve()等待下一次重启
+ *
+ *  监听套接字在两个进程间是同一个内核对象，交接期间到达的连接留在accept队列中，由新进程取走
+ *  control_addr应当使用文件系统路径，新进程bind时会删除旧进程留下的文件
+ *
+ *  @code
+ *  ListenerHandoff handoff(&loop, SockAddr::unix_path("/run/echo.handoff"));
+ *  std::vector<int> fds = handoff.take_over();
+ *  auto server = fds.empty() ? std::make_unique<TcpServer>(&loop, addr) : std::make_unique<TcpServer>(&loop, fds[0]);
+ *  server->start();
+ *  handoff.confirm();
+ *  handoff.serve({server.get()}, [&] { server->drain(std::chrono::seconds(30), [&] { loop.quit(); }); });
+ *  @endcode
+ */
+class ListenerHandoff
+{
+public:
+    using handoff_callback = std::function<void()>;
+
+    ListenerHandoff(EventLoop* loop, const SockAddr& control_addr);
+    ~ListenerHandoff();
+
+    ListenerHandoff(const ListenerHandoff&) = delete;
+    ListenerHandoff& operator=(const ListenerHandoff&) = delete;
+
+    /* 新进程：阻塞地向旧进程请求监听fd，顺序与旧进程serve()时的servers一致 */
+    std::vector<int> take_over();
+    /* 新进程：已经在接管的fd上开始accept，通知旧进程退出 */
+    void confirm();
+
+    /* 旧进程：在base loop中调用，等待下一个进程来接管servers的监听fd */
+    void serve(std::vector<TcpServer*> servers, handoff_callback cb);
+
+private:
+    void handle_new_connection_(int sockfd);
+    void handle_control_read_();
+    void close_control_();
+
+private:
+    static const int kTakeOverTimeoutSeconds = 5;
+
+    EventLoop* loop_;
+    SockAddr control_addr_;
+    int takeover_fd_;                       /* 新进程：与旧进程的控制连接，confirm()后关闭 */
+    std::unique_ptr<Acceptor> acceptor_;    /* 旧进程：控制套接字的监听 */
+    std::vector<TcpServer*> servers_;
+    handoff_callback handoff_callback_;
+    int control_fd_;                        /* 旧进程：正在交接的控制连接，没有时为-1 */
+    std::unique_ptr<Channel> control_channel_;
+};
+
+/* 通过AF_UNIX套接字sockfd发送/接收一组fd */
+bool send_fds(int sockfd, const std::vector<int>& fds);
+std::vector<int> recv_fds(int sockfd);
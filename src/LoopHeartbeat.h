@@ -0,0 +1,59 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <atomic>
+#include <typeinfo>
+
+/**
+ *  EventLoop的心跳，IO线程在每轮循环和每个回调开始时更新，LoopWatchdog在另一个线程读取
+ *  全部是relaxed的原子写，在x86上就是普通的mov，正常运行的循环几乎没有开销
+ *  各字段之间不保证一致，只用于诊断
+ */
+struct LoopHeartbeat
+{
+    enum activity_kind
+    {
+        kIdle,      /* 阻塞在epoll_wait中 */
+        kChannel,   /* 正在执行某个fd的Channel回调 */
+        kFunctor,   /* 正在执行pending functor */
+        kTimer      /* 正在执行定时器回调 */
+    };
+
+    std::atomic<size_t> tid{0};                     /* IO线程id，用于发送信号打印调用栈 */
+    std::atomic<uint64_t> iteration{0};             /* 离开epoll_wait的次数 */
+    std::atomic<int64_t> busy_since_ns{0};          /* 本轮离开epoll_wait的时刻，阻塞时为0 */
+    std::atomic<int> kind{kIdle};
+    std::atomic<int> fd{-1};
+    std::atomic<const std::type_info*> callback{nullptr};  /* functor/定时器回调的类型 */
+
+    void enter_poll()
+    {
+        kind.store(kIdle, std::memory_order_relaxed);
+        busy_since_ns.store(0, std::memory_order_relaxed);
+    }
+
+    void leave_poll(timer_clock::time_point now)
+    {
+        busy_since_ns.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+        iteration.store(iteration.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void set_channel(int channel_fd)
+    {
+        kind.store(kChannel, std::memory_order_relaxed);
+        fd.store(channel_fd, std::memory_order_relaxed);
+    }
+
+    void set_functor(const std::type_info& type)
+    {
+        kind.store(kFunctor, std::memory_order_relaxed);
+        callback.store(&type, std::memory_order_relaxed);
+    }
+
+    void set_timer(const std::type_info& type)
+    {
+        kind.store(kTimer, std::memory_order_relaxed);
+        callback.store(&type, std::memory_order_relaxed);
+    }
+};
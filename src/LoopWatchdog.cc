@@ -0,0 +1,200 @@
+#include "src/LoopWatchdog.h"
+#include "src/EventLoop.h"
+
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* 请求卡住的IO线程打印调用栈的信号，默认动作是忽略，本库的socket也不使用带外数据 */
+const int kBacktraceSignal = SIGURG;
+
+/* 在被卡住的IO线程中执行，只使用write和backtrace_symbols_fd，不分配内存 */
+void backtrace_signal_handler(int)
+{
+    int saved_errno = errno;
+    const char header[] = "---- stalled EventLoop backtrace ----\n";
+    ssize_t n = ::write(STDERR_FILENO, header, sizeof(header) - 1);
+    (void)n;
+    void* frames[64];
+    int depth = ::backtrace(frames, 64);
+    ::backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+    errno = saved_errno;
+}
+
+void install_backtrace_handler()
+{
+    /* 第一次调用backtrace会加载libgcc_s并分配内存，先在这里调用一次 */
+    void* frame;
+    ::backtrace(&frame, 1);
+
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = backtrace_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    ::sigemptyset(&sa.sa_mask);
+    if (::sigaction(kBacktraceSignal, &sa, nullptr) < 0)
+    {
+        handle_err("sigaction");
+    }
+}
+
+std::string demangle(const std::type_info* type)
+{
+    if (!type)
+    {
+        return "?";
+    }
+    int status = 0;
+    char* name = abi::__cxa_demangle(type->name(), nullptr, nullptr, &status);
+    if (status != 0 || !name)
+    {
+        return type->name();
+    }
+    std::string result(name);
+    ::free(name);
+    return result;
+}
+
+void default_stall_callback(const StallInfo& info)
+{
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(info.duration).count();
+    if (info.fd >= 0)
+    {
+        printf("LoopWatchdog: EventLoop in thread %zu stalled for %lld ms in %s callback of fd %d\n",
+            info.tid, ms, info.kind, info.fd);
+    }
+    else
+    {
+        printf("LoopWatchdog: EventLoop in thread %zu stalled for %lld ms in %s %s\n",
+            info.tid, ms, info.kind, info.callback.c_str());
+    }
+}
+
+LoopWatchdog::LoopWatchdog(timer_clock::duration threshold, timer_clock::duration check_interval)
+    : threshold_(threshold)
+    , check_interval_(check_interval)
+    , stall_callback_(default_stall_callback)
+    , backtrace_(false)
+    , running_(false)
+{}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop* loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    loops_.push_back(Watched{loop, loop->heartbeat().iteration.load(std::memory_order_relaxed)});
+}
+
+void LoopWatchdog::start()
+{
+    if (backtrace_)
+    {
+        install_backtrace_handler();
+    }
+    running_ = true;
+    thread_ = std::thread(&LoopWatchdog::thread_func_, this);
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void LoopWatchdog::thread_func_()
+{
+    set_thread_name("watchdog");
+    std::vector<StallInfo> stalls;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, check_interval_);
+        timer_clock::time_point now = timer_clock::now();
+        for (Watched& watched : loops_)
+        {
+            StallInfo info;
+            if (check_(watched, now, &info))
+            {
+                stalls.push_back(std::move(info));
+            }
+        }
+        if (stalls.empty())
+        {
+            continue;
+        }
+
+        /* 回调中可能调用watch/unwatch，不能持有锁 */
+        lock.unlock();
+        for (const StallInfo& info : stalls)
+        {
+            stall_callback_(info);
+            if (backtrace_)
+            {
+                ::syscall(SYS_tgkill, ::getpid(), static_cast<pid_t>(info.tid), kBacktraceSignal);
+            }
+        }
+        stalls.clear();
+        lock.lock();
+    }
+}
+
+/* 发现新的卡顿时填好info返回true，只在持有mutex_时调用 */
+bool LoopWatchdog::check_(Watched& watched, timer_clock::time_point now, StallInfo* info)
+{
+    LoopHeartbeat& heartbeat = watched.loop->heartbeat();
+
+    /* 前后两次读到同一个busy_since，说明iteration和它属于同一轮 */
+    int64_t since = heartbeat.busy_since_ns.load(std::memory_order_relaxed);
+    uint64_t iteration = heartbeat.iteration.load(std::memory_order_acquire);
+    if (since == 0 || iteration == watched.reported_iteration
+        || since != heartbeat.busy_since_ns.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    timer_clock::duration busy = now.time_since_epoch() - std::chrono::nanoseconds(since);
+    if (busy < threshold_)
+    {
+        return false;
+    }
+    watched.reported_iteration = iteration;
+
+    info->loop = watched.loop;
+    info->tid = heartbeat.tid.load(std::memory_order_relaxed);
+    info->duration = busy;
+    info->fd = -1;
+    switch (heartbeat.kind.load(std::memory_order_relaxed))
+    {
+    case LoopHeartbeat::kChannel:
+        info->kind = "channel";
+        info->fd = heartbeat.fd.load(std::memory_order_relaxed);
+        break;
+    case LoopHeartbeat::kFunctor:
+        info->kind = "functor";
+        info->callback = demangle(heartbeat.callback.load(std::memory_order_relaxed));
+        break;
+    case LoopHeartbeat::kTimer:
+        info->kind = "timer";
+        info->callback = demangle(heartbeat.callback.load(std::memory_order_relaxed));
+        break;
+    default:
+        info->kind = "loop";
+        break;
+    }
+    return true;
+}
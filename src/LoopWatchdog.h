@@ -0,0 +1,73 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class EventLoop;
+
+/* 一次卡顿的描述 */
+struct StallInfo
+{
+    EventLoop* loop;
+    size_t tid;                         /* 卡住的IO线程 */
+    timer_clock::duration duration;     /* 本轮循环已经执行了多久 */
+    const char* kind;                   /* "channel" / "functor" / "timer" */
+    int fd;                             /* kind为channel时有效 */
+    std::string callback;               /* kind为functor/timer时，回调的类型名 */
+};
+
+/**
+ *  EventLoop卡顿检测
+ *
+ *  独立线程每隔check_interval检查一次被监视的EventLoop的心跳（见LoopHeartbeat），
+ *  如果某一轮循环离开epoll_wait已经超过threshold，就报告正在执行的fd/functor/定时器，
+ *  每轮循环只报告一次；打开backtrace后还会向该IO线程发送信号，在信号处理函数中把调用栈打印到stderr
+ */
+class LoopWatchdog
+{
+public:
+    using stall_callback = std::function<void(const StallInfo&)>;
+
+    explicit LoopWatchdog(timer_clock::duration threshold,
+        timer_clock::duration check_interval = std::chrono::milliseconds(10));
+    ~LoopWatchdog();
+
+    LoopWatchdog(const LoopWatchdog&) = delete;
+    LoopWatchdog& operator=(const LoopWatchdog&) = delete;
+
+    void watch(EventLoop* loop);    /* 可以在任意线程、任意时刻调用 */
+    /* 必须在start()之前设置，回调在watchdog线程中执行，执行时不持有内部的锁，可以调用watch */
+    void set_stall_callback(stall_callback cb) { stall_callback_ = std::move(cb); }
+    void set_backtrace(bool on) { backtrace_ = on; }
+
+    void start();
+    void stop();
+
+private:
+    struct Watched
+    {
+        EventLoop* loop;
+        uint64_t reported_iteration;    /* 已经报告过的那一轮 */
+    };
+
+    void thread_func_();
+    bool check_(Watched& watched, timer_clock::time_point now, StallInfo* info);
+
+private:
+    const timer_clock::duration threshold_;
+    const timer_clock::duration check_interval_;
+    stall_callback stall_callback_;
+    bool backtrace_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::vector<Watched> loops_;
+};
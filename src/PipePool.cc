@@ -0,0 +1,69 @@
+#include "src/PipePool.h"
+#include "src/common.h"
+
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* 每个线程的空闲管道，线程退出时全部关闭 */
+struct ThreadPipes
+{
+    std::vector<PipePool::Pipe> pipes;
+
+    ~ThreadPipes()
+    {
+        for (const PipePool::Pipe& pipe : pipes)
+        {
+            ::close(pipe.read_fd);
+            ::close(pipe.write_fd);
+        }
+    }
+};
+
+thread_local ThreadPipes t_pipes;
+
+PipePool::Pipe PipePool::acquire()
+{
+    if (!t_pipes.pipes.empty())
+    {
+        Pipe pipe = t_pipes.pipes.back();
+        t_pipes.pipes.pop_back();
+        return pipe;
+    }
+
+    /* fd用完（EMFILE/ENFILE）时返回空的Pipe，由调用者退回到不用管道的方式 */
+    Pipe pipe;
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        printf("PipePool::acquire() pipe2: %s\n", strerror(errno));
+        return pipe;
+    }
+
+    pipe.read_fd = fds[0];
+    pipe.write_fd = fds[1];
+    /* 更大的管道让每次splice搬运更多数据，超过系统上限时保持默认大小 */
+    ::fcntl(pipe.write_fd, F_SETPIPE_SZ, kPipeSize);
+    int size = ::fcntl(pipe.write_fd, F_GETPIPE_SZ);
+    pipe.capacity = size > 0 ? static_cast<size_t>(size) : 65536;
+    return pipe;
+}
+
+void PipePool::release(Pipe pipe, bool empty)
+{
+    if (pipe.read_fd < 0)
+    {
+        return;
+    }
+    if (empty && t_pipes.pipes.size() < kMaxPooled)
+    {
+        t_pipes.pipes.push_back(pipe);
+    }
+    else
+    {
+        ::close(pipe.read_fd);
+        ::close(pipe.write_fd);
+    }
+}
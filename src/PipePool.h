@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ *  splice用的管道池，每个线程（即每个EventLoop）一个，不需要加锁
+ *  管道中还有数据时不能复用，release时直接关闭；线程退出时关闭池中剩下的管道
+ */
+class PipePool
+{
+public:
+    struct Pipe
+    {
+        int read_fd = -1;
+        int write_fd = -1;
+        size_t capacity = 0;    /* 管道缓冲区大小，一次splice最多写入这么多 */
+    };
+
+    /* 创建管道失败时返回read_fd为-1的空Pipe */
+    static Pipe acquire();
+    static void release(Pipe pipe, bool empty);
+
+private:
+    static const size_t kMaxPooled = 64;
+    static const int kPipeSize = 256 * 1024;
+};
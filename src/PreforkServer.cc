@@ -0,0 +1,314 @@
+#include "src/PreforkServer.h"
+#include "src/Channel.h"
+#include "src/CpuTopology.h"
+#include "src/EventLoop.h"
+#include "src/EventLoopThreadPool.h"
+#include "src/TcpServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <thread>
+
+/* 重启的退避时间从kMinBackoff开始，每次连续失败翻倍，最多kMaxBackoff */
+const timer_clock::duration kMinBackoff = std::chrono::milliseconds(100);
+const timer_clock::duration kMaxBackoff = std::chrono::seconds(10);
+
+void PreforkServer::WorkerContext::report(const WorkerStats& stats)
+{
+    /* 管道满了（master阻塞在别处）时丢掉这次统计，不能让worker的IO线程阻塞 */
+    ssize_t n = ::write(stats_fd_, &stats, sizeof(stats));
+    if (n < 0 && errno != EAGAIN)
+    {
+        printf("PreforkServer::WorkerContext::report() write: %s\n", strerror(errno));
+    }
+}
+
+void PreforkServer::WorkerContext::report_every(TcpServer* server, timer_clock::duration interval)
+{
+    server->get_loop()->run_every(interval, [this, server] {
+        WorkerStats stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.index = index_;
+        stats.pid = ::getpid();
+        stats.connections = server->num_connections();
+        stats.rejected = server->num_rejected();
+        for (EventLoop* loop : server->thread_pool()->get_all_loops())
+        {
+            EventLoopStats loop_stats = loop->stats();
+            stats.iterations += loop_stats.iterations;
+            stats.events += loop_stats.events;
+            stats.busy_ns += loop_stats.busy_ns;
+            stats.blocked_ns += loop_stats.blocked_ns;
+        }
+        report(stats);
+    });
+}
+
+PreforkServer::PreforkServer(int num_workers)
+    : num_workers_(num_workers)
+    , pin_per_core_(false)
+    , loop_(nullptr)
+    , signalfd_(-1)
+    , stopping_(false)
+{}
+
+PreforkServer::~PreforkServer()
+{
+    for (Worker& worker : workers_)
+    {
+        close_worker_pipe_(worker);
+    }
+}
+
+int PreforkServer::run()
+{
+    EventLoop loop;
+    loop_ = &loop;
+
+    /* SIGCHLD/SIGINT/SIGTERM改为通过signalfd在EventLoop中处理，fork出的worker会恢复信号掩码 */
+    sigset_t mask;
+    ::sigemptyset(&mask);
+    ::sigaddset(&mask, SIGCHLD);
+    ::sigaddset(&mask, SIGINT);
+    ::sigaddset(&mask, SIGTERM);
+    if (::sigprocmask(SIG_BLOCK, &mask, nullptr) < 0)
+        handle_err("sigprocmask");
+    signalfd_ = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalfd_ < 0)
+        handle_err("signalfd");
+    signal_channel_ = std::make_unique<Channel>(loop_, signalfd_);
+    signal_channel_->set_read_callback(std::bind(&PreforkServer::handle_signal_, this));
+    signal_channel_->enable_reading();
+
+    if (pin_per_core_)
+    {
+        cpus_ = physical_core_cpus();
+    }
+    workers_.resize(static_cast<size_t>(num_workers_));
+    latest_stats_.assign(workers_.size(), WorkerStats());
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        spawn_(i);
+    }
+
+    loop.loop();
+
+    signal_channel_->disable_all();
+    signal_channel_.reset();
+    ::close(signalfd_);
+    signalfd_ = -1;
+    ::sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+    loop_ = nullptr;
+    for (Worker& worker : workers_)
+    {
+        close_worker_pipe_(worker);
+    }
+    return EXIT_SUCCESS;
+}
+
+void PreforkServer::spawn_(size_t index)
+{
+    if (stopping_)
+    {
+        return;
+    }
+
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC | O_NONBLOCK) < 0)
+        handle_err("pipe2");
+
+    pid_t pid = ::fork();
+    if (pid < 0)
+        handle_err("fork");
+    if (pid == 0)
+    {
+        ::close(fds[0]);
+        run_worker_(index, fds[1]);
+    }
+
+    ::close(fds[1]);
+    Worker& worker = workers_[index];
+    worker.pid = pid;
+    worker.stats_fd = fds[0];
+    worker.started = timer_clock::now();
+    worker.channel = std::make_unique<Channel>(loop_, fds[0]);
+    worker.channel->set_read_callback(std::bind(&PreforkServer::handle_stats_, this, index));
+    worker.channel->enable_reading();
+    printf("PreforkServer: started worker %zu, pid = %d\n", index, pid);
+}
+
+void PreforkServer::run_worker_(size_t index, int stats_fd)
+{
+    /* master退出时worker也退出 */
+    ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    sigset_t mask;
+    ::sigemptyset(&mask);
+    ::sigprocmask(SIG_SETMASK, &mask, nullptr);
+    /* master的EventLoop留在子进程的内存中但不再使用，关掉继承来的fd */
+    loop_->close_after_fork();
+    ::close(signalfd_);
+    for (Worker& worker : workers_)
+    {
+        if (worker.stats_fd >= 0)
+        {
+            ::close(worker.stats_fd);
+        }
+    }
+
+    if (!cpus_.empty())
+    {
+        /* 之后创建的线程（包括IO线程）继承这个亲和性 */
+        bind_current_thread(std::vector<int>(1, cpus_[index % cpus_.size()]));
+    }
+
+    WorkerContext context(static_cast<int>(index), stats_fd);
+    std::thread worker([this, &context, index] {
+        set_thread_name("worker-" + std::to_string(index));
+        worker_main_(context);
+    });
+    worker.join();
+    ::_exit(EXIT_SUCCESS);
+}
+
+void PreforkServer::handle_signal_()
+{
+    struct signalfd_siginfo info;
+    while (::read(signalfd_, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info)))
+    {
+        if (info.ssi_signo == SIGCHLD)
+        {
+            reap_children_();
+        }
+        else if (!stopping_)
+        {
+            printf("PreforkServer: received signal %u, stopping workers\n", info.ssi_signo);
+            stopping_ = true;
+            for (const Worker& worker : workers_)
+            {
+                if (worker.pid > 0)
+                {
+                    ::kill(worker.pid, SIGTERM);
+                }
+            }
+        }
+    }
+
+    if (stopping_ && std::none_of(workers_.begin(), workers_.end(), [](const Worker& w) { return w.pid > 0; }))
+    {
+        loop_->quit();
+    }
+}
+
+/**
+ *  多个SIGCHLD可能合并成一个，每次都检查所有worker
+ *  只等待worker的pid，应用自己fork的子进程留给应用自己回收
+ */
+void PreforkServer::reap_children_()
+{
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        int status = 0;
+        if (workers_[i].pid > 0 && ::waitpid(workers_[i].pid, &status, WNOHANG) > 0)
+        {
+            on_worker_exit_(i, status);
+        }
+    }
+}
+
+void PreforkServer::on_worker_exit_(size_t index, int status)
+{
+    Worker& worker = workers_[index];
+    if (WIFSIGNALED(status))
+    {
+        printf("PreforkServer: worker %zu (pid %d) killed by signal %d\n", index, worker.pid, WTERMSIG(status));
+    }
+    else
+    {
+        printf("PreforkServer: worker %zu (pid %d) exited with %d\n", index, worker.pid, WEXITSTATUS(status));
+    }
+    worker.pid = -1;
+    close_worker_pipe_(worker);
+    if (stopping_)
+    {
+        return;
+    }
+
+    if (timer_clock::now() - worker.started < std::chrono::seconds(kStableSeconds))
+    {
+        ++worker.failures;
+    }
+    else
+    {
+        worker.failures = 0;
+    }
+
+    timer_clock::duration delay = timer_clock::duration::zero();
+    if (worker.failures > 0)
+    {
+        delay = kMinBackoff * (1 << std::min(worker.failures - 1, 10));
+        delay = std::min(delay, kMaxBackoff);
+    }
+    loop_->run_after(delay, std::bind(&PreforkServer::spawn_, this, index));
+}
+
+void PreforkServer::handle_stats_(size_t index)
+{
+    Worker& worker = workers_[index];
+    if (worker.stats_fd < 0)
+    {
+        /* 同一轮中已经处理了该worker的SIGCHLD */
+        return;
+    }
+    WorkerStats stats[16];
+    ssize_t n = ::read(worker.stats_fd, stats, sizeof(stats));
+    if (n <= 0)
+    {
+        /* worker退出，由SIGCHLD处理，这里只是不再关注 */
+        if (n == 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            worker.channel->disable_all();
+        }
+        return;
+    }
+
+    size_t count = static_cast<size_t>(n) / sizeof(WorkerStats);
+    for (size_t i = 0; i < count; ++i)
+    {
+        latest_stats_[index] = stats[i];
+        if (stats_callback_)
+        {
+            stats_callback_(stats[i]);
+        }
+    }
+}
+
+void PreforkServer::close_worker_pipe_(Worker& worker)
+{
+    if (worker.channel)
+    {
+        worker.channel->disable_all();
+        if (loop_)
+        {
+            /* 本轮的活动Channel列表中可能还有它，到pending functor中再析构 */
+            std::shared_ptr<Channel> channel(std::move(worker.channel));
+            loop_->queue_in_loop([channel] {});
+        }
+        else
+        {
+            worker.channel.reset();
+        }
+    }
+    if (worker.stats_fd >= 0)
+    {
+        ::close(worker.stats_fd);
+        worker.stats_fd = -1;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <sys/types.h>
+#include <memory>
+#include <vector>
+
+class TcpServer;
+
+/* worker通过管道定期上报给master的统计，定长且小于PIPE_BUF，一次write是原子的 */
+struct WorkerStats
+{
+    int32_t index;
+    int32_t pid;
+    uint64_t connections;   /* 当前连接数 */
+    uint64_t rejected;      /* 累计被准入控制拒绝的连接数 */
+    uint64_t iterations;    /* 以下为该worker所有EventLoop的累计值 */
+    uint64_t events;
+    uint64_t busy_ns;
+    uint64_t blocked_ns;
+};
+
+/**
+ *  多进程模式：master fork出N个worker进程，每个worker有自己的EventLoop和自己的SO_REUSEPORT监听socket，
+ *  由内核在worker之间分配新连接；一个worker崩溃只影响它自己的连接
+ *
+ *  master只用一个EventLoop监听signalfd和各worker的统计管道：
+ *  worker退出后按退避时间重启，收到SIGINT/SIGTERM时通知所有worker退出，全部退出后run()返回
+ *
+ *  worker_main在worker进程的一个新线程中执行（fork出的主线程继承了master线程的thread_local状态，
+ *  包括缓存的线程id和"本线程已有EventLoop"的标记），它返回后worker进程退出
+ *
+ *  @code
+ *  PreforkServer prefork(4);
+ *  prefork.set_worker_main([](PreforkServer::WorkerContext& ctx) {
+ *      EventLoop loop;
+ *      TcpServer server(&loop, "0.0.0.0", 8080);
+ *      server.start();
+ *      ctx.report_every(&server, std::chrono::seconds(1));
+ *      loop.loop();
+ *  });
+ *  prefork.run();
+ *  @endcode
+ */
+class PreforkServer
+{
+public:
+    class WorkerContext
+    {
+    public:
+        WorkerContext(int index, int stats_fd) : index_(index), stats_fd_(stats_fd) {}
+
+        int index() const { return index_; }
+        /* 可以在worker的任意线程调用，管道满时丢弃 */
+        void report(const WorkerStats& stats);
+        /* 在server的base loop中每隔interval汇总server的所有EventLoop并上报 */
+        void report_every(TcpServer* server, timer_clock::duration interval);
+
+    private:
+        int index_;
+        int stats_fd_;
+    };
+
+    using worker_main = std::function<void(WorkerContext& ctx)>;
+    using stats_callback = std::function<void(const WorkerStats& stats)>;
+
+    explicit PreforkServer(int num_workers);
+    ~PreforkServer();
+
+    PreforkServer(const PreforkServer&) = delete;
+    PreforkServer& operator=(const PreforkServer&) = delete;
+
+    void set_worker_main(worker_main cb) { worker_main_ = std::move(cb); }
+    /* 在master中收到worker上报时调用 */
+    void set_stats_callback(stats_callback cb) { stats_callback_ = std::move(cb); }
+    /* 第i个worker绑定到第i个物理核 */
+    void set_pin_per_core(bool on) { pin_per_core_ = on; }
+
+    /* 在master中运行直到收到SIGINT/SIGTERM并且所有worker都已退出 */
+    int run();
+
+    /* 每个worker最近一次上报的统计 */
+    const std::vector<WorkerStats>& latest_stats() const { return latest_stats_; }
+
+private:
+    struct Worker
+    {
+        pid_t pid = -1;
+        int stats_fd = -1;                  /* 统计管道的读端 */
+        std::unique_ptr<Channel> channel;
+        timer_clock::time_point started;
+        int failures = 0;                   /* 连续过早退出的次数，决定重启的退避时间 */
+    };
+
+    void spawn_(size_t index);
+    [[noreturn]] void run_worker_(size_t index, int stats_fd);
+    void handle_signal_();
+    void handle_stats_(size_t index);
+    void reap_children_();
+    void on_worker_exit_(size_t index, int status);
+    void close_worker_pipe_(Worker& worker);
+
+private:
+    static constexpr int kStableSeconds = 5;    /* 运行超过这个时间后退出不算作连续失败 */
+
+    const int num_workers_;
+    worker_main worker_main_;
+    stats_callback stats_callback_;
+    bool pin_per_core_;
+    std::vector<int> cpus_;
+
+    EventLoop* loop_;                       /* master的EventLoop，只在run()期间有效 */
+    int signalfd_;
+    std::unique_ptr<Channel> signal_channel_;
+    bool stopping_;
+    std::vector<Worker> workers_;
+    std::vector<WorkerStats> latest_stats_;
+};
@@ -0,0 +1,139 @@
+#include "src/SockAddr.h"
+
+#include <arpa/inet.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SockAddr::SockAddr()
+    : len_(capacity())
+{
+    memset(&addr_, 0, sizeof(addr_));
+}
+
+SockAddr::SockAddr(const std::string& ip, uint16_t port)
+    : SockAddr()
+{
+    if (ip.find(':') != std::string::npos)
+    {
+        struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(&addr_);
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        len_ = static_cast<socklen_t>(sizeof(*addr6));
+        if (inet_pton(AF_INET6, ip.c_str(), &addr6->sin6_addr) != 1)
+        {
+            printf("SockAddr: invalid IPv6 address %s\n", ip.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        struct sockaddr_in* addr4 = reinterpret_cast<struct sockaddr_in*>(&addr_);
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        len_ = static_cast<socklen_t>(sizeof(*addr4));
+        if (inet_pton(AF_INET, ip.c_str(), &addr4->sin_addr) != 1)
+        {
+            printf("SockAddr: invalid IPv4 address %s\n", ip.c_str());
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+SockAddr::SockAddr(const struct sockaddr_in& addr)
+    : SockAddr()
+{
+    memcpy(&addr_, &addr, sizeof(addr));
+    len_ = static_cast<socklen_t>(sizeof(addr));
+}
+
+SockAddr SockAddr::unix_path(const std::string& path)
+{
+    SockAddr result;
+    struct sockaddr_un* addr = reinterpret_cast<struct sockaddr_un*>(&result.addr_);
+    addr->sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr->sun_path))
+    {
+        printf("SockAddr: invalid unix socket path %s\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(addr->sun_path, path.data(), path.size());
+    if (path[0] == '@')
+    {
+        /* 抽象地址以'\0'开头，长度不包括结尾的'\0' */
+        addr->sun_path[0] = '\0';
+        result.len_ = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size());
+    }
+    else
+    {
+        result.len_ = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+    }
+    return result;
+}
+
+bool SockAddr::is_abstract() const
+{
+    const struct sockaddr_un* addr = reinterpret_cast<const struct sockaddr_un*>(&addr_);
+    return is_unix() && len_ > offsetof(struct sockaddr_un, sun_path) && addr->sun_path[0] == '\0';
+}
+
+std::string SockAddr::ip() const
+{
+    char buf[INET6_ADDRSTRLEN] = "";
+    if (family() == AF_INET)
+    {
+        inet_ntop(AF_INET, &reinterpret_cast<const struct sockaddr_in*>(&addr_)->sin_addr, buf, sizeof(buf));
+    }
+    else if (family() == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &reinterpret_cast<const struct sockaddr_in6*>(&addr_)->sin6_addr, buf, sizeof(buf));
+    }
+    return buf;
+}
+
+uint16_t SockAddr::port() const
+{
+    if (family() == AF_INET)
+    {
+        return ntohs(reinterpret_cast<const struct sockaddr_in*>(&addr_)->sin_port);
+    }
+    else if (family() == AF_INET6)
+    {
+        return ntohs(reinterpret_cast<const struct sockaddr_in6*>(&addr_)->sin6_port);
+    }
+    return 0;
+}
+
+std::string SockAddr::path() const
+{
+    const size_t offset = offsetof(struct sockaddr_un, sun_path);
+    if (!is_unix() || len_ <= offset)
+    {
+        return std::string();
+    }
+
+    const struct sockaddr_un* addr = reinterpret_cast<const struct sockaddr_un*>(&addr_);
+    size_t len = len_ - offset;
+    if (addr->sun_path[0] == '\0')
+    {
+        return "@" + std::string(addr->sun_path + 1, len - 1);
+    }
+    return std::string(addr->sun_path, strnlen(addr->sun_path, len));
+}
+
+std::string SockAddr::to_string() const
+{
+    switch (family())
+    {
+    case AF_INET:
+        return ip() + ":" + std::to_string(port());
+    case AF_INET6:
+        return "[" + ip() + "]:" + std::to_string(port());
+    case AF_UNIX:
+        return "unix:" + path();
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <string>
+
+/**
+ *  套接字地址，支持IPv4、IPv6和AF_UNIX
+ *
+ *  AF_UNIX地址以'@'开头时表示抽象命名空间（Linux特有），不在文件系统中创建文件，
+ *  进程退出后自动消失
+ */
+class SockAddr
+{
+public:
+    SockAddr();    /* AF_UNSPEC，用作accept等的输出参数 */
+    /* ip中含有':'时按IPv6解析，地址不合法时退出进程 */
+    SockAddr(const std::string& ip, uint16_t port);
+    explicit SockAddr(const struct sockaddr_in& addr);
+
+    static SockAddr unix_path(const std::string& path);
+
+    int family() const { return addr_.ss_family; }
+    bool is_unix() const { return family() == AF_UNIX; }
+    bool is_abstract() const;
+
+    const struct sockaddr* get() const { return reinterpret_cast<const struct sockaddr*>(&addr_); }
+    struct sockaddr* get_mutable() { return reinterpret_cast<struct sockaddr*>(&addr_); }
+    socklen_t length() const { return len_; }
+    void set_length(socklen_t len) { len_ = len; }
+    static socklen_t capacity() { return static_cast<socklen_t>(sizeof(struct sockaddr_storage)); }
+
+    std::string ip() const;         /* AF_UNIX时为空 */
+    uint16_t port() const;          /* AF_UNIX时为0 */
+    std::string path() const;       /* AF_UNIX的路径，抽象地址以'@'开头，未命名的客户端为空 */
+    std::string to_string() const;  /* "1.2.3.4:80"、"[::1]:80"、"unix:/tmp/a.sock" */
+
+private:
+    struct sockaddr_storage addr_;
+    socklen_t len_;
+};
@@ -0,0 +1,107 @@
+#include "src/TcpClient.h"
+#include "src/EventLoop.h"
+#include "src/TcpConnection.h"
+
+using namespace std::placeholders;
+
+SockAddr peer_addr_of(int sockfd)
+{
+    SockAddr addr;
+    socklen_t len = SockAddr::capacity();
+    if (::getpeername(sockfd, addr.get_mutable(), &len) == 0)
+    {
+        addr.set_length(len);
+    }
+    return addr;
+}
+
+/* TcpClient析构后连接仍然存在时使用的close_callback，只负责延迟释放连接 */
+void detach_connection(EventLoop* loop, const tcp_conn_ptr& conn)
+{
+    loop->queue_in_loop([conn] {});
+}
+
+TcpClient::TcpClient(EventLoop* loop, const SockAddr& server_addr)
+    : loop_(loop)
+    , connector_(std::make_shared<Connector>(loop, server_addr))
+    , retry_(false)
+    , connect_(false)
+{
+    connector_->set_new_connection_callback(std::bind(&TcpClient::new_connection_, this, _1));
+}
+
+TcpClient::~TcpClient()
+{
+    tcp_conn_ptr conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        conn = connection_;
+    }
+
+    if (conn)
+    {
+        /* 连接比TcpClient活得久，关闭时不能再回调到this */
+        assert(loop_ == conn->get_loop());
+        loop_->run_in_loop([conn, loop = loop_] {
+            conn->set_close_callback(std::bind(&detach_connection, loop, _1));
+        }, EventLoop::kUrgent);
+        conn->force_close();
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::new_connection_(int sockfd)
+{
+    loop_->assert_in_loop_thread();
+    auto conn = std::make_shared<TcpConnection>(loop_, sockfd, peer_addr_of(sockfd));
+    conn->set_connection_callback(connection_callback_ ? connection_callback_ : [](const tcp_conn_ptr&) {});
+    conn->set_message_callback(message_callback_ ? message_callback_ : [](const tcp_conn_ptr&, Buffer&) {});
+    conn->set_write_complete_callback(write_complete_callback_);
+    conn->set_close_callback(std::bind(&TcpClient::remove_connection_, this, _1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connect_established();
+}
+
+void TcpClient::remove_connection_(const tcp_conn_ptr& conn)
+{
+    loop_->assert_in_loop_thread();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(connection_ == conn);
+        connection_.reset();
+    }
+
+    loop_->queue_in_loop([conn] {});
+    if (retry_ && connect_)
+    {
+        connector_->restart();
+    }
+}
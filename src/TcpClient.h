@@ -0,0 +1,59 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/Connector.h"
+#include "src/SockAddr.h"
+
+#include <mutex>
+
+/**
+ *  客户端连接，复用TcpConnection，一个TcpClient最多同时持有一个连接
+ *  connect()不阻塞，失败后由Connector按退避时间重试；enable_retry()后连接断开还会自动重连
+ */
+class TcpClient
+{
+public:
+    TcpClient(EventLoop* loop, const SockAddr& server_addr);
+    ~TcpClient();
+
+    TcpClient(const TcpClient&) = delete;
+    TcpClient& operator=(const TcpClient&) = delete;
+
+    void connect();
+    void disconnect();  /* shutdown已建立的连接 */
+    void stop();        /* 停止正在进行的连接/重试 */
+
+    /* 可以在任意线程调用，未连接时为空 */
+    tcp_conn_ptr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* get_loop() const { return loop_; }
+    bool retry() const { return retry_; }
+    void enable_retry() { retry_ = true; }
+
+    /* 必须在connect()之前设置 */
+    void set_connection_callback(connection_callback cb) { connection_callback_ = std::move(cb); }
+    void set_message_callback(message_callback cb) { message_callback_ = std::move(cb); }
+    void set_write_complete_callback(write_complete_callback cb) { write_complete_callback_ = std::move(cb); }
+
+private:
+    void new_connection_(int sockfd);
+    void remove_connection_(const tcp_conn_ptr& conn);
+
+private:
+    EventLoop* loop_;
+    connector_ptr connector_;
+    connection_callback connection_callback_;
+    message_callback message_callback_;
+    write_complete_callback write_complete_callback_;
+    std::atomic<bool> retry_;       /* 连接断开后是否重连 */
+    std::atomic<bool> connect_;
+    mutable std::mutex mutex_;
+    tcp_conn_ptr connection_;       /* 由mutex_保护 */
+};
+
+/* 按对端地址取出连接fd的SockAddr */
+SockAddr peer_addr_of(int sockfd);
@@ -3,18 +3,32 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
 #include <netinet/tcp.h>
 
-TcpConnection::TcpConnection(EventLoop* loop, int sockfd, const struct sockaddr_in& peer_addr)
+TcpConnection::TcpConnection(EventLoop* loop, int sockfd, const SockAddr& peer_addr)
     : loop_(loop)
     , sockfd_(sockfd)
+    , generation_(0)
     , channel_(std::make_unique<Channel>(loop_, sockfd_))
     , peer_addr_(peer_addr)
     , state_(kConnecting)
+    , wheel_(nullptr)
+    , idle_timeout_(timer_clock::duration::zero())
+    , offload_submitted_(0)
+    , offload_completed_(0)
+    , queued_sends_(0)
+    , files_preceding_(0)
 {
+    /* 节点在连接断开时取消，所以回调中的裸指针一直有效 */
+    idle_node_.callback = std::bind(&TcpConnection::handle_idle_, this);
     channel_->set_read_callback(std::bind(&TcpConnection::handle_read_, this));
     channel_->set_write_callback(std::bind(&TcpConnection::handle_write_, this));
-    set_keep_alive(true);
+    if (!peer_addr_.is_unix())
+    {
+        set_keep_alive(true);
+    }
 }
 
 TcpConnection::~TcpConnection()
@@ -28,21 +42,25 @@ void TcpConnection::connect_established()
     set_state_(kConnected);
     channel_->tie(shared_from_this());
     channel_->enable_reading();
+    touch_idle_();
     connection_callback_(shared_from_this());
 }
 
+/**
+ *  其他线程的send以kBulk优先级排队，IO线程中的send如果前面还有排队的数据，也要排在它们后面，
+ *  保证同一连接上的数据按调用顺序发出
+ */
 void TcpConnection::send(const std::string& message)
 {
     if (state_ == kConnected)
     {
-        if (loop_->is_in_loop_thread())
+        if (loop_->is_in_loop_thread() && queued_sends_ == 0)
         {
             send_in_loop_(message);
         }
         else
         {
-            void (TcpConnection:: *fp)(const std::string& message) = &TcpConnection::send_in_loop_;
-            loop_->run_in_loop(std::bind(fp, this, message));
+            queue_send_(message);
         }
     }
 }
@@ -51,14 +69,13 @@ void TcpConnection::send(std::string&& message)
 {
     if (state_ == kConnected)
     {
-        if (loop_->is_in_loop_thread())
+        if (loop_->is_in_loop_thread() && queued_sends_ == 0)
         {
-            send_in_loop_(std::move(message));
+            send_in_loop_(message);
         }
         else
         {
-            void (TcpConnection:: *fp)(const std::string& message) = &TcpConnection::send_in_loop_;
-            loop_->run_in_loop(std::bind(fp, this, std::move(message)));
+            queue_send_(std::move(message));
         }
     }
 }
@@ -67,19 +84,50 @@ void TcpConnection::send(Buffer* buf)
 {
     if (state_ == kConnected)
     {
-        if (loop_->is_in_loop_thread())
+        if (loop_->is_in_loop_thread() && queued_sends_ == 0)
         {
             send_in_loop_(buf->peek(), buf->readable_bytes());
             buf->retrieve_all();
         }
         else
         {
-            void (TcpConnection:: *fp)(const std::string& message) = &TcpConnection::send_in_loop_;
-            loop_->run_in_loop(std::bind(fp, this, buf->retrieve_all_as_string()));
+            queue_send_(buf->retrieve_all_as_string());
+        }
+    }
+}
+
+void TcpConnection::send(const void* data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->is_in_loop_thread() && queued_sends_ == 0)
+        {
+            send_in_loop_(data, len);
+        }
+        else
+        {
+            queue_send_(std::string(static_cast<const char*>(data), len));
         }
     }
 }
 
+void TcpConnection::queue_send_(std::string message)
+{
+    ++queued_sends_;
+    loop_->queue_in_loop(std::bind(&TcpConnection::send_queued_, shared_from_this(), std::move(message)),
+        EventLoop::kBulk);
+}
+
+void TcpConnection::send_queued_(const std::string& message)
+{
+    send_in_loop_(message);
+    /* shutdown()时还有排队的数据，由最后一个排队的send来关闭写端 */
+    if (--queued_sends_ == 0 && state_ == kDisconnecting)
+    {
+        shutdown_in_loop_();
+    }
+}
+
 void TcpConnection::send_in_loop_(const std::string& message)
 {
     send_in_loop_(message.data(), message.size());
@@ -93,7 +141,7 @@ void TcpConnection::send_in_loop_(const void* message, size_t len)
     /* 如果fd没有关注可写事件并且输出缓冲区无数据，则直接发送 
        ? !channel_->is_writing() 这里是针对什么情况，只用后面的判定不行吗？
      */
-    if (!channel_->is_writing() && output_buffer_.readable_bytes() == 0)
+    if (!channel_->is_writing() && output_buffer_.readable_bytes() == 0 && files_.empty())
     {
         nwrote = ::send(channel_->fd(), message, len, 0);
         if (nwrote >= 0)
@@ -121,19 +169,161 @@ void TcpConnection::send_in_loop_(const void* message, size_t len)
     }
 }
 
+void TcpConnection::flush_output()
+{
+    loop_->assert_in_loop_thread();
+    assert(queued_sends_ == 0);
+    /* 正在等待可写事件时，数据由handle_write_继续发送 */
+    if (state_ == kDisconnected || channel_->is_writing() || (output_buffer_.readable_bytes() == 0 && files_.empty()))
+    {
+        return;
+    }
+
+    if (write_pending_())
+    {
+        if (write_complete_callback_)
+        {
+            write_complete_callback_(shared_from_this());
+        }
+    }
+    else if (state_ != kDisconnected && !channel_->is_writing())
+    {
+        channel_->enable_writing();
+    }
+}
+
+void TcpConnection::stop_read()
+{
+    loop_->assert_in_loop_thread();
+    if (channel_->is_reading())
+    {
+        channel_->disable_reading();
+    }
+}
+
+void TcpConnection::start_read()
+{
+    loop_->assert_in_loop_thread();
+    if (state_ != kDisconnected && !channel_->is_reading())
+    {
+        channel_->enable_reading();
+    }
+}
+
+void TcpConnection::send_file(std::shared_ptr<const void> holder, int fd, off_t offset, size_t count)
+{
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected || count == 0)
+    {
+        return;
+    }
+
+    /* 缓冲区中最后一个文件之后的数据都要在这个文件之前发送 */
+    size_t preceding = output_buffer_.readable_bytes() - files_preceding_;
+    files_.push_back(PendingFile{std::move(holder), fd, nullptr, offset, count, preceding});
+    files_preceding_ += preceding;
+}
+
+void TcpConnection::send_shared(std::shared_ptr<const void> holder, const char* data, size_t len)
+{
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected || len == 0)
+    {
+        return;
+    }
+
+    size_t preceding = output_buffer_.readable_bytes() - files_preceding_;
+    files_.push_back(PendingFile{std::move(holder), -1, data, 0, len, preceding});
+    files_preceding_ += preceding;
+}
+
+/* 按顺序发送输出缓冲区和排队的文件，全部发送完返回true */
+bool TcpConnection::write_pending_()
+{
+    while (true)
+    {
+        size_t limit = files_.empty() ? output_buffer_.readable_bytes() : files_.front().preceding;
+        if (limit > 0)
+        {
+            ssize_t n = ::send(sockfd_, output_buffer_.peek(), limit, 0);
+            if (n <= 0)
+            {
+                if (n < 0 && errno != EAGAIN)
+                {
+                    printf("send(): %s\n", strerror(errno));
+                }
+                return false;
+            }
+            size_t sent = static_cast<size_t>(n);
+            output_buffer_.retrieve(sent);
+            if (!files_.empty())
+            {
+                files_.front().preceding -= sent;
+                files_preceding_ -= sent;
+            }
+            if (sent < limit)
+            {
+                return false;
+            }
+        }
+
+        if (files_.empty())
+        {
+            return true;
+        }
+
+        PendingFile& file = files_.front();
+        ssize_t n;
+        if (file.data)
+        {
+            n = ::send(sockfd_, file.data + file.offset, file.remaining, 0);
+            if (n > 0)
+            {
+                file.offset += n;
+            }
+        }
+        else
+        {
+            n = ::sendfile(sockfd_, file.fd, &file.offset, file.remaining);
+        }
+        if (n > 0)
+        {
+            file.remaining -= static_cast<size_t>(n);
+            if (file.remaining == 0)
+            {
+                files_.pop_front();
+            }
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            return false;
+        }
+        else
+        {
+            /* 文件被截短或者读出错，这个响应已经无法完整发送 */
+            printf("%s(): %s\n", file.data ? "send" : "sendfile", n == 0 ? "unexpected end of file" : strerror(errno));
+            files_.clear();
+            files_preceding_ = 0;
+            force_close();
+            return false;
+        }
+    }
+}
+
 void TcpConnection::shutdown()
 {
     if (connected())
     {
         set_state_(kDisconnecting);
-        loop_->run_in_loop(std::bind(&TcpConnection::shutdown_in_loop_, this));
+        loop_->run_in_loop(std::bind(&TcpConnection::shutdown_in_loop_, shared_from_this()), EventLoop::kUrgent);
     }
 }
 
 void TcpConnection::shutdown_in_loop_()
 {
     loop_->assert_in_loop_thread();
-    if (!channel_->is_writing())
+    /* 还有排队的数据或者输出缓冲区没写完，等它们发送完再关闭（见send_queued_和handle_write_） */
+    if (queued_sends_ == 0 && !channel_->is_writing())
     {
         if (::shutdown(sockfd_, SHUT_WR) < 0)
         {
@@ -143,6 +333,249 @@ void TcpConnection::shutdown_in_loop_()
     }
 }
 
+void TcpConnection::force_close()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        set_state_(kDisconnecting);
+        loop_->queue_in_loop(std::bind(&TcpConnection::force_close_in_loop_, shared_from_this()), EventLoop::kUrgent);
+    }
+}
+
+void TcpConnection::force_close_in_loop_()
+{
+    loop_->assert_in_loop_thread();
+    /* 排队期间连接可能已经被对端关闭 */
+    if (state_ != kDisconnected)
+    {
+        handle_close_();
+    }
+}
+
+void TcpConnection::complete_offload(uint64_t seq, const std::function<void()>& done)
+{
+    loop_->assert_in_loop_thread();
+    if (seq != offload_completed_)
+    {
+        /* 前面还有任务没完成，先保存起来 */
+        offload_ready_.emplace(seq, done);
+        return;
+    }
+
+    done();
+    ++offload_completed_;
+    while (!offload_ready_.empty() && offload_ready_.begin()->first == offload_completed_)
+    {
+        auto next = std::move(offload_ready_.begin()->second);
+        offload_ready_.erase(offload_ready_.begin());
+        next();
+        ++offload_completed_;
+    }
+}
+
+void TcpConnection::relay_to(const tcp_conn_ptr& peer)
+{
+    loop_->assert_in_loop_thread();
+    assert(peer->get_loop() == loop_);
+    if (relay_ || disconnected() || peer->disconnected())
+    {
+        return;
+    }
+
+    /* relay之前已经读到但还没处理的数据先按普通方式发给peer */
+    if (input_buffer_.readable_bytes() > 0)
+    {
+        peer->send(&input_buffer_);
+    }
+
+    relay_ = std::make_unique<Relay>();
+    relay_->peer = peer;
+    relay_->pipe = PipePool::acquire();
+    peer->relay_source_ = shared_from_this();
+    relay_pump_();
+}
+
+/**
+ *  先把管道中的数据写给peer，写空之后再从socket读进管道，直到某一步EAGAIN
+ *  peer输出缓冲区中还有数据时不能splice（会乱序），等peer的handle_write_写完后再回来
+ */
+void TcpConnection::relay_pump_()
+{
+    loop_->assert_in_loop_thread();
+    if (!relay_ || relay_->done)
+    {
+        return;
+    }
+
+    auto peer = relay_->peer.lock();
+    if (!peer || peer->disconnected())
+    {
+        handle_close_();
+        return;
+    }
+
+    while (true)
+    {
+        if (relay_->in_pipe > 0)
+        {
+            if (peer->output_buffer_.readable_bytes() > 0 || !peer->files_.empty() || peer->queued_sends_ > 0)
+            {
+                if (channel_->is_reading())
+                {
+                    channel_->disable_reading();
+                }
+                return;
+            }
+
+            ssize_t n = ::splice(relay_->pipe.read_fd, nullptr, peer->sockfd_, nullptr, relay_->in_pipe,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0)
+            {
+                relay_->in_pipe -= static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EAGAIN)
+            {
+                /* peer写不动了，停止读本连接，等peer可写 */
+                if (channel_->is_reading())
+                {
+                    channel_->disable_reading();
+                }
+                if (!peer->channel_->is_writing())
+                {
+                    peer->channel_->enable_writing();
+                }
+                return;
+            }
+            printf("splice(): %s\n", strerror(errno));
+            handle_close_();
+            return;
+        }
+
+        if (relay_->pipe.read_fd < 0)
+        {
+            relay_buffered_(peer);
+            return;
+        }
+
+        if (relay_->eof)
+        {
+            relay_finish_();
+            return;
+        }
+
+        ssize_t n = ::splice(sockfd_, nullptr, relay_->pipe.write_fd, nullptr, relay_->pipe.capacity,
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            relay_->in_pipe = static_cast<size_t>(n);
+            touch_idle_();
+            peer->touch_idle_();
+        }
+        else if (n == 0)
+        {
+            relay_->eof = true;
+        }
+        else if (errno == EAGAIN)
+        {
+            if (!channel_->is_reading())
+            {
+                channel_->enable_reading();
+            }
+            return;
+        }
+        else
+        {
+            if (errno != ECONNRESET)
+            {
+                printf("splice(): %s\n", strerror(errno));
+            }
+            handle_close_();
+            return;
+        }
+    }
+}
+
+/**
+ *  没有拿到管道（fd用完）时的转发：读进input_buffer_再send给peer，
+ *  peer的输出缓冲区写空之后才继续读，背压和splice时相同
+ */
+void TcpConnection::relay_buffered_(const tcp_conn_ptr& peer)
+{
+    while (true)
+    {
+        if (peer->output_buffer_.readable_bytes() > 0 || !peer->files_.empty() || peer->queued_sends_ > 0)
+        {
+            if (channel_->is_reading())
+            {
+                channel_->disable_reading();
+            }
+            return;
+        }
+        if (relay_->eof)
+        {
+            relay_finish_();
+            return;
+        }
+        /* peer已经在关闭，读到的数据发不出去，停止读取，等peer关闭时再关闭本连接，不让input_buffer_无限增长 */
+        if (!peer->connected())
+        {
+            if (channel_->is_reading())
+            {
+                channel_->disable_reading();
+            }
+            return;
+        }
+
+        int saved_errno = 0;
+        ssize_t n = input_buffer_.readfd(sockfd_, &saved_errno);
+        if (n > 0)
+        {
+            touch_idle_();
+            peer->touch_idle_();
+            peer->send(&input_buffer_);
+        }
+        else if (n == 0)
+        {
+            relay_->eof = true;
+        }
+        else if (saved_errno == EAGAIN)
+        {
+            if (!channel_->is_reading())
+            {
+                channel_->enable_reading();
+            }
+            return;
+        }
+        else
+        {
+            if (saved_errno != ECONNRESET)
+            {
+                printf("read(): %s\n", strerror(saved_errno));
+            }
+            handle_close_();
+            return;
+        }
+    }
+}
+
+/* 本连接读到EOF并且数据都已经写给peer：把半关闭传给peer，两个方向都结束后关闭两个连接 */
+void TcpConnection::relay_finish_()
+{
+    relay_->done = true;
+    if (channel_->is_reading())
+    {
+        channel_->disable_reading();
+    }
+    auto peer = relay_->peer.lock();
+    peer->shutdown();
+    if (peer->relay_ && peer->relay_->done)
+    {
+        peer->force_close();
+        force_close();
+    }
+}
+
 void TcpConnection::set_tcp_no_delay(bool on)
 {
     int optval = on ? 1 : 0;
@@ -158,6 +591,12 @@ void TcpConnection::set_keep_alive(bool on)
 void TcpConnection::handle_read_()
 {
     loop_->assert_in_loop_thread();
+    if (relay_)
+    {
+        relay_pump_();
+        return;
+    }
+
     int saved_errno = 0;
     ssize_t recv_nums = input_buffer_.readfd(sockfd_, &saved_errno);
 
@@ -167,6 +606,7 @@ void TcpConnection::handle_read_()
     }
     else
     {
+        touch_idle_();
         message_callback_(shared_from_this(), input_buffer_);
     }
 }
@@ -174,30 +614,52 @@ void TcpConnection::handle_read_()
 void TcpConnection::handle_write_()
 {
     loop_->assert_in_loop_thread();
-    if (channel_->is_writing())
+    if (!channel_->is_writing())
     {
-        auto n = ::send(channel_->fd(), output_buffer_.peek(), output_buffer_.readable_bytes(), 0);
-        if (n > 0)
+        return;
+    }
+
+    /* 没有待发送的数据时关注可写事件，只可能是在等待splice转发的数据写出去 */
+    if (output_buffer_.readable_bytes() == 0 && files_.empty())
+    {
+        channel_->disable_writing();
+        if (auto source = relay_source_.lock())
         {
-            output_buffer_.retrieve(n);
-            /* 如果读完了，缓冲区没有数据了，取消关注可写事件 */
-            if (output_buffer_.readable_bytes() == 0)
-            {
-                channel_->disable_writing();
-                if (write_complete_callback_)
-                {
-                    write_complete_callback_(shared_from_this());
-                }
-            }
-            else
-            {
-                printf("I am going to write more data\n");
-            }
+            source->relay_pump_();
         }
-        else
+        return;
+    }
+
+    /* 如果都写完了，取消关注可写事件 */
+    if (write_pending_())
+    {
+        channel_->disable_writing();
+        if (write_complete_callback_)
+        {
+            write_complete_callback_(shared_from_this());
+        }
+        if (auto source = relay_source_.lock())
         {
-            printf("send(): some error happened!\n");
+            source->relay_pump_();
         }
+        if (state_ == kDisconnecting)
+        {
+            shutdown_in_loop_();
+        }
+    }
+}
+
+/* 空闲超时先shutdown，对方再过一个idle_timeout仍不关闭（之后收到的数据不再推迟）时强制关闭，不让它一直占着fd */
+void TcpConnection::handle_idle_()
+{
+    if (state_ == kConnected)
+    {
+        shutdown();
+        wheel_->schedule(&idle_node_, idle_timeout_);
+    }
+    else
+    {
+        force_close();
     }
 }
 
@@ -206,6 +668,26 @@ void TcpConnection::handle_close_()
     loop_->assert_in_loop_thread();
     set_state_(kDisconnected);
     channel_->disable_all();
+    if (wheel_)
+    {
+        wheel_->cancel(&idle_node_);
+    }
+
+    /* 转发的一边断开，另一边也没有继续存在的意义 */
+    if (relay_)
+    {
+        PipePool::release(relay_->pipe, relay_->in_pipe == 0);
+        auto peer = relay_->peer.lock();
+        relay_.reset();
+        if (peer)
+        {
+            peer->force_close();
+        }
+    }
+    if (auto source = relay_source_.lock())
+    {
+        source->force_close();
+    }
 
     auto ptr = shared_from_this();
     connection_callback_(ptr);
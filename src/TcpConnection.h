@@ -3,16 +3,21 @@
 #include "src/Channel.h"
 #include "src/common.h"
 #include "src/Buffer.h"
+#include "src/TimerWheel.h"
+#include "src/SockAddr.h"
+#include "src/PipePool.h"
 
-#include <netinet/in.h>
 #include <memory>
 #include <any>
 #include <atomic>
+#include <map>
+#include <deque>
+#include <sys/types.h>
 
 class TcpConnection : public std::enable_shared_from_this<TcpConnection>
 {
 public:
-    TcpConnection(EventLoop* loop, int sockfd, const struct sockaddr_in& peer_addr);
+    TcpConnection(EventLoop* loop, int sockfd, const SockAddr& peer_addr);
     ~TcpConnection();
 
     TcpConnection(const TcpConnection&) = delete;
@@ -38,15 +43,71 @@ public:
         write_complete_callback_ = std::move(cb);
     }
 
+    /**
+     *  所属IO线程的时间轮和空闲超时，超过idle_timeout没有数据到来时shutdown，
+     *  再过idle_timeout对方仍未关闭时强制关闭，为0时不检查空闲
+     *  必须在connect_established之前设置；之后只能在时间轮析构前设为nullptr，让连接脱离它
+     */
+    void set_timer_wheel(TimerWheel* wheel, timer_clock::duration idle_timeout)
+    {
+        wheel_ = wheel;
+        idle_timeout_ = idle_timeout;
+    }
+    /* 只能在IO线程中使用，上层协议的超时可以共用，没有设置时为nullptr（例如TcpClient的连接） */
+    TimerWheel* timer_wheel() const { return wheel_; }
+
     int fd() const { return sockfd_; }
-    struct sockaddr_in peer_addr() const { return peer_addr_; }
+    /* 在所属IO线程连接表中的generation，与fd一起唯一标识一个连接 */
+    uint32_t generation() const { return generation_; }
+    void set_generation(uint32_t generation) { generation_ = generation; }
+    EventLoop* get_loop() const { return loop_; }
+
+    /* 只能在IO线程中使用 */
+    Buffer* input_buffer() { return &input_buffer_; }
+    /**
+     *  只能在IO线程中使用，并且不能与其他线程的send混用（会打乱顺序）
+     *  直接往输出缓冲区追加数据，省掉一次拷贝，追加完调用flush_output发送
+     */
+    Buffer* output_buffer() { return &output_buffer_; }
+    void flush_output();
+    /* 只能在IO线程中使用，输出缓冲区或者send_file/send_shared排队的数据还没有发送完 */
+    bool has_pending_output() const { return output_buffer_.readable_bytes() > 0 || !files_.empty(); }
+
+    /* 只能在IO线程中使用：暂停/恢复从本连接读数据，用于背压；暂停期间数据留在内核接收缓冲区 */
+    void stop_read();
+    void start_read();
+
+    /**
+     *  只能在IO线程中使用：在当前输出缓冲区中的数据之后，用sendfile(2)发送文件fd中从offset开始的count个字节，
+     *  之后追加到输出缓冲区的数据在文件之后发送；holder在发送完之前保持fd有效
+     *  需要调用flush_output开始发送
+     */
+    void send_file(std::shared_ptr<const void> holder, int fd, off_t offset, size_t count);
+
+    /**
+     *  只能在IO线程中使用：与send_file相同，只是发送的是holder持有的内存[data, data + len)，不拷贝到输出缓冲区，
+     *  用于多个连接共享的只读数据
+     */
+    void send_shared(std::shared_ptr<const void> holder, const char* data, size_t len);
+    const SockAddr& peer_addr() const { return peer_addr_; }
 
     void connect_established();
 
     void send(const std::string& message);
     void send(std::string&& message);
     void send(Buffer* buf);
+    void send(const void* data, size_t len);
     void shutdown();
+    /* 不等待输出缓冲区发送完，立即关闭连接，可以在任意线程调用 */
+    void force_close();
+
+    /**
+     *  之后从本连接读到的数据用splice(2)经过管道直接转发给peer，不再经过用户态缓冲区和message_callback
+     *  只转发一个方向，双向转发需要两边都调用；peer必须属于同一个EventLoop，只能在IO线程调用
+     *  peer写不动时停止读本连接（背压），本连接读到EOF后shutdown peer，
+     *  两个方向都结束或者任意一边出错时关闭两个连接
+     */
+    void relay_to(const tcp_conn_ptr& peer);
 
     void set_tcp_no_delay(bool on);
     void set_keep_alive(bool on);
@@ -55,6 +116,10 @@ public:
     const std::any& get_context() const { return context_; }
     std::any* get_mutable_context() { return &context_; }
 
+    /* 供ThreadPool::submit使用，保证同一连接的完成回调按提交顺序执行，都只能在IO线程调用 */
+    uint64_t next_offload_seq() { return offload_submitted_++; }
+    void complete_offload(uint64_t seq, const std::function<void()>& done);
+
     bool connected() const { return state_.load(std::memory_order_relaxed) == kConnected; }
     bool disconnected() const { return state_.load(std::memory_order_relaxed) == kDisconnected; }
 
@@ -67,16 +132,33 @@ private:
     void set_state_(tcp_state_num state) { state_.store(state, std::memory_order_relaxed); }
 
     void send_in_loop_(const void* message, size_t len);
+    void queue_send_(std::string message);
+    void send_queued_(const std::string& message);
     void send_in_loop_(const std::string& message);
     void shutdown_in_loop_();
+    void force_close_in_loop_();
+    bool write_pending_();
+    void relay_pump_();
+    void relay_buffered_(const tcp_conn_ptr& peer);
+    void relay_finish_();
+    /* 有数据到来时推迟空闲超时，推迟只修改到期时间，不移动节点 */
+    void handle_idle_();
+    void touch_idle_()
+    {
+        if (idle_timeout_ > timer_clock::duration::zero() && state_ == kConnected)
+        {
+            wheel_->schedule(&idle_node_, idle_timeout_);
+        }
+    }
 
 private:
     static const size_t kMaxBuffer = 1024;
 
     EventLoop* loop_;
     int sockfd_;
+    uint32_t generation_;
     std::unique_ptr<Channel> channel_;
-    struct sockaddr_in peer_addr_;
+    SockAddr peer_addr_;
     message_callback message_callback_;                 /* 消息到来 */
     close_callback close_callback_;                     /* 连接的断开 被设置为TcpServer::remove_connection */
     connection_callback connection_callback_;           /* 连接的建立 */
@@ -86,4 +168,34 @@ private:
     Buffer output_buffer_;  /* 发送缓冲区 */
     std::atomic<tcp_state_num> state_;
     std::any context_;  // !使用expired
+    TimerWheel* wheel_;                 /* 所属IO线程的时间轮 */
+    timer_clock::duration idle_timeout_;
+    TimerWheel::Node idle_node_;
+    uint64_t offload_submitted_;    /* 已提交到ThreadPool的任务数 */
+    uint64_t offload_completed_;    /* 已按顺序完成的任务数 */
+    std::map<uint64_t, std::function<void()>> offload_ready_;  /* 提前完成、等待前面任务的完成回调 */
+    std::atomic<size_t> queued_sends_;  /* 已排队但还没在IO线程执行的send */
+
+    struct Relay
+    {
+        std::weak_ptr<TcpConnection> peer;
+        PipePool::Pipe pipe;
+        size_t in_pipe = 0;     /* 已经读进管道、还没写给peer的字节数 */
+        bool eof = false;       /* 本连接已经读到EOF */
+        bool done = false;      /* EOF之前的数据都已经写给peer，peer已经shutdown */
+    };
+    struct PendingFile
+    {
+        std::shared_ptr<const void> holder;
+        int fd;
+        const char* data;   /* 非空时发送这段内存，而不是fd */
+        off_t offset;
+        size_t remaining;
+        size_t preceding;   /* 输出缓冲区中要在这个文件之前发送的字节数 */
+    };
+    std::deque<PendingFile> files_;     /* 等待sendfile的文件，按顺序与输出缓冲区交错发送 */
+    size_t files_preceding_;            /* files_中所有preceding之和 */
+
+    std::unique_ptr<Relay> relay_;                  /* 本连接转发给peer的状态，relay_to之后才有 */
+    std::weak_ptr<TcpConnection> relay_source_;     /* 转发到本连接的源连接，本连接可写时继续转发 */
 };
\ No newline at end of file
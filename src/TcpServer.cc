@@ -3,7 +3,11 @@
 #include "src/Acceptor.h"
 #include "src/TcpConnection.h"
 #include "src/EventLoopThreadPool.h"
+#include "src/TimerWheel.h"
+#include "src/IpRateLimiter.h"
+#include "src/EventLoop.h"
 
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -12,27 +16,176 @@
 #include <cstdio>
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
 
 using namespace std::placeholders;
 
+/* IO线程延迟探测的间隔 */
+const timer_clock::duration kProbeInterval = std::chrono::milliseconds(50);
+/* drain时检查连接数的间隔 */
+const timer_clock::duration kDrainCheckInterval = std::chrono::milliseconds(10);
+/* 被拒绝的连接发送拒绝消息后等待对方关闭的最长时间，以及同时等待的上限，超过上限时直接关闭 */
+const timer_clock::duration kRejectLinger = std::chrono::milliseconds(500);
+const size_t kMaxRejectLingering = 1024;
+
 TcpServer::TcpServer(EventLoop* loop, std::string ip, uint16_t port)
+    : TcpServer(loop, SockAddr(ip, port))
+{}
+
+TcpServer::TcpServer(EventLoop* loop, const SockAddr& listen_addr)
+    : TcpServer(loop, std::make_unique<Acceptor>(loop, listen_addr))
+{}
+
+TcpServer::TcpServer(EventLoop* loop, int listenfd)
+    : TcpServer(loop, std::make_unique<Acceptor>(loop, listenfd))
+{}
+
+TcpServer::TcpServer(EventLoop* loop, std::unique_ptr<Acceptor> acceptor)
     : loop_(loop)
-    , acceptor_(std::make_unique<Acceptor>(loop_, std::move(ip), port))
+    , acceptor_(std::move(acceptor))
     , thread_pool_(std::make_shared<EventLoopThreadPool>(loop))
+    , idle_timeout_(timer_clock::duration::zero())
+    , wheel_tick_(timer_clock::duration::zero())
+    , next_shard_(0)
+    , num_connections_(0)
+    , max_connections_(0)
+    , max_loop_lag_(timer_clock::duration::zero())
+    , num_rejected_(0)
+    , next_rejected_id_(0)
+    , draining_(false)
+    , drain_forced_(false)
 {
     acceptor_->set_new_connection_callback(
         std::bind(&TcpServer::handle_listenfd_, this, _1, _2)
     );
 }
 
+/* 没有IO线程时连接属于base loop，TcpServer析构后它们关闭时只负责延迟释放连接（同TcpClient） */
+void detach_server_connection(EventLoop* loop, const tcp_conn_ptr& conn)
+{
+    loop->queue_in_loop([conn] {});
+}
+
+void discard_server_message(const tcp_conn_ptr&, Buffer& buf)
+{
+    buf.retrieve_all();
+}
+
 TcpServer::~TcpServer()
 {
-    // TODO: close all conn in connections_
+    loop_->assert_in_loop_thread();
+    if (probe_timer_)
+    {
+        loop_->cancel(probe_timer_);
+    }
+    if (drain_timer_)
+    {
+        loop_->cancel(drain_timer_);
+    }
+    while (!rejected_.empty())
+    {
+        close_rejected_(rejected_.begin()->first);
+    }
+    /* IO线程中投递的任务和连接的close回调都引用Shard和this，释放之前连接必须都已经移出连接表 */
+    force_close_all();
+
+    /**
+     *  base loop上的连接要等它下一次运行才真正关闭，那时TcpServer和拥有它的对象都已经不在了，
+     *  所以换掉所有回调，不再通知用户；时间轮也随Shard释放，先让连接脱离它
+     */
+    for (const auto& shard : shards_)
+    {
+        if (shard->loop == loop_)
+        {
+            shard->connections.for_each([this](const tcp_conn_ptr& conn) {
+                conn->set_connection_callback([](const tcp_conn_ptr&) {});
+                conn->set_message_callback(discard_server_message);
+                conn->set_write_complete_callback(nullptr);
+                conn->set_close_callback(std::bind(&detach_server_connection, loop_, _1));
+                conn->set_timer_wheel(nullptr, timer_clock::duration::zero());
+            });
+        }
+    }
+
+    /* 时间轮的tick定时器绑定了裸指针，只有在它自己的IO线程中才能同步取消，所以在那里析构 */
+    for (const auto& shard : shards_)
+    {
+        if (!shard->wheel)
+        {
+            continue;
+        }
+        if (shard->loop == loop_)
+        {
+            shard->wheel.reset();
+            continue;
+        }
+        wait_in_shard_(shard.get(), &TcpServer::destroy_wheel_);
+        if (shard->wheel)
+        {
+            /* IO线程已经退出，tick定时器随它的EventLoop一起销毁了，时间轮不能再析构，只能放弃 */
+            (void)shard->wheel.release();
+        }
+    }
+}
+
+/* 之前投递的new_connection_in_loop_排在close_shard_前面，会先执行，所以不会漏掉正在建立的连接 */
+void TcpServer::force_close_all()
+{
+    loop_->assert_in_loop_thread();
+    for (const auto& shard : shards_)
+    {
+        if (shard->loop == loop_)
+        {
+            force_close_shard_(shard.get());
+            continue;
+        }
+        wait_in_shard_(shard.get(), &TcpServer::close_shard_);
+    }
+}
+
+/**
+ *  在shard的IO线程中执行task，等它完成promise才返回；IO线程已经退出时直接返回
+ *  promise由task持有，IO线程在task执行之前退出时task随EventLoop析构，promise析构同样结束等待
+ */
+void TcpServer::wait_in_shard_(Shard* shard, shard_task task)
+{
+    auto done = std::make_shared<std::promise<void>>();
+    std::future<void> finished = done->get_future();
+    if (thread_pool_->queue_in_loop(shard->loop, std::bind(task, shard, std::move(done))))
+    {
+        finished.wait();
+    }
 }
 
 void TcpServer::start()
 {
+    /* 空闲超时的精度是它的1/8 */
+    timer_clock::duration tick = wheel_tick_;
+    if (idle_timeout_ > timer_clock::duration::zero())
+    {
+        timer_clock::duration idle_tick = idle_timeout_ / 8;
+        tick = tick > timer_clock::duration::zero() ? std::min(tick, idle_tick) : idle_tick;
+    }
+    if (tick > timer_clock::duration::zero())
+    {
+        tick = std::max(tick, timer_clock::duration(std::chrono::milliseconds(1)));
+    }
+
     thread_pool_->start(thread_init_callback_);
+    for (EventLoop* ioloop : thread_pool_->get_all_loops())
+    {
+        auto shard = std::make_unique<Shard>();
+        shard->loop = ioloop;
+        if (tick > timer_clock::duration::zero())
+        {
+            shard->wheel = std::make_unique<TimerWheel>(ioloop, tick);
+        }
+        shards_.push_back(std::move(shard));
+    }
+    if (max_loop_lag_ > timer_clock::duration::zero())
+    {
+        probe_timer_ = loop_->run_every(kProbeInterval, std::bind(&TcpServer::probe_loops_, this));
+    }
     loop_->run_in_loop(std::bind(&Acceptor::listen, acceptor_.get()));
 }
 
@@ -41,30 +194,253 @@ void TcpServer::set_thread_num(int num_threads)
     thread_pool_->set_thread_num(num_threads);
 }
 
-void TcpServer::handle_listenfd_(int clientfd, struct sockaddr_in client_addr)
+void TcpServer::set_per_ip_rate_limit(double rate, double burst)
+{
+    rate_limiter_ = std::make_unique<IpRateLimiter>(rate, burst);
+}
+
+int TcpServer::listen_fd() const
+{
+    return acceptor_->listen_fd();
+}
+
+void TcpServer::stop_accepting()
 {
     loop_->assert_in_loop_thread();
-    EventLoop* ioloop = thread_pool_->get_next_loop();
-    
-    auto conn = std::make_shared<TcpConnection>(ioloop, clientfd, client_addr);
-    conn->set_message_callback(message_callback_);
-    conn->set_connection_callback(connection_callback_);
-    conn->set_close_callback(std::bind(&TcpServer::remove_connection_, this, _1));
-    conn->set_write_complete_callback(write_complete_callback_);
-    connections_[clientfd] = conn;
-    
-    ioloop->run_in_loop(std::bind(&TcpConnection::connect_established, conn));
+    acceptor_->stop();
+}
+
+void TcpServer::drain(timer_clock::duration timeout, std::function<void()> done)
+{
+    loop_->assert_in_loop_thread();
+    stop_accepting();
+    draining_.store(true, std::memory_order_relaxed);
+    drain_deadline_ = timer_clock::now() + timeout;
+    drain_done_ = std::move(done);
+    drain_timer_ = loop_->run_every(kDrainCheckInterval, std::bind(&TcpServer::check_drain_, this));
+    check_drain_();
+}
+
+void TcpServer::check_drain_()
+{
+    if (!drain_done_)
+    {
+        return;
+    }
+    if (num_connections() == 0)
+    {
+        loop_->cancel(drain_timer_);
+        auto done = std::move(drain_done_);
+        drain_done_ = nullptr;
+        done();
+    }
+    else if (!drain_forced_ && timer_clock::now() >= drain_deadline_)
+    {
+        drain_forced_ = true;
+        for (const auto& shard : shards_)
+        {
+            shard->loop->run_in_loop(std::bind(&TcpServer::force_close_shard_, shard.get()), EventLoop::kUrgent);
+        }
+    }
+}
+
+void TcpServer::force_close_shard_(Shard* shard)
+{
+    /* 关闭会修改连接表，先复制出来 */
+    std::vector<tcp_conn_ptr> conns;
+    conns.reserve(shard->connections.size());
+    shard->connections.for_each([&conns](const tcp_conn_ptr& conn) { conns.push_back(conn); });
+    for (const tcp_conn_ptr& conn : conns)
+    {
+        conn->force_close();
+    }
 }
 
-void TcpServer::remove_connection_(const tcp_conn_ptr& conn)
+/* 在shard的IO线程中反复强制关闭连接，直到close回调把它们全部移出连接表 */
+void TcpServer::close_shard_(Shard* shard, const std::shared_ptr<std::promise<void>>& closed)
 {
-    loop_->run_in_loop(std::bind(&TcpServer::remove_connection_in_loop_, this, conn));
+    if (shard->connections.size() == 0)
+    {
+        closed->set_value();
+        return;
+    }
+    force_close_shard_(shard);
+    /* force_close在下一轮执行，这个检查排在它后面 */
+    shard->loop->queue_in_loop(std::bind(&TcpServer::close_shard_, shard, closed));
 }
 
-void TcpServer::remove_connection_in_loop_(const tcp_conn_ptr& conn)
+void TcpServer::destroy_wheel_(Shard* shard, const std::shared_ptr<std::promise<void>>& destroyed)
+{
+    shard->wheel.reset();
+    destroyed->set_value();
+}
+
+/* base loop只负责准入检查和分配，TcpConnection在它所属的IO线程中创建 */
+void TcpServer::handle_listenfd_(int clientfd, const SockAddr& client_addr)
 {
     loop_->assert_in_loop_thread();
-    size_t n = connections_.erase(conn->fd());
+    timer_clock::time_point now = timer_clock::now();
+    if (max_connections_ > 0 && num_connections() >= max_connections_)
+    {
+        reject_(clientfd);
+        return;
+    }
+    if (rate_limiter_ && !rate_limiter_->allow(client_addr, now))
+    {
+        reject_(clientfd);
+        return;
+    }
+    Shard* shard = pick_shard_(now);
+    if (!shard)
+    {
+        reject_(clientfd);
+        return;
+    }
+    num_connections_.fetch_add(1, std::memory_order_relaxed);
+
+    shard->loop->run_in_loop(
+        std::bind(&TcpServer::new_connection_in_loop_, this, shard, clientfd, client_addr), EventLoop::kUrgent);
+}
+
+/* 轮询选择IO线程，跳过延迟过高的，全部过高时返回nullptr */
+TcpServer::Shard* TcpServer::pick_shard_(timer_clock::time_point now)
+{
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        Shard* shard = shards_[next_shard_].get();
+        next_shard_ = (next_shard_ + 1) % shards_.size();
+        if (max_loop_lag_ == timer_clock::duration::zero() || shard->lag(now) <= max_loop_lag_)
+        {
+            return shard;
+        }
+    }
+    return nullptr;
+}
+
+void TcpServer::reject_(int clientfd)
+{
+    num_rejected_.fetch_add(1, std::memory_order_relaxed);
+    if (reject_message_.empty() || rejected_.size() >= kMaxRejectLingering)
+    {
+        /* 直接RST，服务端不会留下TIME_WAIT */
+        struct linger lg = {1, 0};
+        ::setsockopt(clientfd, SOL_SOCKET, SO_LINGER, &lg, static_cast<socklen_t>(sizeof(lg)));
+        ::close(clientfd);
+        return;
+    }
+
+    /* 新连接的发送缓冲区是空的，一次非阻塞send就够了，发不完也不再管 */
+    ssize_t n = ::send(clientfd, reject_message_.data(), reject_message_.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
     (void)n;
-    assert(n == 1);
-}
\ No newline at end of file
+    ::shutdown(clientfd, SHUT_WR);
+
+    /* 接收缓冲区中还有数据时close会发送RST，对方可能来不及读到拒绝消息，所以读掉它们，等对方关闭 */
+    uint64_t id = next_rejected_id_++;
+    Rejected& rejected = rejected_[id];
+    rejected.channel = std::make_unique<Channel>(loop_, clientfd);
+    rejected.channel->set_read_callback(std::bind(&TcpServer::drain_rejected_, this, id));
+    rejected.channel->enable_reading();
+    rejected.timer = loop_->run_after(kRejectLinger, std::bind(&TcpServer::close_rejected_, this, id));
+}
+
+void TcpServer::drain_rejected_(uint64_t id)
+{
+    auto it = rejected_.find(id);
+    if (it == rejected_.end())
+    {
+        return;
+    }
+    /* 每次可读事件最多读这么多轮，不让对方一直发送来占住base loop */
+    char buf[4096];
+    for (int i = 0; i < 16; ++i)
+    {
+        ssize_t n = ::recv(it->second.channel->fd(), buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            return;
+        }
+        /* 对方已经关闭或者出错 */
+        close_rejected_(id);
+        return;
+    }
+}
+
+void TcpServer::close_rejected_(uint64_t id)
+{
+    auto it = rejected_.find(id);
+    if (it == rejected_.end())
+    {
+        return;
+    }
+    loop_->cancel(it->second.timer);
+    it->second.channel->disable_all();
+    ::close(it->second.channel->fd());
+    /* 可能正在这个Channel的事件回调中，到pending functor中再析构 */
+    std::shared_ptr<Channel> channel(std::move(it->second.channel));
+    loop_->queue_in_loop([channel] {});
+    rejected_.erase(it);
+}
+
+/* 定期给每个IO线程投递一个探测任务，上一个还没执行的就不再投递 */
+void TcpServer::probe_loops_()
+{
+    int64_t now = timer_clock::now().time_since_epoch().count();
+    for (const auto& shard : shards_)
+    {
+        int64_t expected = 0;
+        if (shard->probe_sent_ns.compare_exchange_strong(expected, now, std::memory_order_relaxed))
+        {
+            shard->loop->queue_in_loop(std::bind(&Shard::on_probe, shard.get()));
+        }
+    }
+}
+
+void TcpServer::Shard::on_probe()
+{
+    int64_t now = timer_clock::now().time_since_epoch().count();
+    lag_ns.store(now - probe_sent_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    probe_sent_ns.store(0, std::memory_order_relaxed);
+}
+
+/* 探测任务迟迟不执行时（例如IO线程卡住），它已经等待的时间也算作延迟 */
+timer_clock::duration TcpServer::Shard::lag(timer_clock::time_point now) const
+{
+    int64_t sent = probe_sent_ns.load(std::memory_order_relaxed);
+    int64_t lag = lag_ns.load(std::memory_order_relaxed);
+    if (sent != 0)
+    {
+        lag = std::max(lag, now.time_since_epoch().count() - sent);
+    }
+    return timer_clock::duration(lag);
+}
+
+void TcpServer::new_connection_in_loop_(Shard* shard, int clientfd, const SockAddr& client_addr)
+{
+    shard->loop->assert_in_loop_thread();
+    auto conn = std::make_shared<TcpConnection>(shard->loop, clientfd, client_addr);
+    conn->set_message_callback(message_callback_);
+    conn->set_connection_callback(connection_callback_);
+    conn->set_close_callback(std::bind(&TcpServer::remove_connection_, this, shard, _1));
+    conn->set_write_complete_callback(write_complete_callback_);
+    conn->set_timer_wheel(shard->wheel.get(), idle_timeout_);
+    conn->set_generation(shard->connections.insert(conn));
+
+    conn->connect_established();
+}
+
+/* 在连接所属的IO线程中调用，不需要回到base loop */
+void TcpServer::remove_connection_(Shard* shard, const tcp_conn_ptr& conn)
+{
+    shard->loop->assert_in_loop_thread();
+    bool removed = shard->connections.remove(conn->fd(), conn->generation());
+    (void)removed;
+    assert(removed);
+    num_connections_.fetch_sub(1, std::memory_order_relaxed);
+
+    /* 此时还在conn的事件回调中，让最后一个引用在本轮循环的pending functor中释放 */
+    shard->loop->queue_in_loop([conn] {});
+}
@@ -3,17 +3,30 @@
 #include "src/Channel.h"
 #include "src/common.h"
 
+#include "src/ConnectionTable.h"
+#include "src/SockAddr.h"
+
 #include <string>
-#include <map>
+#include <atomic>
+#include <future>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 class Acceptor;
 class EventLoopThreadPool;
+class TimerWheel;
+class IpRateLimiter;
 
 class TcpServer : public std::enable_shared_from_this<TcpServer>
 {
 public:
     TcpServer(EventLoop* loop, std::string ip, uint16_t port);
+    /* 监听IPv4/IPv6/AF_UNIX地址，见SockAddr */
+    TcpServer(EventLoop* loop, const SockAddr& listen_addr);
+    /* 接管已经bind的监听fd，通常来自ListenerHandoff::take_over() */
+    TcpServer(EventLoop* loop, int listenfd);
+    /* 必须在base loop所在线程中析构，最好先drain()；还有连接时调用force_close_all */
     ~TcpServer();
 
     TcpServer(const TcpServer&) = delete;
@@ -47,16 +60,115 @@ public:
     
     void set_thread_num(int num_threads);
 
+    /* 超过timeout没有数据到来的连接会被shutdown，再过timeout对方仍未关闭时强制关闭，必须在start()之前设置 */
+    void set_idle_timeout(timer_clock::duration timeout) { idle_timeout_ = timeout; }
+    /**
+     *  上层协议（例如HttpServer）需要每个IO线程的时间轮时，在start()之前设置它要求的精度，
+     *  与空闲超时共用一个时间轮，精度取两者中较小的；连接通过TcpConnection::timer_wheel()取得
+     */
+    void set_wheel_tick(timer_clock::duration tick) { wheel_tick_ = tick; }
+
+    /**
+     *  准入控制，都必须在start()之前设置
+     *  被拒绝的连接在base loop中直接关闭，不会创建TcpConnection，也不会交给IO线程
+     */
+    /* 连接数达到max后拒绝新连接，0表示不限制 */
+    void set_max_connections(size_t max) { max_connections_ = max; }
+    /* 每个来源IP每秒最多rate个新连接，允许突发burst个，AF_UNIX连接不受限制 */
+    void set_per_ip_rate_limit(double rate, double burst);
+    /* IO线程处理任务的延迟超过max_lag时不再给它分配连接，所有IO线程都超过时拒绝 */
+    void set_max_loop_lag(timer_clock::duration max_lag) { max_loop_lag_ = max_lag; }
+    /**
+     *  拒绝连接时先发送的内容（例如一个503响应），为空时直接RST
+     *  发送后shutdown写端，再读掉对方的数据等它关闭（最多kRejectLinger），避免close时未读的数据触发RST冲掉这个响应
+     */
+    void set_reject_message(std::string message) { reject_message_ = std::move(message); }
+
+    int listen_fd() const;
+    EventLoop* get_loop() const { return loop_; }
+
+    /* 停止accept新连接，已有连接不受影响，只能在base loop中调用 */
+    void stop_accepting();
+    /**
+     *  平滑退出：停止accept，等待已有连接自行关闭，超过timeout后强制关闭剩下的连接，
+     *  全部关闭后在base loop中调用done，只能在base loop中调用
+     */
+    void drain(timer_clock::duration timeout, std::function<void()> done);
+    /**
+     *  在各自的IO线程中强制关闭所有连接，等它们的connection回调执行完、连接移出连接表才返回，只能在base loop中调用；
+     *  不停止accept。没有IO线程时连接属于base loop，在它下一次运行时关闭；已经退出的IO线程跳过，不等待
+     *  拥有TcpServer的对象应该在自己的析构函数中先调用，回调中用到的成员此时还没有析构
+     */
+    void force_close_all();
+    /* drain()之后为true，业务代码可以据此提示客户端断开（例如HTTP的Connection: close） */
+    bool draining() const { return draining_.load(std::memory_order_relaxed); }
+
+    /* 当前连接数和被拒绝的连接数，可以在任意线程调用 */
+    size_t num_connections() const { return num_connections_.load(std::memory_order_relaxed); }
+    uint64_t num_rejected() const { return num_rejected_.load(std::memory_order_relaxed); }
+
 private:
-    void handle_listenfd_(int clientfd, struct sockaddr_in client_addr);    /* 处理监听套接字可读事件的回调函数，通常表示有新连接到来 */
-    void remove_connection_(const tcp_conn_ptr& conn);
-    void remove_connection_in_loop_(const tcp_conn_ptr& conn);
+    TcpServer(EventLoop* loop, std::unique_ptr<Acceptor> acceptor);
+
+    /* 每个IO线程的连接状态，除了延迟探测的两个原子量，只在该IO线程中访问 */
+    struct Shard
+    {
+        EventLoop* loop;
+        ConnectionTable connections;
+        std::unique_ptr<TimerWheel> wheel;      /* 没有开启空闲超时、也没有设置wheel_tick时为nullptr */
+        std::atomic<int64_t> probe_sent_ns{0};  /* 还没执行的探测任务的投递时刻，0表示没有 */
+        std::atomic<int64_t> lag_ns{0};         /* 最近一次探测任务从投递到执行的延迟 */
+
+        void on_probe();
+        timer_clock::duration lag(timer_clock::time_point now) const;
+    };
+
+    void handle_listenfd_(int clientfd, const SockAddr& client_addr);    /* 处理监听套接字可读事件的回调函数，通常表示有新连接到来 */
+    Shard* pick_shard_(timer_clock::time_point now);
+    void reject_(int clientfd);
+    void drain_rejected_(uint64_t id);
+    void close_rejected_(uint64_t id);
+    void probe_loops_();
+    void new_connection_in_loop_(Shard* shard, int clientfd, const SockAddr& client_addr);
+    void remove_connection_(Shard* shard, const tcp_conn_ptr& conn);
+    void check_drain_();
+    static void force_close_shard_(Shard* shard);
+    using shard_task = void (*)(Shard*, const std::shared_ptr<std::promise<void>>&);
+    void wait_in_shard_(Shard* shard, shard_task task);
+    static void close_shard_(Shard* shard, const std::shared_ptr<std::promise<void>>& closed);
+    static void destroy_wheel_(Shard* shard, const std::shared_ptr<std::promise<void>>& destroyed);
 
 private:
     EventLoop* loop_;
     std::unique_ptr<Acceptor> acceptor_;
-    connection_map connections_;        /* 用来保存新到的连接 */
     std::shared_ptr<EventLoopThreadPool> thread_pool_;
+    timer_clock::duration idle_timeout_;
+    timer_clock::duration wheel_tick_;
+    std::vector<std::unique_ptr<Shard>> shards_;    /* 每个IO线程一个，start()时创建 */
+    size_t next_shard_;                             /* 轮询分配新连接，只在base loop访问 */
+    std::atomic<size_t> num_connections_;
+
+    size_t max_connections_;
+    std::unique_ptr<IpRateLimiter> rate_limiter_;
+    timer_clock::duration max_loop_lag_;
+    TimerId probe_timer_;
+    std::string reject_message_;
+    std::atomic<uint64_t> num_rejected_;
+
+    /* 已经发送拒绝消息、等待对方关闭的连接，只在base loop访问 */
+    struct Rejected
+    {
+        std::unique_ptr<Channel> channel;
+        TimerId timer;
+    };
+    std::unordered_map<uint64_t, Rejected> rejected_;
+    uint64_t next_rejected_id_;
+
+    std::atomic<bool> draining_;
+    timer_clock::time_point drain_deadline_;
+    bool drain_forced_;                 /* 已经强制关闭过剩下的连接 */
+    TimerId drain_timer_;
+    std::function<void()> drain_done_;
 
     message_callback message_callback_;
     connection_callback connection_callback_;
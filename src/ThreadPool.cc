@@ -0,0 +1,146 @@
+#include "src/ThreadPool.h"
+
+#include <cassert>
+
+thread_local ThreadPool* t_pool_of_this_thread = nullptr;
+thread_local size_t t_worker_index = 0;
+
+ThreadPool::ThreadPool(std::string name)
+    : name_(std::move(name))
+    , num_threads_(0)
+    , running_(false)
+    , next_(0)
+    , pending_(0)
+    , idle_(0)
+{}
+
+ThreadPool::~ThreadPool()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void ThreadPool::start()
+{
+    assert(!running_);
+    assert(num_threads_ > 0);
+    running_ = true;
+
+    for (int i = 0; i < num_threads_; ++i)
+    {
+        workers_.emplace_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        threads_.emplace_back(&ThreadPool::thread_func_, this, i);
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_all();
+
+    for (std::thread& t : threads_)
+    {
+        t.join();
+    }
+    threads_.clear();
+}
+
+void ThreadPool::run(task t)
+{
+    assert(!workers_.empty());
+    size_t index;
+    if (t_pool_of_this_thread == this)
+    {
+        index = t_worker_index;
+    }
+    else
+    {
+        index = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+
+    /* 先计数再入队：任务可能入队后立即被取走，先入队的话pending_会短暂地减到0以下（回绕） */
+    ++pending_;
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(t));
+    }
+
+    /**
+     * 工作线程先增加idle_再检查pending_，这里先增加pending_再检查idle_，
+     * 两者都是顺序一致的原子操作，所以不会出现任务入队而所有线程都在睡眠的情况
+     */
+    if (idle_ > 0)
+    {
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        cond_.notify_one();
+    }
+}
+
+void ThreadPool::thread_func_(size_t index)
+{
+    t_pool_of_this_thread = this;
+    t_worker_index = index;
+    set_thread_name(name_ + "-" + std::to_string(index));
+
+    while (true)
+    {
+        task t;
+        if (take_(index, t))
+        {
+            t();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++idle_;
+        cond_.wait(lock, [this] { return pending_ > 0 || !running_; });
+        --idle_;
+        if (!running_ && pending_ == 0)
+        {
+            break;
+        }
+    }
+
+    t_pool_of_this_thread = nullptr;
+}
+
+bool ThreadPool::take_(size_t index, task& t)
+{
+    /* 先取自己队列的头部 */
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            t = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+
+    /* 再从其他队列的尾部窃取 */
+    for (size_t i = 1; i < workers_.size(); ++i)
+    {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            t = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/EventLoop.h"
+#include "src/TcpConnection.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ *  计算线程池，与EventLoopThreadPool配合使用，把CPU密集的工作（压缩、解析、加解密）从IO线程卸载出去
+ *
+ *  每个工作线程有自己的任务队列，优先执行自己队列头部的任务，
+ *  自己的队列为空时从其他线程队列的尾部窃取任务，工作线程之间几乎不竞争同一把锁
+ *
+ *  submit()在工作线程中执行work，再通过queue_in_loop把结果交回提交它的EventLoop
+ */
+class ThreadPool
+{
+public:
+    using task = std::function<void()>;
+
+    explicit ThreadPool(std::string name = "compute");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void set_thread_num(int num_threads) { num_threads_ = num_threads; }
+    void start();
+    void stop();    /* 执行完队列中剩余的任务后退出所有工作线程 */
+
+    /* 可以在任意线程调用，在工作线程中调用时任务放入本线程的队列 */
+    void run(task t);
+
+    /**
+     * 在工作线程中执行work()，然后在loop线程中调用done(result)
+     * work没有返回值时调用done()
+     */
+    template <typename Work, typename Done>
+    void submit(EventLoop* loop, Work work, Done done)
+    {
+        run([loop, work = std::move(work), done = std::move(done)]() mutable {
+            if constexpr (std::is_void_v<std::invoke_result_t<Work&>>)
+            {
+                work();
+                loop->queue_in_loop(std::move(done));
+            }
+            else
+            {
+                loop->queue_in_loop(std::bind(std::move(done), work()));
+            }
+        });
+    }
+
+    /**
+     * 在工作线程中执行work()，然后在conn所属的IO线程中调用done(conn, result)
+     * 同一连接上的work可以并行执行，但done严格按照submit的顺序调用
+     * 必须在conn所属的IO线程中调用，通常是在message_callback中
+     */
+    template <typename Work, typename Done>
+    void submit(const tcp_conn_ptr& conn, Work work, Done done)
+    {
+        uint64_t seq = conn->next_offload_seq();
+        run([conn, seq, work = std::move(work), done = std::move(done)]() mutable {
+            task complete;
+            if constexpr (std::is_void_v<std::invoke_result_t<Work&>>)
+            {
+                work();
+                complete = std::bind(std::move(done), conn);
+            }
+            else
+            {
+                complete = std::bind(std::move(done), conn, work());
+            }
+            conn->get_loop()->queue_in_loop(
+                std::bind(&TcpConnection::complete_offload, conn, seq, std::move(complete)));
+        });
+    }
+
+    size_t queue_size() const { return pending_.load(std::memory_order_relaxed); }
+    bool started() const { return running_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    void thread_func_(size_t index);
+    bool take_(size_t index, task& t);
+
+private:
+    std::string name_;
+    int num_threads_;
+    std::atomic<bool> running_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_;      /* 非工作线程提交任务时轮询选择队列 */
+    std::atomic<size_t> pending_;   /* 所有队列中的任务总数 */
+    std::atomic<int> idle_;         /* 正在等待任务的工作线程数 */
+    std::mutex mutex_;              /* 只用于空闲线程的睡眠与唤醒 */
+    std::condition_variable cond_;
+};
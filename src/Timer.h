@@ -3,6 +3,7 @@
 #include "src/common.h"
 
 #include <atomic>
+#include <typeinfo>
 
 class Timer
 {
@@ -13,6 +14,7 @@ public:
     Timer operator=(const Timer&) = delete;
 
     void run() const;
+    const std::type_info& callback_type() const { return callback_.target_type(); }
 
     timer_clock::time_point expiration() const { return expiration_; }
     bool repeat() const { return repeat_; }
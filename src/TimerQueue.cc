@@ -20,6 +20,11 @@ struct timespec time_point_to_timespec(timer_clock::time_point when)
 {
     using namespace std::chrono;
     timer_clock::duration dura = when - timer_clock::now();
+    /* 已经过期的定时器也要让timerfd尽快触发，0或负值会使timerfd_settime失败或停止计时 */
+    if (dura < microseconds(100))
+    {
+        dura = microseconds(100);
+    }
     auto secs = duration_cast<seconds>(dura);
     auto ns = duration_cast<nanoseconds>(dura) - duration_cast<nanoseconds>(secs);
     return timespec{secs.count(), ns.count()};
@@ -53,6 +58,7 @@ TimerQueue::TimerQueue(EventLoop* loop)
     : loop_(loop)
     , timerfd_(create_timerfd())
     , timerfd_channel_(loop_, timerfd_)
+    , fired_count_(0)
 {
     timerfd_channel_.set_read_callback(std::bind(&TimerQueue::handle_read_, this));
     timerfd_channel_.enable_reading();
@@ -73,7 +79,7 @@ timer_ptr TimerQueue::add_timer(timer_callback cb, timer_clock::time_point when,
 
 void TimerQueue::cancel(timer_ptr timer)
 {
-    loop_->run_in_loop(std::bind(&TimerQueue::cancel_in_loop_, this, std::move(timer)));
+    loop_->run_in_loop(std::bind(&TimerQueue::cancel_in_loop_, this, std::move(timer)), EventLoop::kUrgent);
 }
 
 void TimerQueue::add_timer_in_loop_(timer_ptr timer)
@@ -107,9 +113,11 @@ void TimerQueue::handle_read_()
     timer_clock::time_point now = timer_clock::now();
     read_timerfd(timerfd_);
     std::vector<timer_ptr> expired = get_expired_(now);
+    fired_count_ += expired.size();
 
     for (const timer_ptr& it : expired)
     {
+        loop_->heartbeat().set_timer(it->callback_type());
         it->run();
     }
     reset_(expired, now);
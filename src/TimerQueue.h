@@ -23,6 +23,9 @@ public:
     timer_ptr add_timer(timer_callback cb, timer_clock::time_point when, timer_clock::duration interval);
     void cancel(timer_ptr timer);
 
+    uint64_t fired_count() const { return fired_count_; }   /* 只能在IO线程调用 */
+    int fd() const { return timerfd_; }
+
 private:
     void handle_read_();
     std::vector<timer_ptr> get_expired_(timer_clock::time_point now);
@@ -45,4 +48,5 @@ private:
     const int timerfd_;                 /* timerfd_create 创建的定时器fd */
     Channel timerfd_channel_;           /* 定时器fd对应的Channel */
     std::priority_queue<timer_ptr, std::vector<timer_ptr>, timer_cmp> timers_;
+    uint64_t fired_count_;              /* 已到期执行的定时器数 */
 };
\ No newline at end of file
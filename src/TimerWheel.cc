@@ -0,0 +1,121 @@
+#include "src/TimerWheel.h"
+#include "src/EventLoop.h"
+
+#include <cassert>
+
+TimerWheel::TimerWheel(EventLoop* loop, timer_clock::duration tick, size_t num_buckets)
+    : loop_(loop)
+    , tick_(tick)
+    , now_tick_(0)
+    , size_(0)
+    , buckets_(num_buckets, nullptr)
+{
+    assert(tick > timer_clock::duration::zero());
+    timer_ = loop_->run_every(tick_, std::bind(&TimerWheel::on_tick_, this));
+}
+
+TimerWheel::~TimerWheel()
+{
+    loop_->assert_in_loop_thread();
+    loop_->cancel(timer_);
+}
+
+void TimerWheel::schedule(Node* node, timer_clock::duration timeout)
+{
+    loop_->assert_in_loop_thread();
+    /* 多加一个tick，保证至少经过了完整的timeout */
+    uint64_t deadline = now_tick_ + static_cast<uint64_t>((timeout + tick_ - timer_clock::duration(1)) / tick_) + 1;
+    if (node->linked)
+    {
+        /* 推迟时原来的bucket会先到，到时再重新挂入；提前时必须立即移动 */
+        if (deadline >= node->deadline)
+        {
+            node->deadline = deadline;
+            return;
+        }
+        unlink_(node);
+        --size_;
+    }
+    node->deadline = deadline;
+    link_(node, deadline % buckets_.size());
+    ++size_;
+}
+
+void TimerWheel::cancel(Node* node)
+{
+    loop_->assert_in_loop_thread();
+    if (node->linked)
+    {
+        unlink_(node);
+        --size_;
+    }
+}
+
+void TimerWheel::on_tick_()
+{
+    ++now_tick_;
+    size_t idx = now_tick_ % buckets_.size();
+    Node* head = buckets_[idx];
+    buckets_[idx] = nullptr;
+
+    while (head)
+    {
+        Node* node = head;
+        head = node->next;
+        node->prev = node->next = nullptr;
+        node->linked = false;
+
+        if (node->deadline > now_tick_)
+        {
+            link_(node, node->deadline % buckets_.size());
+        }
+        else
+        {
+            --size_;
+            expired_.push_back(node);
+        }
+    }
+
+    /* 回调中可能重新schedule自己，到期节点都已经离开时间轮 */
+    for (size_t i = 0; i < expired_.size(); ++i)
+    {
+        Node* node = expired_[i];
+        if (!node->linked)
+        {
+            node->callback();
+        }
+    }
+    expired_.clear();
+}
+
+void TimerWheel::link_(Node* node, size_t bucket)
+{
+    node->bucket = bucket;
+    node->prev = nullptr;
+    node->next = buckets_[bucket];
+    if (node->next)
+    {
+        node->next->prev = node;
+    }
+    buckets_[bucket] = node;
+    node->linked = true;
+}
+
+void TimerWheel::unlink_(Node* node)
+{
+    if (node->prev)
+    {
+        node->prev->next = node->next;
+    }
+    else
+    {
+        buckets_[node->bucket] = node->next;
+    }
+
+    if (node->next)
+    {
+        node->next->prev = node->prev;
+    }
+    node->prev = node->next = nullptr;
+    node->linked = false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <vector>
+
+class EventLoop;
+
+/**
+ *  每个IO线程一个的通用超时时间轮，每个节点有自己的到期时间和到期回调
+ *  由TcpServer为每个IO线程创建，连接的空闲超时和上层协议（例如HttpServer）的超时共用，见TcpConnection::timer_wheel()
+ *
+ *  节点(TimerWheel::Node)直接嵌在使用者的对象中，设置、推迟、取消都是O(1)且不分配内存，
+ *  适合每条消息、每个请求都要重设超时的场景；采用延迟重排：
+ *  推迟到期时间时只修改deadline，不移动节点，bucket到期时再挂到真正到期的bucket，
+ *  所以即使有大量活跃连接，每次推迟也只需一次写内存；
+ *  超过一圈的到期时间同样在经过的bucket中重新挂入，所以bucket数量不限制最长超时
+ */
+class TimerWheel
+{
+public:
+    struct Node
+    {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        uint64_t deadline = 0;          /* 到期的tick */
+        size_t bucket = 0;              /* 所在的bucket */
+        bool linked = false;
+        std::function<void()> callback; /* 到期时在IO线程中调用，调用时节点已经离开时间轮 */
+    };
+
+    TimerWheel(EventLoop* loop, timer_clock::duration tick, size_t num_buckets = 64);
+    /* 必须在loop所在线程中析构，否则tick定时器的取消只是排队，之后仍可能访问已经释放的时间轮 */
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /* 从现在起timeout之后到期（向上取整到tick），已经在时间轮中时修改到期时间 */
+    void schedule(Node* node, timer_clock::duration timeout);
+    void cancel(Node* node);
+
+    size_t size() const { return size_; }
+
+private:
+    void on_tick_();
+    void link_(Node* node, size_t bucket);
+    void unlink_(Node* node);
+
+private:
+    EventLoop* loop_;
+    TimerId timer_;
+    timer_clock::duration tick_;
+    uint64_t now_tick_;
+    size_t size_;
+    std::vector<Node*> buckets_;
+    std::vector<Node*> expired_;    /* 复用的到期节点数组，避免每个tick分配 */
+};
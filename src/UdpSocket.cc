@@ -0,0 +1,329 @@
+#include "src/UdpSocket.h"
+#include "src/Channel.h"
+#include "src/EventLoop.h"
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+/* 每个接收槽位的控制消息缓冲区，只用来接收UDP_GRO的gso_size */
+const size_t kControlSize = 64;
+/* 一次UDP_SEGMENT发送最多的分段数和字节数（内核限制） */
+const size_t kMaxGsoSegments = 64;
+const size_t kMaxGsoBytes = 65000;
+
+UdpSocket::UdpSocket(EventLoop* loop, const SockAddr& bind_addr, size_t batch_size, size_t max_datagram_size)
+    : loop_(loop)
+    , sockfd_(::socket(bind_addr.family(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+    , gro_(false)
+    , gso_supported_(true)
+    , batch_size_(batch_size)
+    , slot_size_(max_datagram_size)
+    , recv_peers_(batch_size)
+    , recv_msgs_(batch_size)
+    , recv_iovecs_(batch_size)
+    , recv_control_(batch_size * kControlSize)
+    , max_queued_bytes_(kDefaultMaxQueuedBytes)
+    , flush_scheduled_(false)
+    , datagrams_received_(0)
+    , datagrams_sent_(0)
+    , datagrams_dropped_(0)
+{
+    if (sockfd_ < 0)
+        handle_err("socket()");
+    if (::bind(sockfd_, bind_addr.get(), bind_addr.length()) < 0)
+        handle_err("bind()");
+
+    socklen_t len = SockAddr::capacity();
+    ::getsockname(sockfd_, local_addr_.get_mutable(), &len);
+    local_addr_.set_length(len);
+
+    recv_buffer_.resize(batch_size_ * slot_size_);
+    batch_.reserve(batch_size_);
+    channel_ = std::make_unique<Channel>(loop_, sockfd_);
+    channel_->set_read_callback(std::bind(&UdpSocket::handle_read_, this));
+    channel_->set_write_callback(std::bind(&UdpSocket::handle_write_, this));
+    alive_ = std::make_shared<UdpSocket*>(this);
+}
+
+UdpSocket::~UdpSocket()
+{
+    channel_->disable_all();
+    ::close(sockfd_);
+}
+
+bool UdpSocket::enable_gro()
+{
+    int on = 1;
+    if (::setsockopt(sockfd_, SOL_UDP, UDP_GRO, &on, static_cast<socklen_t>(sizeof(on))) < 0)
+    {
+        return false;
+    }
+    gro_ = true;
+    slot_size_ = std::max(slot_size_, kGroBufferSize);
+    recv_buffer_.resize(batch_size_ * slot_size_);
+    return true;
+}
+
+void UdpSocket::start()
+{
+    loop_->assert_in_loop_thread();
+    channel_->enable_reading();
+}
+
+void UdpSocket::handle_read_()
+{
+    for (int round = 0; round < kMaxReadRoundsPerEvent; ++round)
+    {
+        size_t received = receive_batch_();
+        if (!batch_.empty() && batch_callback_)
+        {
+            batch_callback_(batch_);
+        }
+        if (received < batch_size_)
+        {
+            break;
+        }
+    }
+}
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+/* 收一批数据报到batch_中，返回recvmmsg收到的消息数（GRO合并的包算一个） */
+size_t UdpSocket::receive_batch_()
+{
+    batch_.clear();
+    for (size_t i = 0; i < batch_size_; ++i)
+    {
+        recv_iovecs_[i].iov_base = recv_buffer_.data() + i * slot_size_;
+        recv_iovecs_[i].iov_len = slot_size_;
+        struct msghdr& hdr = recv_msgs_[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = recv_peers_[i].get_mutable();
+        hdr.msg_namelen = SockAddr::capacity();
+        hdr.msg_iov = &recv_iovecs_[i];
+        hdr.msg_iovlen = 1;
+        if (gro_)
+        {
+            hdr.msg_control = recv_control_.data() + i * kControlSize;
+            hdr.msg_controllen = kControlSize;
+        }
+    }
+
+    int n = ::recvmmsg(sockfd_, recv_msgs_.data(), static_cast<unsigned int>(batch_size_), MSG_DONTWAIT, nullptr);
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+        {
+            printf("recvmmsg(): %s\n", strerror(errno));
+        }
+        return 0;
+    }
+
+    for (size_t i = 0; i < static_cast<size_t>(n); ++i)
+    {
+        struct msghdr& hdr = recv_msgs_[i].msg_hdr;
+        recv_peers_[i].set_length(hdr.msg_namelen);
+        if (hdr.msg_flags & MSG_TRUNC)
+        {
+            ++datagrams_dropped_;
+            continue;
+        }
+
+        const char* data = static_cast<const char*>(recv_iovecs_[i].iov_base);
+        size_t len = recv_msgs_[i].msg_len;
+        size_t segment = len;
+        if (gro_)
+        {
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                {
+                    int gso_size = 0;
+                    memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                    segment = gso_size > 0 ? static_cast<size_t>(gso_size) : len;
+                }
+            }
+        }
+
+        /* GRO合并的包除最后一段外长度都是gso_size */
+        for (size_t offset = 0; offset < len; offset += segment)
+        {
+            batch_.push_back(Datagram{data + offset, std::min(segment, len - offset), &recv_peers_[i]});
+        }
+    }
+    datagrams_received_ += batch_.size();
+    return static_cast<size_t>(n);
+}
+
+bool UdpSocket::send_gso(const SockAddr& peer, const void* data, size_t len, uint16_t segment_size)
+{
+    loop_->assert_in_loop_thread();
+    const char* p = static_cast<const char*>(data);
+    size_t seg = segment_size;
+    if (seg == 0 || len <= seg)
+    {
+        return send_to(peer, data, len);
+    }
+
+    /* 前面排队的数据报先发出去，保证顺序 */
+    flush();
+    const size_t chunk_limit = std::min(seg * kMaxGsoSegments, kMaxGsoBytes / seg * seg);
+    size_t offset = 0;
+    while (offset < len && send_queue_.empty() && gso_supported_)
+    {
+        size_t chunk = std::min(chunk_limit, len - offset);
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(p + offset);
+        iov.iov_len = chunk;
+
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+        memset(control, 0, sizeof(control));
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = const_cast<struct sockaddr*>(peer.get());
+        hdr.msg_namelen = peer.length();
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+
+        if (::sendmsg(sockfd_, &hdr, MSG_DONTWAIT) < 0)
+        {
+            if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)
+            {
+                /* 内核或网卡不支持，之后都退化为普通发送 */
+                gso_supported_ = false;
+            }
+            break;
+        }
+        datagrams_sent_ += (chunk + seg - 1) / seg;
+        offset += chunk;
+    }
+
+    /* 剩下的（内核缓冲区满或者不支持GSO）按普通数据报排队 */
+    bool queued = true;
+    for (; offset < len; offset += seg)
+    {
+        queued = send_to(peer, p + offset, std::min(seg, len - offset)) && queued;
+    }
+    return queued;
+}
+#pragma GCC diagnostic error "-Wold-style-cast"
+
+bool UdpSocket::send_to(const SockAddr& peer, const void* data, size_t len)
+{
+    loop_->assert_in_loop_thread();
+    /* 内核缓冲区一直满（对端或网络跟不上）时不能无限排队，UDP本来就允许丢包 */
+    if (max_queued_bytes_ > 0 && send_buffer_.size() >= max_queued_bytes_)
+    {
+        ++datagrams_dropped_;
+        return false;
+    }
+    size_t offset = send_buffer_.size();
+    send_buffer_.insert(send_buffer_.end(), static_cast<const char*>(data), static_cast<const char*>(data) + len);
+    send_queue_.push_back(PendingDatagram{offset, len, peer});
+    schedule_flush_();
+    return true;
+}
+
+/* 同一轮循环中的send_to合并成一次flush */
+void UdpSocket::schedule_flush_()
+{
+    if (flush_scheduled_ || channel_->is_writing())
+    {
+        return;
+    }
+    flush_scheduled_ = true;
+    std::weak_ptr<UdpSocket*> weak = alive_;
+    loop_->queue_in_loop([weak] {
+        if (auto self = weak.lock())
+        {
+            (*self)->flush_scheduled_ = false;
+            (*self)->flush();
+        }
+    });
+}
+
+void UdpSocket::flush()
+{
+    loop_->assert_in_loop_thread();
+    size_t sent = 0;
+    while (sent < send_queue_.size())
+    {
+        size_t count = std::min(batch_size_, send_queue_.size() - sent);
+        send_msgs_.resize(count);
+        send_iovecs_.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            PendingDatagram& pending = send_queue_[sent + i];
+            send_iovecs_[i].iov_base = send_buffer_.data() + pending.offset;
+            send_iovecs_[i].iov_len = pending.len;
+            struct msghdr& hdr = send_msgs_[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = pending.peer.get_mutable();
+            hdr.msg_namelen = pending.peer.length();
+            hdr.msg_iov = &send_iovecs_[i];
+            hdr.msg_iovlen = 1;
+        }
+
+        int n = ::sendmmsg(sockfd_, send_msgs_.data(), static_cast<unsigned int>(count), MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                break;
+            }
+            /* 第一个数据报发不出去（例如EMSGSIZE、ECONNREFUSED），丢弃它继续 */
+            ++datagrams_dropped_;
+            ++sent;
+            continue;
+        }
+        sent += static_cast<size_t>(n);
+        datagrams_sent_ += static_cast<uint64_t>(n);
+    }
+
+    compact_send_queue_(sent);
+    if (!send_queue_.empty() && !channel_->is_writing())
+    {
+        channel_->enable_writing();
+    }
+    else if (send_queue_.empty() && channel_->is_writing())
+    {
+        channel_->disable_writing();
+    }
+}
+
+void UdpSocket::handle_write_()
+{
+    flush();
+}
+
+void UdpSocket::compact_send_queue_(size_t sent)
+{
+    if (sent == send_queue_.size())
+    {
+        send_queue_.clear();
+        send_buffer_.clear();
+        return;
+    }
+    if (sent == 0)
+    {
+        return;
+    }
+
+    size_t base = send_queue_[sent].offset;
+    send_buffer_.erase(send_buffer_.begin(), send_buffer_.begin() + static_cast<std::ptrdiff_t>(base));
+    send_queue_.erase(send_queue_.begin(), send_queue_.begin() + static_cast<std::ptrdiff_t>(sent));
+    for (PendingDatagram& pending : send_queue_)
+    {
+        pending.offset -= base;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/SockAddr.h"
+
+#include <sys/socket.h>
+#include <memory>
+#include <vector>
+
+/* 收到的一个数据报，指向UdpSocket的接收缓冲区，只在回调期间有效 */
+struct Datagram
+{
+    const char* data;
+    size_t len;
+    const SockAddr* peer;
+};
+
+/**
+ *  挂在EventLoop上的UDP socket，收发都按批进行，只能在所属EventLoop中使用
+ *
+ *  接收：可读时用recvmmsg一次收取最多batch_size个数据报到预先分配的缓冲区，整批交给batch_callback；
+ *       打开GRO后内核会把同一对端的连续数据报合并成一个大包，这里再按gso_size拆开
+ *  发送：send_to()只把数据报追加到发送队列，本轮循环结束前（pending functor中）用sendmmsg一次发出；
+ *       内核缓冲区满时关注可写事件稍后再发，排队的数据超过max_queued_bytes时丢弃新的数据报；
+ *       send_gso()用UDP_SEGMENT让内核（或网卡）分段
+ */
+class UdpSocket
+{
+public:
+    using batch_callback = std::function<void(const std::vector<Datagram>& batch)>;
+
+    static const size_t kDefaultMaxQueuedBytes = 4 * 1024 * 1024;
+
+    UdpSocket(EventLoop* loop, const SockAddr& bind_addr, size_t batch_size = 64, size_t max_datagram_size = 2048);
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    void set_batch_callback(batch_callback cb) { batch_callback_ = std::move(cb); }
+    /* 必须在start()之前调用，内核不支持时返回false */
+    bool enable_gro();
+    void start();
+    /* 发送队列中等待内核缓冲区的字节数上限，0表示不限制 */
+    void set_max_queued_bytes(size_t bytes) { max_queued_bytes_ = bytes; }
+
+    /* 发送队列已经超过上限时丢弃这个数据报（计入datagrams_dropped）并返回false */
+    bool send_to(const SockAddr& peer, const void* data, size_t len);
+    /* data按segment_size分成多个数据报发给peer，内核不支持UDP_SEGMENT时退化为send_to；有数据报被丢弃时返回false */
+    bool send_gso(const SockAddr& peer, const void* data, size_t len, uint16_t segment_size);
+    /* 立即发出发送队列中的数据报 */
+    void flush();
+
+    int fd() const { return sockfd_; }
+    const SockAddr& local_addr() const { return local_addr_; }
+    uint64_t datagrams_received() const { return datagrams_received_; }
+    uint64_t datagrams_sent() const { return datagrams_sent_; }
+    uint64_t datagrams_dropped() const { return datagrams_dropped_; }  /* 发送失败或者发送队列满丢弃的 */
+
+private:
+    struct PendingDatagram
+    {
+        size_t offset;      /* 在send_buffer_中的偏移 */
+        size_t len;
+        SockAddr peer;
+    };
+
+    void handle_read_();
+    void handle_write_();
+    size_t receive_batch_();
+    void schedule_flush_();
+    void compact_send_queue_(size_t sent);
+
+private:
+    static constexpr int kMaxReadRoundsPerEvent = 4;    /* 每次可读事件最多recvmmsg的次数，避免饿死其他fd */
+    static constexpr size_t kGroBufferSize = 65536;     /* GRO合并后的包最大64KB */
+
+    EventLoop* loop_;
+    int sockfd_;
+    SockAddr local_addr_;
+    std::unique_ptr<Channel> channel_;
+    batch_callback batch_callback_;
+    bool gro_;
+    bool gso_supported_;
+
+    /* 接收缓冲区，构造时一次分配，之后每批复用 */
+    const size_t batch_size_;
+    size_t slot_size_;
+    std::vector<char> recv_buffer_;
+    std::vector<SockAddr> recv_peers_;
+    std::vector<struct mmsghdr> recv_msgs_;
+    std::vector<struct iovec> recv_iovecs_;
+    std::vector<char> recv_control_;
+    std::vector<Datagram> batch_;
+
+    /* 发送队列，数据连续存放在send_buffer_中 */
+    std::vector<char> send_buffer_;
+    std::vector<PendingDatagram> send_queue_;
+    std::vector<struct mmsghdr> send_msgs_;
+    std::vector<struct iovec> send_iovecs_;
+    size_t max_queued_bytes_;
+    bool flush_scheduled_;
+
+    std::shared_ptr<UdpSocket*> alive_;    /* 排队的flush通过它的weak_ptr判断socket是否已经析构 */
+
+    uint64_t datagrams_received_;
+    uint64_t datagrams_sent_;
+    uint64_t datagrams_dropped_;
+};
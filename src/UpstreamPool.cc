@@ -0,0 +1,198 @@
+#include "src/UpstreamPool.h"
+#include "src/EventLoop.h"
+#include "src/TcpClient.h"
+#include "src/TcpConnection.h"
+
+#include <algorithm>
+
+using namespace std::placeholders;
+
+void ignore_connection(const tcp_conn_ptr&)
+{
+}
+
+/* 空闲连接不应该收到数据，收到说明协议状态已经不对了 */
+void discard_idle_message(const tcp_conn_ptr& conn, Buffer& buffer)
+{
+    buffer.retrieve_all();
+    conn->shutdown();
+}
+
+UpstreamPool::UpstreamPool(EventLoop* loop, const SockAddr& upstream_addr, size_t max_connections, size_t max_idle)
+    : loop_(loop)
+    , upstream_addr_(upstream_addr)
+    , max_connections_(max_connections)
+    , max_idle_(max_idle)
+{}
+
+UpstreamPool::~UpstreamPool()
+{
+    for (const connector_ptr& connector : connectors_)
+    {
+        connector->stop();
+    }
+    for (const tcp_conn_ptr& conn : conns_)
+    {
+        EventLoop* loop = loop_;
+        conn->set_close_callback([loop](const tcp_conn_ptr& c) { loop->queue_in_loop([c] {}); });
+        conn->force_close();
+    }
+}
+
+void UpstreamPool::acquire(acquire_callback cb)
+{
+    loop_->assert_in_loop_thread();
+    while (!idle_.empty())
+    {
+        tcp_conn_ptr conn = std::move(idle_.back());
+        idle_.pop_back();
+        if (conn->connected())
+        {
+            cb(conn);
+            return;
+        }
+    }
+
+    waiters_.push_back(std::move(cb));
+    if (conns_.size() + connectors_.size() < max_connections_)
+    {
+        connect_();
+    }
+}
+
+void UpstreamPool::release(const tcp_conn_ptr& conn)
+{
+    loop_->assert_in_loop_thread();
+    assert(conn->get_loop() == loop_);
+    if (!conn->connected() || conns_.count(conn) == 0)
+    {
+        return;
+    }
+
+    reset_callbacks_(conn);
+    if (conn->input_buffer()->readable_bytes() > 0)
+    {
+        /* 上一个借用者没有读完响应，不能再给别人用 */
+        conn->shutdown();
+    }
+    else if (!waiters_.empty())
+    {
+        hand_out_(conn);
+    }
+    else if (idle_.size() < max_idle_)
+    {
+        idle_.push_back(conn);
+    }
+    else
+    {
+        conn->shutdown();
+    }
+}
+
+void UpstreamPool::connect_()
+{
+    auto connector = std::make_shared<Connector>(loop_, upstream_addr_);
+    /* 回调中持有connector会形成循环引用，用裸指针在connectors_中查找 */
+    Connector* raw = connector.get();
+    auto find = [this, raw]() {
+        return *std::find_if(connectors_.begin(), connectors_.end(),
+            [raw](const connector_ptr& c) { return c.get() == raw; });
+    };
+    connector->set_retry(false);
+    connector->set_new_connection_callback([this, find](int sockfd) { new_connection_(find(), sockfd); });
+    connector->set_connect_failed_callback([this, find]() { connect_failed_(find()); });
+    connectors_.insert(connector);
+    connector->start();
+}
+
+void UpstreamPool::new_connection_(const connector_ptr& connector, int sockfd)
+{
+    /* 延迟释放，当前还在connector的回调中 */
+    loop_->queue_in_loop([connector] {});
+    connectors_.erase(connector);
+
+    auto conn = std::make_shared<TcpConnection>(loop_, sockfd, peer_addr_of(sockfd));
+    reset_callbacks_(conn);
+    conn->set_close_callback(std::bind(&UpstreamPool::remove_connection_, this, _1));
+    conns_.insert(conn);
+    conn->connect_established();
+
+    if (!waiters_.empty())
+    {
+        hand_out_(conn);
+    }
+    else if (idle_.size() < max_idle_)
+    {
+        idle_.push_back(conn);
+    }
+    else
+    {
+        conn->shutdown();
+    }
+}
+
+void UpstreamPool::connect_failed_(const connector_ptr& connector)
+{
+    loop_->queue_in_loop([connector] {});
+    connectors_.erase(connector);
+
+    /**
+     *  连接失败说明上游暂时不可用，不再补新的连接：等待者中排在正在进行的连接和借出的连接能满足的数量之后的，
+     *  永远等不到连接，全部失败；先从队列中取出再回调，回调中可能重新acquire
+     */
+    std::deque<acquire_callback> failed;
+    while (waiters_.size() > connectors_.size() + conns_.size() - idle_.size())
+    {
+        failed.push_front(std::move(waiters_.back()));
+        waiters_.pop_back();
+    }
+    for (const acquire_callback& cb : failed)
+    {
+        cb(tcp_conn_ptr());
+    }
+}
+
+void UpstreamPool::remove_connection_(const tcp_conn_ptr& conn)
+{
+    loop_->assert_in_loop_thread();
+    conns_.erase(conn);
+    idle_.erase(std::remove(idle_.begin(), idle_.end(), conn), idle_.end());
+    loop_->queue_in_loop([conn] {});
+
+    /* 还有人在等，补一个连接 */
+    if (!waiters_.empty() && conns_.size() + connectors_.size() < max_connections_)
+    {
+        connect_();
+    }
+}
+
+void UpstreamPool::hand_out_(const tcp_conn_ptr& conn)
+{
+    acquire_callback cb = std::move(waiters_.front());
+    waiters_.pop_front();
+    cb(conn);
+}
+
+void UpstreamPool::reset_callbacks_(const tcp_conn_ptr& conn)
+{
+    conn->set_connection_callback(ignore_connection);
+    conn->set_message_callback(discard_idle_message);
+    conn->set_write_complete_callback(write_complete_callback());
+}
+
+UpstreamPoolGroup::UpstreamPoolGroup(const std::vector<EventLoop*>& loops, const SockAddr& upstream_addr,
+    size_t max_connections_per_loop, size_t max_idle_per_loop)
+{
+    for (EventLoop* loop : loops)
+    {
+        pools_[loop] = std::make_unique<UpstreamPool>(loop, upstream_addr, max_connections_per_loop, max_idle_per_loop);
+    }
+}
+
+UpstreamPoolGroup::~UpstreamPoolGroup() = default;
+
+UpstreamPool* UpstreamPoolGroup::for_loop(EventLoop* loop) const
+{
+    auto it = pools_.find(loop);
+    return it == pools_.end() ? nullptr : it->second.get();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/Connector.h"
+#include "src/SockAddr.h"
+
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/**
+ *  单个EventLoop的上游连接池，所有操作都只能在该EventLoop中进行，不需要加锁
+ *
+ *  acquire()优先借出最近归还的空闲连接（LIFO，连接更可能还是热的），没有空闲连接时在连接数上限内新建，
+ *  否则排队等待其他请求release()；借出期间由借用者设置连接的message/connection回调，release()时恢复为池的回调
+ *  空闲连接上收到数据或者被对端关闭时直接丢弃
+ *  析构时会强制关闭所有连接，必须在loop线程中或者loop结束之后析构
+ */
+class UpstreamPool
+{
+public:
+    /* 获取失败（连接上游失败）时conn为空 */
+    using acquire_callback = std::function<void(const tcp_conn_ptr& conn)>;
+
+    UpstreamPool(EventLoop* loop, const SockAddr& upstream_addr, size_t max_connections, size_t max_idle);
+    ~UpstreamPool();
+
+    UpstreamPool(const UpstreamPool&) = delete;
+    UpstreamPool& operator=(const UpstreamPool&) = delete;
+
+    void acquire(acquire_callback cb);
+    /* 连接仍然可用（请求/响应已经完整结束）时调用，否则直接shutdown */
+    void release(const tcp_conn_ptr& conn);
+
+    EventLoop* get_loop() const { return loop_; }
+    size_t idle_count() const { return idle_.size(); }
+    size_t live_count() const { return conns_.size(); }
+
+private:
+    void connect_();
+    void new_connection_(const connector_ptr& connector, int sockfd);
+    void connect_failed_(const connector_ptr& connector);
+    void remove_connection_(const tcp_conn_ptr& conn);
+    void hand_out_(const tcp_conn_ptr& conn);
+    void reset_callbacks_(const tcp_conn_ptr& conn);
+
+private:
+    EventLoop* loop_;
+    SockAddr upstream_addr_;
+    const size_t max_connections_;
+    const size_t max_idle_;
+    std::set<tcp_conn_ptr> conns_;              /* 已建立的连接（空闲+借出） */
+    std::vector<tcp_conn_ptr> idle_;
+    std::deque<acquire_callback> waiters_;
+    std::set<connector_ptr> connectors_;        /* 正在连接的Connector */
+};
+
+/**
+ *  每个EventLoop一个UpstreamPool，构造后只读，可以在任意线程调用for_loop()
+ *  在IO线程K中处理的请求用for_loop(K)借连接，连接和请求在同一个线程，不跨线程也不需要新的握手
+ */
+class UpstreamPoolGroup
+{
+public:
+    UpstreamPoolGroup(const std::vector<EventLoop*>& loops, const SockAddr& upstream_addr,
+        size_t max_connections_per_loop, size_t max_idle_per_loop);
+    ~UpstreamPoolGroup();
+
+    UpstreamPoolGroup(const UpstreamPoolGroup&) = delete;
+    UpstreamPoolGroup& operator=(const UpstreamPoolGroup&) = delete;
+
+    UpstreamPool* for_loop(EventLoop* loop) const;
+
+private:
+    std::unordered_map<EventLoop*, std::unique_ptr<UpstreamPool>> pools_;
+};
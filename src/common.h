@@ -5,7 +5,9 @@
 #include <memory>
 #include <functional>
 #include <chrono>
+#include <string>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/syscall.h>   /* For SYS_xxx definitions */
 
 #define handle_err(msg) do { perror(msg); exit(EXIT_FAILURE);} while(0);
@@ -38,4 +40,10 @@ inline std::size_t thread_id() noexcept
 {
     static thread_local const std::size_t tid = static_cast<std::size_t>(::syscall(SYS_gettid));
     return tid;
-}
\ No newline at end of file
+}
+
+/* 设置当前线程名，便于在top/perf中区分线程，超过15个字符的部分会被截断 */
+inline void set_thread_name(const std::string& name)
+{
+    ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+}
@@ -0,0 +1,239 @@
+#include "src/coro/Coroutine.h"
+#include "src/TcpServer.h"
+
+#include <algorithm>
+#include <new>
+
+/* 帧大小按kClassSize对齐分级，超过kMaxPooled的帧直接使用operator new */
+const size_t kClassSize = 64;
+const size_t kNumClasses = 32;
+const size_t kMaxPooled = kClassSize * kNumClasses;
+
+struct FreeNode
+{
+    FreeNode* next;
+};
+
+struct FrameFreeLists
+{
+    FreeNode* heads[kNumClasses] = {};
+
+    ~FrameFreeLists()
+    {
+        for (FreeNode*& head : heads)
+        {
+            while (head)
+            {
+                FreeNode* node = head;
+                head = head->next;
+                ::operator delete(node);
+            }
+        }
+    }
+};
+
+thread_local FrameFreeLists t_frame_free_lists;
+
+void* CoFramePool::allocate(size_t size)
+{
+    if (size > kMaxPooled)
+    {
+        return ::operator new(size);
+    }
+
+    size_t cls = (size + kClassSize - 1) / kClassSize - 1;
+    FreeNode*& head = t_frame_free_lists.heads[cls];
+    if (head)
+    {
+        FreeNode* node = head;
+        head = node->next;
+        return node;
+    }
+    return ::operator new((cls + 1) * kClassSize);
+}
+
+void CoFramePool::deallocate(void* ptr, size_t size)
+{
+    if (size > kMaxPooled)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    size_t cls = (size + kClassSize - 1) / kClassSize - 1;
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    node->next = t_frame_free_lists.heads[cls];
+    t_frame_free_lists.heads[cls] = node;
+}
+
+CoConnection::CoConnection(const tcp_conn_ptr& conn)
+    : state_(std::make_shared<State>())
+{
+    conn->get_loop()->assert_in_loop_thread();
+    state_->conn = conn;
+    state_->input = conn->input_buffer();
+    state_->closed = !conn->connected();
+
+    /**
+     * 回调中持有State的shared_ptr，State持有连接，形成的环在连接关闭
+     * 并且CoConnection析构后解开（见下面的connection_callback与~CoConnection）
+     */
+    std::shared_ptr<State> st = state_;
+    conn->set_message_callback([st](const tcp_conn_ptr&, Buffer&) {
+        if (st->reader && st->readable())
+        {
+            auto h = st->reader;
+            st->reader = nullptr;
+            h.resume();
+        }
+    });
+
+    conn->set_write_complete_callback([st](const tcp_conn_ptr&) {
+        st->write_done = true;
+        if (st->writer && !st->writing)
+        {
+            auto h = st->writer;
+            st->writer = nullptr;
+            h.resume();
+        }
+    });
+
+    conn->set_connection_callback([st](const tcp_conn_ptr& c) {
+        if (c->connected())
+        {
+            return;
+        }
+
+        st->closed = true;
+        if (st->reader)
+        {
+            auto h = st->reader;
+            st->reader = nullptr;
+            h.resume();
+        }
+        if (st->writer)
+        {
+            auto h = st->writer;
+            st->writer = nullptr;
+            h.resume();
+        }
+        if (st->detached)
+        {
+            st->conn.reset();
+        }
+    });
+}
+
+CoConnection::~CoConnection()
+{
+    if (!state_)
+    {
+        return;     /* 已被移走 */
+    }
+
+    state_->detached = true;
+    if (state_->closed)
+    {
+        state_->conn.reset();
+    }
+    else
+    {
+        state_->conn->shutdown();
+    }
+}
+
+bool CoConnection::State::readable()
+{
+    if (delimiter.empty())
+    {
+        return input->readable_bytes() > 0 || closed;
+    }
+
+    /* 从上次查找结束的位置继续，回退delimiter.size()-1个字节以免漏掉跨越两次数据的分隔符 */
+    size_t start = scanned >= delimiter.size() ? scanned - delimiter.size() + 1 : 0;
+    const char* begin = input->peek();
+    const char* end = input->begin_write();
+    const char* pos = std::search(begin + start, end, delimiter.begin(), delimiter.end());
+    if (pos != end)
+    {
+        found = static_cast<size_t>(pos - begin) + delimiter.size();
+        return true;
+    }
+    scanned = input->readable_bytes();
+    return closed;
+}
+
+std::string_view CoConnection::State::take()
+{
+    if (input->readable_bytes() == 0)
+    {
+        return std::string_view();
+    }
+    /* 连接关闭时还没等到delimiter，不完整的数据不返回，与连接关闭一样返回空 */
+    if (!delimiter.empty() && found == 0)
+    {
+        return std::string_view();
+    }
+
+    /* retrieve只移动下标，数据在下一次从socket读取之前仍然有效 */
+    size_t n = input->readable_bytes();
+    if (!delimiter.empty() && found > 0)
+    {
+        n = found;
+    }
+    std::string_view data(input->peek(), n);
+    input->retrieve(n);
+    scanned = 0;
+    found = 0;
+    return data;
+}
+
+bool CoConnection::ReadAwaiter::await_ready()
+{
+    state->delimiter = delimiter;
+    state->scanned = 0;
+    state->found = 0;
+    return state->readable();
+}
+
+void CoConnection::ReadAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    state->reader = h;
+}
+
+bool CoConnection::WriteAwaiter::await_ready()
+{
+    state->write_done = false;
+    return state->closed || !state->conn->connected();
+}
+
+bool CoConnection::WriteAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    /* 数据一次就写完时，写完成回调在send中同步调用，此时不挂起 */
+    state->writer = h;
+    state->writing = true;
+    state->conn->send(data.data(), data.size());
+    state->writing = false;
+
+    if (state->write_done || state->closed)
+    {
+        state->writer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void co_serve(TcpServer* server, std::function<CoTask(CoConnection)> handler)
+{
+    auto shared_handler = std::make_shared<std::function<CoTask(CoConnection)>>(std::move(handler));
+    server->set_connection_callback([shared_handler](const tcp_conn_ptr& conn) {
+        if (conn->connected())
+        {
+            /* 正在执行连接的connection_callback，不能在这里替换它，放到本轮循环末尾启动协程 */
+            conn->get_loop()->queue_in_loop([shared_handler, conn] {
+                (*shared_handler)(CoConnection(conn));
+            });
+        }
+    });
+    server->set_message_callback([](const tcp_conn_ptr&, Buffer&) {});
+}
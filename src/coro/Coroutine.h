@@ -0,0 +1,155 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/Buffer.h"
+#include "src/EventLoop.h"
+#include "src/TcpConnection.h"
+
+#include <coroutine>
+#include <exception>
+#include <string_view>
+
+class TcpServer;
+
+/**
+ *  C++20协程适配层，需要打开MUDUO_BUILD_COROUTINE并链接mini_muduo_coro
+ *
+ *  协程仍然由Channel/TimerQueue驱动：数据到来时在IO线程中恢复等待读的协程，
+ *  定时器到期时在IO线程中恢复等待sleep的协程，所以协程总是在连接所属的EventLoop中运行，
+ *  不需要任何锁，和回调写法一样是单线程的
+ *
+ *  @code
+ *  CoTask echo(CoConnection conn)
+ *  {
+ *      while (true)
+ *      {
+ *          std::string_view line = co_await conn.read_until("\r\n");
+ *          if (line.empty() || !co_await conn.write(line))
+ *              break;
+ *      }
+ *  }
+ *  co_serve(&server, echo);
+ *  @endcode
+ */
+
+/* 每个线程（即每个EventLoop）一个的协程帧内存池，按64字节分级的空闲链表 */
+class CoFramePool
+{
+public:
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size);
+};
+
+/* 不等待结果的协程，创建后立即开始执行，结束时自动销毁 */
+class CoTask
+{
+public:
+    struct promise_type
+    {
+        CoTask get_return_object() { return CoTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return CoFramePool::allocate(size); }
+        static void operator delete(void* ptr, size_t size) { CoFramePool::deallocate(ptr, size); }
+    };
+};
+
+/**
+ *  协程中使用的连接，只能移动
+ *  析构时（通常是处理协程结束时）如果连接仍然存在，则shutdown
+ */
+class CoConnection
+{
+public:
+    explicit CoConnection(const tcp_conn_ptr& conn);
+    ~CoConnection();
+
+    CoConnection(CoConnection&& rhs) = default;
+    CoConnection& operator=(CoConnection&& rhs) = default;
+
+    CoConnection(const CoConnection&) = delete;
+    CoConnection& operator=(const CoConnection&) = delete;
+
+    /* 连接的回调与协程共享的状态，连接关闭并且协程不再使用后才释放 */
+    struct State
+    {
+        tcp_conn_ptr conn;
+        Buffer* input = nullptr;        /* 连接的输入缓冲区 */
+        std::coroutine_handle<> reader;
+        std::coroutine_handle<> writer;
+        std::string_view delimiter;     /* read_until的分隔符，为空表示read_some */
+        size_t scanned = 0;             /* 已经查找过分隔符的字节数 */
+        size_t found = 0;               /* 找到分隔符时，到分隔符末尾的字节数 */
+        bool closed = false;
+        bool detached = false;          /* CoConnection已经析构 */
+        bool writing = false;           /* 正在send中，写完成回调不能恢复协程 */
+        bool write_done = false;
+
+        bool readable();
+        std::string_view take();
+    };
+
+    struct ReadAwaiter
+    {
+        State* state;
+        std::string_view delimiter;
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        std::string_view await_resume() { return state->take(); }
+    };
+
+    struct WriteAwaiter
+    {
+        State* state;
+        std::string_view data;
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> h);
+        bool await_resume() { return state->write_done; }
+    };
+
+    /**
+     * 等待至少一个字节，返回当前缓冲区中的所有数据；返回空表示连接已关闭
+     * 返回值指向连接的输入缓冲区，只在下一次co_await之前有效
+     */
+    ReadAwaiter read_some() { return ReadAwaiter{state_.get(), std::string_view()}; }
+
+    /* 等待直到出现delimiter，返回包括delimiter在内的数据；返回空表示连接已关闭，关闭前没有出现delimiter的数据不返回 */
+    ReadAwaiter read_until(std::string_view delimiter) { return ReadAwaiter{state_.get(), delimiter}; }
+
+    /* 等待数据全部交给内核，返回false表示连接已关闭 */
+    WriteAwaiter write(std::string_view data) { return WriteAwaiter{state_.get(), data}; }
+
+    const tcp_conn_ptr& connection() const { return state_->conn; }
+    EventLoop* get_loop() const { return state_->conn->get_loop(); }
+    bool connected() const { return !state_->closed; }
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+struct SleepAwaiter
+{
+    EventLoop* loop;
+    timer_clock::duration delay;
+
+    bool await_ready() const { return delay <= timer_clock::duration::zero(); }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        loop->run_after(delay, [h] { h.resume(); });
+    }
+    void await_resume() const {}
+};
+
+/* co_await co_sleep_for(loop, d)：通过loop的TimerQueue在d之后于loop线程中恢复 */
+inline SleepAwaiter co_sleep_for(EventLoop* loop, timer_clock::duration delay)
+{
+    return SleepAwaiter{loop, delay};
+}
+
+/* 每个新连接在其IO线程中启动一个handler协程 */
+void co_serve(TcpServer* server, std::function<CoTask(CoConnection)> handler);
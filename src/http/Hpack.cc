@@ -0,0 +1,610 @@
+#include "src/http/Hpack.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+
+struct HpackStaticEntry
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+/* RFC 7541 附录A */
+const HpackStaticEntry kHpackStaticTable[HpackTable::kStaticTableSize] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+struct HuffmanCode
+{
+    uint32_t code;      /* 右对齐 */
+    int bits;
+};
+
+/* RFC 7541 附录B，下标是字节值，256是EOS */
+const HuffmanCode kHuffmanCodes[257] = {
+    { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+    { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+    { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+    { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+    { 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+    { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+    { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+    { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+    { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+    { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+    { 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+    { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+    { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+    { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+    { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+    { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+    { 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+    { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+    { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+    { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+    { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+    { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+    { 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+    { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+    { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+    { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+    { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+    { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+    { 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+    { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+    { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+    { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+    { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+    { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+    { 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+    { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+    { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+    { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+    { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+    { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+    { 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+    { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+    { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+    { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+    { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+    { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+    { 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+    { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+    { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+    { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+    { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+    { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+    { 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+    { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+    { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+    { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+    { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+    { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+    { 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+    { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+    { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+    { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+    { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+    { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+    { 0x3fffffff, 30 },
+};
+
+/**
+ *  Huffman表是规范Huffman编码（同一长度的码字按符号顺序连续递增），
+ *  解码时记录每个长度的第一个码字和码字个数，逐位比较不需要建树
+ */
+struct HuffmanDecodeTable
+{
+    static const int kMaxBits = 30;
+
+    uint32_t first_code[kMaxBits + 1];
+    uint32_t count[kMaxBits + 1];
+    uint32_t offset[kMaxBits + 1];      /* 这个长度的第一个符号在symbols中的下标 */
+    uint16_t symbols[257];              /* 按(长度, 符号)排序 */
+
+    HuffmanDecodeTable()
+    {
+        uint16_t n = 0;
+        for (int bits = 0; bits <= kMaxBits; ++bits)
+        {
+            offset[bits] = n;
+            count[bits] = 0;
+            first_code[bits] = 0;
+            for (uint16_t sym = 0; sym < 257; ++sym)
+            {
+                if (kHuffmanCodes[sym].bits == bits)
+                {
+                    if (count[bits] == 0)
+                    {
+                        first_code[bits] = kHuffmanCodes[sym].code;
+                    }
+                    ++count[bits];
+                    symbols[n++] = sym;
+                }
+            }
+        }
+    }
+};
+
+const HuffmanDecodeTable kHuffmanDecodeTable;
+
+HpackTable::HpackTable(size_t max_size)
+    : size_(0)
+    , max_size_(max_size)
+{
+}
+
+bool HpackTable::lookup(size_t index, std::string_view* name, std::string_view* value) const
+{
+    if (index == 0)
+    {
+        return false;
+    }
+    if (index <= kStaticTableSize)
+    {
+        *name = kHpackStaticTable[index - 1].name;
+        *value = kHpackStaticTable[index - 1].value;
+        return true;
+    }
+    index -= kStaticTableSize + 1;
+    if (index >= entries_.size())
+    {
+        return false;
+    }
+    *name = entries_[index].name;
+    *value = entries_[index].value;
+    return true;
+}
+
+size_t HpackTable::find(std::string_view name, std::string_view value, bool* exact) const
+{
+    size_t name_index = 0;
+    for (size_t i = 0; i < kStaticTableSize; ++i)
+    {
+        if (kHpackStaticTable[i].name == name)
+        {
+            if (kHpackStaticTable[i].value == value)
+            {
+                *exact = true;
+                return i + 1;
+            }
+            if (name_index == 0)
+            {
+                name_index = i + 1;
+            }
+        }
+    }
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        if (entries_[i].name == name)
+        {
+            if (entries_[i].value == value)
+            {
+                *exact = true;
+                return kStaticTableSize + 1 + i;
+            }
+            if (name_index == 0)
+            {
+                name_index = kStaticTableSize + 1 + i;
+            }
+        }
+    }
+    *exact = false;
+    return name_index;
+}
+
+void HpackTable::add(std::string_view name, std::string_view value)
+{
+    size_t entry_size = 32 + name.size() + value.size();
+    if (entry_size > max_size_)
+    {
+        entries_.clear();
+        size_ = 0;
+        return;
+    }
+    /* name和value可能指向即将被淘汰的条目，先拷贝 */
+    Entry entry{std::string(name), std::string(value)};
+    evict_(max_size_ - entry_size);
+    entries_.push_front(std::move(entry));
+    size_ += entry_size;
+}
+
+void HpackTable::set_max_size(size_t size)
+{
+    max_size_ = size;
+    evict_(size);
+}
+
+void HpackTable::evict_(size_t limit)
+{
+    while (size_ > limit)
+    {
+        size_ -= 32 + entries_.back().name.size() + entries_.back().value.size();
+        entries_.pop_back();
+    }
+}
+
+void hpack_encode_integer(std::string* out, unsigned char first, int prefix_bits, size_t value)
+{
+    size_t max_prefix = (size_t(1) << prefix_bits) - 1;
+    if (value < max_prefix)
+    {
+        out->push_back(static_cast<char>(first | value));
+        return;
+    }
+    out->push_back(static_cast<char>(first | max_prefix));
+    value -= max_prefix;
+    while (value >= 128)
+    {
+        out->push_back(static_cast<char>(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+bool hpack_decode_integer(const unsigned char*& p, const unsigned char* end, int prefix_bits, size_t* value)
+{
+    if (p == end)
+    {
+        return false;
+    }
+    size_t max_prefix = (size_t(1) << prefix_bits) - 1;
+    size_t v = *p++ & max_prefix;
+    if (v == max_prefix)
+    {
+        int shift = 0;
+        unsigned char b;
+        do
+        {
+            if (p == end || shift > 28)
+            {
+                return false;
+            }
+            b = *p++;
+            v += size_t(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        if (v > UINT32_MAX)
+        {
+            return false;
+        }
+    }
+    *value = v;
+    return true;
+}
+
+size_t huffman_encoded_length(std::string_view data)
+{
+    size_t bits = 0;
+    for (char c : data)
+    {
+        bits += static_cast<size_t>(kHuffmanCodes[static_cast<unsigned char>(c)].bits);
+    }
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(std::string_view data, std::string* out)
+{
+    uint64_t acc = 0;
+    int bits = 0;
+    for (char c : data)
+    {
+        const HuffmanCode& code = kHuffmanCodes[static_cast<unsigned char>(c)];
+        acc = (acc << code.bits) | code.code;
+        bits += code.bits;
+        while (bits >= 8)
+        {
+            bits -= 8;
+            out->push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    /* 用EOS的高位（全1）填充到字节边界 */
+    if (bits > 0)
+    {
+        out->push_back(static_cast<char>((acc << (8 - bits)) | (0xffu >> bits)));
+    }
+}
+
+bool huffman_decode(std::string_view data, std::string* out)
+{
+    const HuffmanDecodeTable& table = kHuffmanDecodeTable;
+    uint32_t code = 0;
+    int bits = 0;
+    for (char c : data)
+    {
+        unsigned char byte = static_cast<unsigned char>(c);
+        for (int i = 7; i >= 0; --i)
+        {
+            code = (code << 1) | ((byte >> i) & 1);
+            ++bits;
+            /* code小于first_code时减法回绕成很大的数，一次比较就够了 */
+            uint32_t index = code - table.first_code[bits];
+            if (index < table.count[bits])
+            {
+                uint16_t sym = table.symbols[table.offset[bits] + index];
+                if (sym == 256)
+                {
+                    return false;
+                }
+                out->push_back(static_cast<char>(sym));
+                code = 0;
+                bits = 0;
+            }
+            else if (bits == HuffmanDecodeTable::kMaxBits)
+            {
+                return false;
+            }
+        }
+    }
+    return bits <= 7 && code == (uint32_t(1) << bits) - 1;
+}
+
+/* 长度加上原样或者Huffman编码的字符串，取较短的一种 */
+void hpack_encode_string(std::string* out, std::string_view s)
+{
+    size_t length = huffman_encoded_length(s);
+    if (length < s.size())
+    {
+        hpack_encode_integer(out, 0x80, 7, length);
+        huffman_encode(s, out);
+    }
+    else
+    {
+        hpack_encode_integer(out, 0x00, 7, s.size());
+        out->append(s);
+    }
+}
+
+HpackDecoder::HpackDecoder(size_t max_table_size)
+    : table_(max_table_size)
+    , max_table_size_(max_table_size)
+{
+}
+
+bool HpackDecoder::decode_string_(const unsigned char*& p, const unsigned char* end, std::string* out)
+{
+    if (p == end)
+    {
+        return false;
+    }
+    bool huffman = *p & 0x80;
+    size_t length;
+    if (!hpack_decode_integer(p, end, 7, &length) || length > static_cast<size_t>(end - p))
+    {
+        return false;
+    }
+    std::string_view data(reinterpret_cast<const char*>(p), length);
+    p += length;
+    out->clear();
+    if (huffman)
+    {
+        return huffman_decode(data, out);
+    }
+    out->assign(data);
+    return true;
+}
+
+HpackDecoder::result HpackDecoder::decode(std::string_view block, size_t max_list_size,
+    std::string* arena, std::vector<Field>* fields)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(block.data());
+    const unsigned char* end = p + block.size();
+    size_t list_size = 0;
+    bool any_field = false;
+    bool too_large = false;
+
+    auto emit = [&](std::string_view name, std::string_view value) {
+        any_field = true;
+        list_size += 32 + name.size() + value.size();
+        if (list_size > max_list_size)
+        {
+            too_large = true;
+            return;
+        }
+        size_t name_offset = arena->size();
+        arena->append(name);
+        arena->append(value);
+        fields->push_back(Field{name_offset, name.size(), name_offset + name.size(), value.size()});
+    };
+
+    while (p < end)
+    {
+        unsigned char b = *p;
+        size_t index;
+        std::string_view name;
+        std::string_view value;
+        if (b & 0x80)
+        {
+            /* 6.1 索引 */
+            if (!hpack_decode_integer(p, end, 7, &index) || !table_.lookup(index, &name, &value))
+            {
+                return kError;
+            }
+            emit(name, value);
+            continue;
+        }
+        if ((b & 0xe0) == 0x20)
+        {
+            /* 6.3 动态表大小更新，只能出现在header block开头 */
+            if (any_field || !hpack_decode_integer(p, end, 5, &index) || index > max_table_size_)
+            {
+                return kError;
+            }
+            table_.set_max_size(index);
+            continue;
+        }
+
+        /* 6.2 字面量：0x40加入动态表，0x00不加入，0x10永不加入 */
+        bool incremental = (b & 0xc0) == 0x40;
+        if (!hpack_decode_integer(p, end, incremental ? 6 : 4, &index))
+        {
+            return kError;
+        }
+        if (index == 0)
+        {
+            if (!decode_string_(p, end, &name_))
+            {
+                return kError;
+            }
+        }
+        else
+        {
+            if (!table_.lookup(index, &name, &value))
+            {
+                return kError;
+            }
+            name_.assign(name);
+        }
+        if (!decode_string_(p, end, &value_))
+        {
+            return kError;
+        }
+        emit(name_, value_);
+        if (incremental)
+        {
+            table_.add(name_, value_);
+        }
+    }
+    return too_large ? kListTooLarge : kOk;
+}
+
+HpackEncoder::HpackEncoder()
+    : table_(HpackTable::kDefaultMaxSize)
+    , pending_size_update_(SIZE_MAX)
+    , min_size_update_(SIZE_MAX)
+{
+}
+
+void HpackEncoder::set_max_table_size(size_t size)
+{
+    /* 动态表不超过默认大小，对方允许更大的表时也不用 */
+    if (size > HpackTable::kDefaultMaxSize)
+    {
+        size = HpackTable::kDefaultMaxSize;
+    }
+    if (size == table_.max_size() && pending_size_update_ == SIZE_MAX)
+    {
+        return;
+    }
+    min_size_update_ = std::min(min_size_update_, size);
+    pending_size_update_ = size;
+}
+
+void HpackEncoder::begin_block(std::string* out)
+{
+    if (pending_size_update_ == SIZE_MAX)
+    {
+        return;
+    }
+    /* RFC 7541 4.2：两次header block之间缩小过时要先发送最小值 */
+    if (min_size_update_ < pending_size_update_)
+    {
+        hpack_encode_integer(out, 0x20, 5, min_size_update_);
+        table_.set_max_size(min_size_update_);
+    }
+    hpack_encode_integer(out, 0x20, 5, pending_size_update_);
+    table_.set_max_size(pending_size_update_);
+    pending_size_update_ = SIZE_MAX;
+    min_size_update_ = SIZE_MAX;
+}
+
+void HpackEncoder::encode_status(int code, std::string* out)
+{
+    size_t index = 0;
+    switch (code)
+    {
+    case 200: index = 8; break;
+    case 204: index = 9; break;
+    case 206: index = 10; break;
+    case 304: index = 11; break;
+    case 400: index = 12; break;
+    case 404: index = 13; break;
+    case 500: index = 14; break;
+    default:
+        encode(":status", std::to_string(code), out);
+        return;
+    }
+    hpack_encode_integer(out, 0x80, 7, index);
+}
+
+void HpackEncoder::encode(std::string_view name, std::string_view value, std::string* out, bool index)
+{
+    bool exact;
+    size_t found = table_.find(name, value, &exact);
+    if (exact)
+    {
+        hpack_encode_integer(out, 0x80, 7, found);
+        return;
+    }
+    hpack_encode_integer(out, index ? 0x40 : 0x00, index ? 6 : 4, found);
+    if (found == 0)
+    {
+        hpack_encode_string(out, name);
+    }
+    hpack_encode_string(out, value);
+    if (index)
+    {
+        table_.add(name, value);
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ *  HPACK（RFC 7541）：HTTP/2的请求头压缩
+ *
+ *  索引1~61是静态表，之后是动态表，最新加入的条目索引最小；
+ *  字符串可以用静态Huffman编码，编码器只在编码后更短时使用
+ */
+
+/* 动态表，条目大小按RFC 7541 4.1计算为32+name+value，总大小超过上限时从最旧的条目开始淘汰 */
+class HpackTable
+{
+public:
+    static const size_t kStaticTableSize = 61;
+    static const size_t kDefaultMaxSize = 4096;
+
+    explicit HpackTable(size_t max_size = kDefaultMaxSize);
+
+    /* 按索引查找静态表或者动态表，超出范围时返回false */
+    bool lookup(size_t index, std::string_view* name, std::string_view* value) const;
+    /**
+     *  查找name和value都相同的条目，返回索引并设置*exact为true；
+     *  只有name相同时返回第一个相同name的索引；都没有时返回0
+     */
+    size_t find(std::string_view name, std::string_view value, bool* exact) const;
+
+    /* 比上限还大的条目会清空整个表，不加入 */
+    void add(std::string_view name, std::string_view value);
+    void set_max_size(size_t size);
+
+    size_t max_size() const { return max_size_; }
+    size_t size() const { return size_; }
+    size_t count() const { return entries_.size(); }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string value;
+    };
+
+    void evict_(size_t limit);
+
+    std::deque<Entry> entries_;     /* front是最新的 */
+    size_t size_;
+    size_t max_size_;
+};
+
+class HpackDecoder
+{
+public:
+    /* 解码出来的请求头在arena中的位置，arena增长之后仍然有效 */
+    struct Field
+    {
+        size_t name_offset;
+        size_t name_length;
+        size_t value_offset;
+        size_t value_length;
+    };
+
+    enum result
+    {
+        kOk,
+        kListTooLarge,      /* 解码本身成功，请求头总大小超过上限，超出的部分没有保存 */
+        kError,             /* COMPRESSION_ERROR，连接必须关闭 */
+    };
+
+    /* max_table_size是通过SETTINGS_HEADER_TABLE_SIZE告诉对方的上限 */
+    explicit HpackDecoder(size_t max_table_size = HpackTable::kDefaultMaxSize);
+
+    /**
+     *  解码一个完整的header block，请求头的name和value依次追加到arena，位置追加到fields；
+     *  超过max_list_size（按RFC 7540 6.5.2计算）时仍然完整解码以保持动态表同步
+     */
+    result decode(std::string_view block, size_t max_list_size, std::string* arena, std::vector<Field>* fields);
+
+private:
+    bool decode_string_(const unsigned char*& p, const unsigned char* end, std::string* out);
+
+    HpackTable table_;
+    size_t max_table_size_;
+    std::string name_;      /* 复用的解码缓冲区 */
+    std::string value_;
+};
+
+class HpackEncoder
+{
+public:
+    HpackEncoder();
+
+    /* 对方的SETTINGS_HEADER_TABLE_SIZE，下一个header block开头会带上动态表大小更新 */
+    void set_max_table_size(size_t size);
+
+    /* 每个header block开头调用一次 */
+    void begin_block(std::string* out);
+    /* 200、204、206、304、400、404、500在静态表中，只占一个字节 */
+    void encode_status(int code, std::string* out);
+    /* name必须是小写；index为false时编码为不加入动态表的字面量，适合每次都不同的值 */
+    void encode(std::string_view name, std::string_view value, std::string* out, bool index = true);
+
+private:
+    HpackTable table_;
+    size_t pending_size_update_;    /* 等待发送的动态表大小，没有时是SIZE_MAX */
+    size_t min_size_update_;        /* 两个header block之间出现过的最小值，需要先发送它 */
+};
+
+/* RFC 7541 5.1：prefix_bits位前缀的整数，first是第一个字节中前缀以外的标志位 */
+void hpack_encode_integer(std::string* out, unsigned char first, int prefix_bits, size_t value);
+/* 失败（数据不完整或者超过2^32）时返回false */
+bool hpack_decode_integer(const unsigned char*& p, const unsigned char* end, int prefix_bits, size_t* value);
+
+/* RFC 7541 5.2：Huffman编码后的字节数 */
+size_t huffman_encoded_length(std::string_view data);
+void huffman_encode(std::string_view data, std::string* out);
+/* 填充不是EOS的前缀、超过7位或者出现EOS时返回false */
+bool huffman_decode(std::string_view data, std::string* out);
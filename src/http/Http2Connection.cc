@@ -0,0 +1,1261 @@
+#include "src/http/Http2Connection.h"
+#include "src/http/HttpRequest.h"
+#include "src/http/HttpResponse.h"
+#include "src/TcpConnection.h"
+#include "src/Buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+/* RFC 9113 6 */
+enum http2_frame_type
+{
+    kFrameData = 0x0,
+    kFrameHeaders = 0x1,
+    kFramePriority = 0x2,
+    kFrameRstStream = 0x3,
+    kFrameSettings = 0x4,
+    kFramePushPromise = 0x5,
+    kFramePing = 0x6,
+    kFrameGoAway = 0x7,
+    kFrameWindowUpdate = 0x8,
+    kFrameContinuation = 0x9,
+};
+
+enum http2_frame_flag
+{
+    kFlagEndStream = 0x1,
+    kFlagAck = 0x1,
+    kFlagEndHeaders = 0x4,
+    kFlagPadded = 0x8,
+    kFlagPriority = 0x20,
+};
+
+/* RFC 9113 7 */
+enum http2_error_code
+{
+    kNoError = 0x0,
+    kProtocolError = 0x1,
+    kInternalError = 0x2,
+    kFlowControlError = 0x3,
+    kStreamClosed = 0x5,
+    kFrameSizeError = 0x6,
+    kRefusedStream = 0x7,
+    kCompressionError = 0x9,
+    kEnhanceYourCalm = 0xb,
+};
+
+/* RFC 9113 6.5.2 */
+enum http2_setting
+{
+    kSettingsHeaderTableSize = 0x1,
+    kSettingsEnablePush = 0x2,
+    kSettingsMaxConcurrentStreams = 0x3,
+    kSettingsInitialWindowSize = 0x4,
+    kSettingsMaxFrameSize = 0x5,
+    kSettingsMaxHeaderListSize = 0x6,
+};
+
+const size_t kFrameHeaderSize = 9;
+/* 不修改SETTINGS_MAX_FRAME_SIZE，对方发来的帧不超过默认的16 KiB */
+const size_t kDefaultMaxFrameSize = 16384;
+const int64_t kDefaultWindowSize = 65535;
+/* 发送的帧即使对方允许也不超过这么大 */
+const size_t kMaxSendFrameSize = 64 * 1024;
+const int64_t kMaxWindowSize = 0x7fffffff;
+/* CONTINUATION拼接起来的header block的上限 */
+const size_t kMaxHeaderBlockSize = 64 * 1024;
+/* 输出缓冲区积压超过这么多时不再写DATA帧，也不再读取 */
+const size_t kMaxBufferedOutput = 256 * 1024;
+/* 每个kResetWindow内对方取消的流加上因为对方出错而重置的流超过这么多时以ENHANCE_YOUR_CALM关闭连接（rapid reset） */
+const uint32_t kMaxResetsPerWindow = 2 * Http2Connection::kMaxConcurrentStreams;
+const timer_clock::duration kResetWindow = std::chrono::seconds(10);
+
+uint32_t read_uint32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(u[0]) << 24 | uint32_t(u[1]) << 16 | uint32_t(u[2]) << 8 | u[3];
+}
+
+void write_uint32(char* p, uint32_t n)
+{
+    p[0] = static_cast<char>(n >> 24);
+    p[1] = static_cast<char>(n >> 16);
+    p[2] = static_cast<char>(n >> 8);
+    p[3] = static_cast<char>(n);
+}
+
+void encode_frame_header(char* p, size_t length, uint8_t type, uint8_t flags, uint32_t id)
+{
+    p[0] = static_cast<char>(length >> 16);
+    p[1] = static_cast<char>(length >> 8);
+    p[2] = static_cast<char>(length);
+    p[3] = static_cast<char>(type);
+    p[4] = static_cast<char>(flags);
+    write_uint32(p + 5, id);
+}
+
+void write_frame_header(Buffer& out, size_t length, uint8_t type, uint8_t flags, uint32_t id)
+{
+    char header[kFrameHeaderSize];
+    encode_frame_header(header, length, type, flags, id);
+    out.append(header, sizeof(header));
+}
+
+/* RST_STREAM和WINDOW_UPDATE的负载都是一个32位整数 */
+void write_uint32_frame(Buffer& out, uint8_t type, uint32_t id, uint32_t value)
+{
+    char frame[kFrameHeaderSize + 4];
+    encode_frame_header(frame, 4, type, 0, id);
+    write_uint32(frame + kFrameHeaderSize, value);
+    out.append(frame, sizeof(frame));
+}
+
+/* HTTP2-Settings头是base64url编码、没有填充的SETTINGS负载 */
+bool base64url_decode(std::string_view in, std::string* out)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    for (char c : in)
+    {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-') v = 62;
+        else if (c == '_') v = 63;
+        else if (c == '=') break;
+        else return false;
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out->push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    return true;
+}
+
+/* HTTP/2不允许的连接级请求头（RFC 9113 8.2.2），响应中去掉 */
+bool is_connection_header(std::string_view name)
+{
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+        || name == "transfer-encoding" || name == "upgrade";
+}
+
+Http2Connection::Http2Connection(const handler* dispatch, size_t max_header_size, size_t max_body_size)
+    : dispatch_callback_(dispatch)
+    , max_header_size_(max_header_size)
+    , max_body_size_(max_body_size)
+    , last_stream_id_(0)
+    , continuation_stream_(0)
+    , continuation_flags_(0)
+    , send_window_(kDefaultWindowSize)
+    , recv_window_(kDefaultWindowSize)
+    , recv_budget_(static_cast<int64_t>(std::min<size_t>(std::max<size_t>(kConnectionWindowSize, max_body_size), kMaxWindowSize)))
+    , buffered_body_(0)
+    , peer_initial_window_(kDefaultWindowSize)
+    , peer_max_frame_size_(kDefaultMaxFrameSize)
+    , preface_received_(false)
+    , settings_received_(false)
+    , peer_going_away_(false)
+    , closing_(false)
+    , throttled_(false)
+    , flushing_(false)
+    , write_completed_(false)
+    , keep_alive_timeout_(std::chrono::seconds(60))
+    , header_timeout_(std::chrono::seconds(10))
+    , body_timeout_(std::chrono::seconds(30))
+    , last_activity_(timer_clock::now())
+    , resets_(0)
+    , reset_window_start_(last_activity_)
+{
+}
+
+void Http2Connection::set_timeouts(timer_clock::duration keep_alive, timer_clock::duration header, timer_clock::duration body)
+{
+    keep_alive_timeout_ = keep_alive;
+    header_timeout_ = header;
+    body_timeout_ = body;
+}
+
+bool Http2Connection::start(TcpConnection* conn, HttpRequest* upgrade, std::string_view settings)
+{
+    Buffer& out = *conn->output_buffer();
+    const uint32_t kSettings[][2] = {
+        { kSettingsMaxConcurrentStreams, kMaxConcurrentStreams },
+        { kSettingsMaxHeaderListSize, static_cast<uint32_t>(max_header_size_) },
+    };
+    char frame[kFrameHeaderSize + sizeof(kSettings) / 8 * 6];
+    char* p = frame + kFrameHeaderSize;
+    encode_frame_header(frame, sizeof(frame) - kFrameHeaderSize, kFrameSettings, 0, 0);
+    for (const auto& setting : kSettings)
+    {
+        p[0] = static_cast<char>(setting[0] >> 8);
+        p[1] = static_cast<char>(setting[0]);
+        write_uint32(p + 2, setting[1]);
+        p += 6;
+    }
+    out.append(frame, sizeof(frame));
+    /* 连接窗口只能用WINDOW_UPDATE调大；流的初始窗口保持默认值，需要接收请求体时再单独调大 */
+    update_windows_(out);
+
+    bool ok = true;
+    if (upgrade)
+    {
+        std::string payload;
+        uint32_t error = kProtocolError;
+        if (!base64url_decode(settings, &payload) || payload.size() % 6 != 0
+            || (error = apply_settings_(payload)) != kNoError)
+        {
+            ok = connection_error_(out, error);
+        }
+        else
+        {
+            /* 升级请求是流1，已经是半关闭（远端）状态 */
+            last_stream_id_ = 1;
+            Stream* stream = new_stream_(1);
+            stream->end_stream_received = true;
+            upgrade->set_version(kHttp2);
+            respond_(out, stream, *upgrade);
+        }
+    }
+    flush_(conn);
+    return ok;
+}
+
+bool Http2Connection::on_message(TcpConnection* conn, Buffer& buf)
+{
+    if (closing_)
+    {
+        buf.retrieve_all();
+        return false;
+    }
+    if (throttled_)
+    {
+        return true;
+    }
+
+    Buffer& out = *conn->output_buffer();
+    if (!preface_received_)
+    {
+        size_t n = std::min(buf.readable_bytes(), kClientPreface.size());
+        if (::memcmp(buf.peek(), kClientPreface.data(), n) != 0)
+        {
+            connection_error_(out, kProtocolError);
+        }
+        else if (n < kClientPreface.size())
+        {
+            return true;
+        }
+        else
+        {
+            buf.retrieve(n);
+            preface_received_ = true;
+        }
+    }
+
+    while (!closing_ && buf.readable_bytes() >= kFrameHeaderSize)
+    {
+        if (out.readable_bytes() >= kMaxBufferedOutput)
+        {
+            /* 对方不读响应，剩下的帧留在buf中，等输出缓冲区发送完再处理 */
+            throttled_ = true;
+            conn->stop_read();
+            break;
+        }
+        const unsigned char* h = reinterpret_cast<const unsigned char*>(buf.peek());
+        size_t length = size_t(h[0]) << 16 | size_t(h[1]) << 8 | h[2];
+        if (length > kDefaultMaxFrameSize)
+        {
+            connection_error_(out, kFrameSizeError);
+            break;
+        }
+        if (buf.readable_bytes() < kFrameHeaderSize + length)
+        {
+            break;
+        }
+        uint32_t id = read_uint32(buf.peek() + 5) & 0x7fffffff;
+        on_frame_(out, h[3], h[4], id, std::string_view(buf.peek() + kFrameHeaderSize, length));
+        buf.retrieve(kFrameHeaderSize + length);
+    }
+
+    if (!closing_)
+    {
+        update_windows_(out);
+    }
+    flush_(conn);
+    if (closing_)
+    {
+        buf.retrieve_all();
+        return false;
+    }
+    /* 对方发送GOAWAY之后，完成已有的流再关闭 */
+    return !(peer_going_away_ && streams_.empty());
+}
+
+bool Http2Connection::on_write_complete(TcpConnection* conn)
+{
+    /* flush_里的send同步发送完时也会回调到这里，由flush_的循环继续 */
+    if (flushing_)
+    {
+        write_completed_ = true;
+        return true;
+    }
+    flush_(conn);
+    if (throttled_ && conn->output_buffer()->readable_bytes() < kMaxBufferedOutput)
+    {
+        throttled_ = false;
+        conn->start_read();
+        return on_message(conn, *conn->input_buffer());
+    }
+    return !closing_ && !(peer_going_away_ && streams_.empty());
+}
+
+/* 超时的流回复408，整个连接没有进展超过keep_alive_timeout或者header block没有按时收完时发送GOAWAY */
+bool Http2Connection::on_timeout(TcpConnection* conn)
+{
+    if (closing_)
+    {
+        return false;
+    }
+    timer_clock::time_point now = timer_clock::now();
+    Buffer& out = *conn->output_buffer();
+    if ((continuation_stream_ != 0 && now >= continuation_deadline_) || now >= last_activity_ + keep_alive_timeout_)
+    {
+        connection_error_(out, kNoError);
+    }
+    else
+    {
+        /* respond_error_会关闭流，先收集 */
+        std::vector<Stream*> expired;
+        for (auto& entry : streams_)
+        {
+            if (!entry.second->end_stream_received && now >= entry.second->deadline)
+            {
+                expired.push_back(entry.second.get());
+            }
+        }
+        for (Stream* stream : expired)
+        {
+            respond_error_(out, stream, 408);
+        }
+        update_windows_(out);
+    }
+    flush_(conn);
+    return !closing_;
+}
+
+timer_clock::time_point Http2Connection::deadline() const
+{
+    timer_clock::time_point deadline = last_activity_ + keep_alive_timeout_;
+    if (continuation_stream_ != 0)
+    {
+        deadline = std::min(deadline, continuation_deadline_);
+    }
+    for (const auto& entry : streams_)
+    {
+        if (!entry.second->end_stream_received)
+        {
+            deadline = std::min(deadline, entry.second->deadline);
+        }
+    }
+    return deadline;
+}
+
+/* 处理一个完整的帧，连接错误时发送GOAWAY并返回false */
+bool Http2Connection::on_frame_(Buffer& out, uint8_t type, uint8_t flags, uint32_t id, std::string_view payload)
+{
+    if (!settings_received_ && type != kFrameSettings)
+    {
+        return connection_error_(out, kProtocolError);
+    }
+    /* header block必须连续，中间不能插入其他帧 */
+    if (continuation_stream_ != 0 && (type != kFrameContinuation || id != continuation_stream_))
+    {
+        return connection_error_(out, kProtocolError);
+    }
+
+    switch (type)
+    {
+    case kFrameData:
+        return on_data_(out, flags, id, payload);
+    case kFrameHeaders:
+        return on_headers_(out, flags, id, payload);
+    case kFramePriority:
+        if (id == 0)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        if (payload.size() != 5)
+        {
+            reset_stream_(out, id, kFrameSizeError);
+        }
+        return true;
+    case kFrameRstStream:
+        if (id == 0 || id > last_stream_id_)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        if (payload.size() != 4)
+        {
+            return connection_error_(out, kFrameSizeError);
+        }
+        if (Stream* stream = find_stream_(id))
+        {
+            close_stream_(stream);
+        }
+        return count_reset_(out);
+    case kFrameSettings:
+        return on_settings_(out, flags, id, payload);
+    case kFramePing:
+        if (id != 0)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        if (payload.size() != 8)
+        {
+            return connection_error_(out, kFrameSizeError);
+        }
+        if (!(flags & kFlagAck))
+        {
+            write_frame_header(out, 8, kFramePing, kFlagAck, 0);
+            out.append(payload);
+        }
+        return true;
+    case kFrameGoAway:
+        if (id != 0)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        peer_going_away_ = true;
+        return true;
+    case kFrameWindowUpdate:
+        return on_window_update_(out, id, payload);
+    case kFrameContinuation:
+        if (continuation_stream_ == 0)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        if (header_block_.size() + payload.size() > kMaxHeaderBlockSize)
+        {
+            return connection_error_(out, kEnhanceYourCalm);
+        }
+        header_block_.append(payload);
+        if (flags & kFlagEndHeaders)
+        {
+            continuation_stream_ = 0;
+            return on_header_block_(out, continuation_flags_, id, header_block_);
+        }
+        return true;
+    case kFramePushPromise:
+        /* 客户端不能推送 */
+        return connection_error_(out, kProtocolError);
+    default:
+        /* 未知类型的帧忽略 */
+        return true;
+    }
+}
+
+bool Http2Connection::on_headers_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload)
+{
+    if (id == 0 || id % 2 == 0)
+    {
+        return connection_error_(out, kProtocolError);
+    }
+    size_t padding = 0;
+    if (flags & kFlagPadded)
+    {
+        if (payload.empty())
+        {
+            return connection_error_(out, kFrameSizeError);
+        }
+        padding = static_cast<unsigned char>(payload[0]);
+        payload.remove_prefix(1);
+    }
+    if (flags & kFlagPriority)
+    {
+        /* 不支持优先级，跳过依赖的流和权重 */
+        if (payload.size() < 5)
+        {
+            return connection_error_(out, kFrameSizeError);
+        }
+        payload.remove_prefix(5);
+    }
+    if (padding > payload.size())
+    {
+        return connection_error_(out, kProtocolError);
+    }
+    payload.remove_suffix(padding);
+
+    if (!(flags & kFlagEndHeaders))
+    {
+        continuation_stream_ = id;
+        continuation_flags_ = flags;
+        continuation_deadline_ = timer_clock::now() + header_timeout_;
+        header_block_.assign(payload);
+        return true;
+    }
+    return on_header_block_(out, flags, id, payload);
+}
+
+/* 一个完整的header block：新的流，或者已有的流上的trailer */
+bool Http2Connection::on_header_block_(Buffer& out, uint8_t flags, uint32_t id, std::string_view block)
+{
+    Stream* stream = nullptr;
+    bool is_new = id > last_stream_id_;
+    if (is_new)
+    {
+        last_stream_id_ = id;
+        if (streams_.size() < kMaxConcurrentStreams)
+        {
+            stream = new_stream_(id);
+        }
+    }
+    else
+    {
+        stream = find_stream_(id);
+    }
+
+    /* 不使用的header block（trailer、被拒绝或者已经关闭的流）也要解码，保持动态表同步 */
+    scratch_.clear();
+    scratch_fields_.clear();
+    HpackDecoder::result result = is_new && stream
+        ? decoder_.decode(block, max_header_size_, &stream->headers, &stream->fields)
+        : decoder_.decode(block, max_header_size_, &scratch_, &scratch_fields_);
+    if (result == HpackDecoder::kError)
+    {
+        return connection_error_(out, kCompressionError);
+    }
+
+    if (!stream)
+    {
+        /* RFC 9113 5.1：已经关闭的流上不能再收到HEADERS */
+        reset_stream_(out, id, is_new ? kRefusedStream : kStreamClosed);
+        return true;
+    }
+    if (!is_new)
+    {
+        /* trailer必须结束流，内容忽略 */
+        if (stream->end_stream_received)
+        {
+            reset_stream_(out, id, kStreamClosed);
+        }
+        else if (!(flags & kFlagEndStream))
+        {
+            reset_stream_(out, id, kProtocolError);
+        }
+        else
+        {
+            stream->end_stream_received = true;
+            dispatch_(out, stream);
+        }
+        return true;
+    }
+
+    stream->header_too_large = result == HpackDecoder::kListTooLarge;
+    if (flags & kFlagEndStream)
+    {
+        stream->end_stream_received = true;
+        dispatch_(out, stream);
+    }
+    else if (stream->header_too_large)
+    {
+        respond_error_(out, stream, 431);
+    }
+    else
+    {
+        receiving_.push_back(stream);
+    }
+    return true;
+}
+
+bool Http2Connection::on_data_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload)
+{
+    if (id == 0 || id > last_stream_id_)
+    {
+        return connection_error_(out, kProtocolError);
+    }
+
+    /* 填充也计入流量控制 */
+    int64_t length = static_cast<int64_t>(payload.size());
+    recv_window_ -= length;
+    if (recv_window_ < 0)
+    {
+        return connection_error_(out, kFlowControlError);
+    }
+    if (flags & kFlagPadded)
+    {
+        if (payload.empty() || static_cast<unsigned char>(payload[0]) >= payload.size())
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        payload.remove_suffix(static_cast<unsigned char>(payload[0]));
+        payload.remove_prefix(1);
+    }
+
+    /* 已经关闭的流，可能是我们刚刚RST_STREAM的，丢弃 */
+    Stream* stream = find_stream_(id);
+    if (!stream)
+    {
+        return true;
+    }
+    if (stream->end_stream_received)
+    {
+        reset_stream_(out, id, kStreamClosed);
+        return true;
+    }
+    stream->recv_window -= length;
+    if (stream->recv_window < 0)
+    {
+        reset_stream_(out, id, kFlowControlError);
+        return true;
+    }
+    if (stream->body.size() + payload.size() > max_body_size_)
+    {
+        respond_error_(out, stream, HttpResponse::k413PayloadTooLarge);
+        return true;
+    }
+    stream->body.append(payload);
+    buffered_body_ += payload.size();
+    last_activity_ = timer_clock::now();
+    stream->deadline = last_activity_ + body_timeout_;
+
+    if (flags & kFlagEndStream)
+    {
+        stream->end_stream_received = true;
+        dispatch_(out, stream);
+    }
+    return true;
+}
+
+bool Http2Connection::on_settings_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload)
+{
+    if (id != 0)
+    {
+        return connection_error_(out, kProtocolError);
+    }
+    if (flags & kFlagAck)
+    {
+        return payload.empty() ? true : connection_error_(out, kFrameSizeError);
+    }
+    if (payload.size() % 6 != 0)
+    {
+        return connection_error_(out, kFrameSizeError);
+    }
+    uint32_t error = apply_settings_(payload);
+    if (error != kNoError)
+    {
+        return connection_error_(out, error);
+    }
+    settings_received_ = true;
+    write_frame_header(out, 0, kFrameSettings, kFlagAck, 0);
+    return true;
+}
+
+/* 返回错误码，没有错误时返回kNoError */
+uint32_t Http2Connection::apply_settings_(std::string_view payload)
+{
+    for (size_t i = 0; i + 6 <= payload.size(); i += 6)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(payload.data() + i);
+        uint32_t value = read_uint32(payload.data() + i + 2);
+        switch (p[0] << 8 | p[1])
+        {
+        case kSettingsHeaderTableSize:
+            encoder_.set_max_table_size(value);
+            break;
+        case kSettingsEnablePush:
+            if (value > 1)
+            {
+                return kProtocolError;
+            }
+            break;
+        case kSettingsInitialWindowSize:
+        {
+            if (value > kMaxWindowSize)
+            {
+                return kFlowControlError;
+            }
+            /* 已有的流的发送窗口按差值调整，可以变成负数 */
+            int64_t delta = int64_t(value) - peer_initial_window_;
+            peer_initial_window_ = value;
+            for (auto& entry : streams_)
+            {
+                Stream* stream = entry.second.get();
+                stream->send_window += delta;
+                if (stream->send_window > kMaxWindowSize)
+                {
+                    return kFlowControlError;
+                }
+                queue_stream_(stream);
+            }
+            break;
+        }
+        case kSettingsMaxFrameSize:
+            if (value < kDefaultMaxFrameSize || value > 0xffffff)
+            {
+                return kProtocolError;
+            }
+            peer_max_frame_size_ = value;
+            break;
+        default:
+            /* MAX_CONCURRENT_STREAMS只限制服务端推送，其他未知的设置忽略 */
+            break;
+        }
+    }
+    return kNoError;
+}
+
+bool Http2Connection::on_window_update_(Buffer& out, uint32_t id, std::string_view payload)
+{
+    if (payload.size() != 4)
+    {
+        return connection_error_(out, kFrameSizeError);
+    }
+    uint32_t increment = read_uint32(payload.data()) & 0x7fffffff;
+    if (id == 0)
+    {
+        send_window_ += increment;
+        if (increment == 0)
+        {
+            return connection_error_(out, kProtocolError);
+        }
+        if (send_window_ > kMaxWindowSize)
+        {
+            return connection_error_(out, kFlowControlError);
+        }
+        return true;
+    }
+    if (id > last_stream_id_)
+    {
+        return connection_error_(out, kProtocolError);
+    }
+    Stream* stream = find_stream_(id);
+    if (!stream)
+    {
+        return true;
+    }
+    stream->send_window += increment;
+    if (increment == 0)
+    {
+        reset_stream_(out, id, kProtocolError);
+    }
+    else if (stream->send_window > kMaxWindowSize)
+    {
+        reset_stream_(out, id, kFlowControlError);
+    }
+    else
+    {
+        queue_stream_(stream);
+    }
+    return true;
+}
+
+/* 请求完整了，构造HttpRequest，调用分发生成响应 */
+void Http2Connection::dispatch_(Buffer& out, Stream* stream)
+{
+    /* 每个IO线程复用一个请求对象，请求头直接指向流中解码出来的数据 */
+    thread_local HttpRequest t_request;
+    t_request.reset();
+    /* 请求体交给http回调之后就不再占用连接的接收额度 */
+    request_body_.swap(stream->body);
+    stream->body.clear();
+    buffered_body_ -= request_body_.size();
+    int status = 0;
+    if (!build_request_(stream, &t_request, &status))
+    {
+        if (status != 0)
+        {
+            respond_error_(out, stream, status);
+        }
+        else
+        {
+            reset_stream_(out, stream->id, kProtocolError);
+        }
+        return;
+    }
+    respond_(out, stream, t_request);
+}
+
+/**
+ *  伪头部转换成HttpRequest的方法、路径和查询，:authority作为Host头
+ *  格式错误（RFC 9113 8.1.1）时返回false，status为0表示用RST_STREAM拒绝，否则回复这个状态码
+ */
+bool Http2Connection::build_request_(Stream* stream, HttpRequest* req, int* status)
+{
+    if (stream->header_too_large)
+    {
+        *status = 431;
+        return false;
+    }
+
+    const char* base = stream->headers.data();
+    std::string_view authority;
+    std::string_view scheme;
+    std::string_view path;
+    bool method = false;
+    bool regular = false;
+    size_t num_cookies = 0;
+    for (const HpackDecoder::Field& field : stream->fields)
+    {
+        std::string_view name(base + field.name_offset, field.name_length);
+        std::string_view value(base + field.value_offset, field.value_length);
+        if (name.empty() || std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; }))
+        {
+            return false;
+        }
+        if (name[0] != ':')
+        {
+            regular = true;
+            if (is_connection_header(name) || (name == "te" && value != "trailers"))
+            {
+                return false;
+            }
+            num_cookies += name == "cookie";
+            continue;
+        }
+        /* 伪头部只能出现在普通请求头之前，不能重复 */
+        if (regular)
+        {
+            return false;
+        }
+        if (name == ":method" && !method)
+        {
+            method = true;
+            if (!req->set_method(value))
+            {
+                *status = 400;
+                return false;
+            }
+        }
+        else if (name == ":path" && path.empty() && !value.empty())
+        {
+            path = value;
+        }
+        else if (name == ":scheme" && scheme.empty() && !value.empty())
+        {
+            scheme = value;
+        }
+        else if (name == ":authority" && authority.empty())
+        {
+            authority = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!method || path.empty() || scheme.empty())
+    {
+        return false;
+    }
+
+    size_t query = path.find('?');
+    req->set_path(path.substr(0, query));
+    req->set_query(query == std::string_view::npos ? std::string_view() : path.substr(query));
+    req->set_version(kHttp2);
+    req->set_receive_time(timer_clock::now());
+    req->set_body(request_body_);
+
+    bool ok = true;
+    if (!authority.empty() && std::none_of(stream->fields.begin(), stream->fields.end(),
+        [base](const HpackDecoder::Field& field) {
+            return std::string_view(base + field.name_offset, field.name_length) == "host";
+        }))
+    {
+        ok = req->add_header("host", authority);
+    }
+    /* HTTP/2可以把cookie拆成多个头（RFC 9113 8.2.3），合并成一个交给http回调 */
+    if (num_cookies > 1)
+    {
+        stream->cookie.clear();
+        for (const HpackDecoder::Field& field : stream->fields)
+        {
+            if (std::string_view(base + field.name_offset, field.name_length) == "cookie")
+            {
+                if (!stream->cookie.empty())
+                {
+                    stream->cookie.append("; ");
+                }
+                stream->cookie.append(base + field.value_offset, field.value_length);
+            }
+        }
+        ok = ok && req->add_header("cookie", stream->cookie);
+    }
+    for (const HpackDecoder::Field& field : stream->fields)
+    {
+        std::string_view name(base + field.name_offset, field.name_length);
+        if (name[0] != ':' && !(num_cookies > 1 && name == "cookie"))
+        {
+            ok = ok && req->add_header(name, std::string_view(base + field.value_offset, field.value_length));
+        }
+    }
+    if (!ok)
+    {
+        *status = 431;
+        return false;
+    }
+    return true;
+}
+
+/* 调用分发生成响应，响应头立即写出，响应体挂在流上等待发送 */
+void Http2Connection::respond_(Buffer& out, Stream* stream, HttpRequest& req)
+{
+    thread_local HttpResponse t_response(false);
+    t_response.reset(false);
+    (*dispatch_callback_)(req, t_response);
+
+    int status = t_response.status_code();
+    if (status < 100 || status > 999)
+    {
+        status = 500;
+    }
+    size_t length = t_response.has_file_body() ? t_response.file_length() : t_response.body().size();
+    bool with_body = req.method() != HttpRequest::kHead && status != 304 && length > 0;
+
+    block_.clear();
+    encoder_.begin_block(&block_);
+    encoder_.encode_status(status, &block_);
+    encode_header_lines_(http_date_header());
+    if (status != 304)
+    {
+        char digits[24];
+        int n = ::snprintf(digits, sizeof(digits), "%zu", length);
+        encoder_.encode("content-length", std::string_view(digits, static_cast<size_t>(n)), &block_, false);
+    }
+    encode_header_lines_(t_response.headers());
+    write_header_block_(out, stream->id, !with_body);
+
+    if (with_body)
+    {
+        stream->holder = t_response.holder();
+        if (t_response.has_file_body())
+        {
+            stream->file_fd = t_response.file_fd();
+            stream->file_offset = t_response.file_offset();
+            stream->file_remaining = length;
+        }
+        else if (stream->holder)
+        {
+            stream->data = t_response.body();
+        }
+        else
+        {
+            /* 取走响应对象中的body，不拷贝 */
+            stream->response_body = t_response.take_body();
+            stream->data = stream->response_body;
+        }
+        queue_stream_(stream);
+    }
+    else
+    {
+        close_stream_(stream);
+    }
+    /* 不要让线程局部的响应对象一直持有文件 */
+    t_response.reset(false);
+}
+
+/* 请求还没有完整时提前回复错误，之后用RST_STREAM(NO_ERROR)让对方停止发送（RFC 9113 8.1） */
+void Http2Connection::respond_error_(Buffer& out, Stream* stream, int status)
+{
+    block_.clear();
+    encoder_.begin_block(&block_);
+    encoder_.encode_status(status, &block_);
+    encode_header_lines_(http_date_header());
+    encoder_.encode("content-length", "0", &block_);
+    write_header_block_(out, stream->id, true);
+    if (stream->end_stream_received)
+    {
+        close_stream_(stream);
+    }
+    else
+    {
+        reset_stream_(out, stream->id, kNoError);
+    }
+}
+
+/* 把"Key: value\r\n"格式的响应头编码进block_，名字转成小写，去掉连接级的头 */
+void Http2Connection::encode_header_lines_(std::string_view lines)
+{
+    while (!lines.empty())
+    {
+        size_t end = lines.find("\r\n");
+        std::string_view line = lines.substr(0, end);
+        lines.remove_prefix(end == std::string_view::npos ? lines.size() : end + 2);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+        {
+            continue;
+        }
+        name_.assign(line.substr(0, colon));
+        for (char& c : name_)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ')
+        {
+            value.remove_prefix(1);
+        }
+        if (!is_connection_header(name_))
+        {
+            encoder_.encode(name_, value, &block_);
+        }
+    }
+}
+
+/* block_作为HEADERS发送，超过对方的最大帧长时拆成CONTINUATION */
+void Http2Connection::write_header_block_(Buffer& out, uint32_t id, bool end_stream)
+{
+    std::string_view block = block_;
+    uint8_t type = kFrameHeaders;
+    uint8_t flags = end_stream ? kFlagEndStream : 0;
+    do
+    {
+        size_t n = std::min(block.size(), static_cast<size_t>(peer_max_frame_size_));
+        if (n == block.size())
+        {
+            flags |= kFlagEndHeaders;
+        }
+        write_frame_header(out, n, type, flags, id);
+        out.append(block.substr(0, n));
+        block.remove_prefix(n);
+        type = kFrameContinuation;
+        flags = 0;
+    } while (!block.empty());
+}
+
+/* 按轮转把等待中的响应体写成DATA帧，直到窗口用完或者输出缓冲区积压 */
+void Http2Connection::send_pending_(Buffer& out)
+{
+    size_t max_frame = std::min(static_cast<size_t>(peer_max_frame_size_), kMaxSendFrameSize);
+    while (!send_queue_.empty() && send_window_ > 0 && out.readable_bytes() < kMaxBufferedOutput)
+    {
+        Stream* stream = send_queue_.front();
+        send_queue_.pop_front();
+        stream->in_send_queue = false;
+        if (stream->send_window <= 0)
+        {
+            /* 等WINDOW_UPDATE再放回队列 */
+            continue;
+        }
+
+        size_t remaining = stream->data.size() + stream->file_remaining;
+        size_t n = std::min({remaining, max_frame, static_cast<size_t>(send_window_),
+            static_cast<size_t>(stream->send_window)});
+        if (stream->file_remaining > 0)
+        {
+            out.ensure_writabel_bytes(kFrameHeaderSize + n);
+            ssize_t r = ::pread(stream->file_fd, out.begin_write() + kFrameHeaderSize, n, stream->file_offset);
+            if (r <= 0)
+            {
+                /* 文件被截断或者读出错，响应已经无法完成 */
+                reset_stream_(out, stream->id, kInternalError);
+                continue;
+            }
+            n = static_cast<size_t>(r);
+            encode_frame_header(out.begin_write(), n, kFrameData, n == remaining ? kFlagEndStream : 0, stream->id);
+            out.has_written(kFrameHeaderSize + n);
+            stream->file_offset += r;
+            stream->file_remaining -= n;
+        }
+        else
+        {
+            write_frame_header(out, n, kFrameData, n == remaining ? kFlagEndStream : 0, stream->id);
+            out.append(stream->data.substr(0, n));
+            stream->data.remove_prefix(n);
+        }
+        send_window_ -= static_cast<int64_t>(n);
+        stream->send_window -= static_cast<int64_t>(n);
+        last_activity_ = timer_clock::now();
+
+        if (n == remaining)
+        {
+            close_stream_(stream);
+        }
+        else
+        {
+            queue_stream_(stream);
+        }
+    }
+}
+
+void Http2Connection::flush_(TcpConnection* conn)
+{
+    flushing_ = true;
+    do
+    {
+        write_completed_ = false;
+        send_pending_(*conn->output_buffer());
+        conn->flush_output();
+    } while (write_completed_ && !send_queue_.empty() && send_window_ > 0);
+    flushing_ = false;
+}
+
+Http2Connection::Stream* Http2Connection::find_stream_(uint32_t id)
+{
+    auto it = streams_.find(id);
+    return it == streams_.end() ? nullptr : it->second.get();
+}
+
+Http2Connection::Stream* Http2Connection::new_stream_(uint32_t id)
+{
+    std::unique_ptr<Stream> stream;
+    if (free_streams_.empty())
+    {
+        stream = std::make_unique<Stream>();
+    }
+    else
+    {
+        stream = std::move(free_streams_.back());
+        free_streams_.pop_back();
+    }
+    stream->id = id;
+    stream->send_window = peer_initial_window_;
+    stream->recv_window = kDefaultWindowSize;
+    last_activity_ = timer_clock::now();
+    stream->deadline = last_activity_ + body_timeout_;
+    Stream* ptr = stream.get();
+    streams_[id] = std::move(stream);
+    return ptr;
+}
+
+/* 流结束，清空后放回free_streams_，保留字符串的容量 */
+void Http2Connection::close_stream_(Stream* stream)
+{
+    if (stream->in_send_queue)
+    {
+        send_queue_.erase(std::find(send_queue_.begin(), send_queue_.end(), stream));
+    }
+    auto it = streams_.find(stream->id);
+    std::unique_ptr<Stream> owner = std::move(it->second);
+    streams_.erase(it);
+    auto receiving = std::find(receiving_.begin(), receiving_.end(), stream);
+    if (receiving != receiving_.end())
+    {
+        receiving_.erase(receiving);
+    }
+    last_activity_ = timer_clock::now();
+
+    owner->end_stream_received = false;
+    owner->header_too_large = false;
+    owner->in_send_queue = false;
+    owner->headers.clear();
+    owner->fields.clear();
+    owner->cookie.clear();
+    buffered_body_ -= owner->body.size();
+    owner->body.clear();
+    owner->response_body.clear();
+    owner->holder.reset();
+    owner->data = std::string_view();
+    owner->file_fd = -1;
+    owner->file_offset = 0;
+    owner->file_remaining = 0;
+    free_streams_.push_back(std::move(owner));
+}
+
+void Http2Connection::reset_stream_(Buffer& out, uint32_t id, uint32_t error)
+{
+    write_uint32_frame(out, kFrameRstStream, id, error);
+    if (Stream* stream = find_stream_(id))
+    {
+        close_stream_(stream);
+    }
+    /* 响应已经发完、只是不再需要剩下的请求体时不是对方的问题 */
+    if (error != kNoError)
+    {
+        count_reset_(out);
+    }
+}
+
+/* 流被取消或者重置的次数按kResetWindow统计，超过上限时发送GOAWAY并返回false */
+bool Http2Connection::count_reset_(Buffer& out)
+{
+    timer_clock::time_point now = timer_clock::now();
+    if (now - reset_window_start_ >= kResetWindow)
+    {
+        reset_window_start_ = now;
+        resets_ = 0;
+    }
+    if (++resets_ > kMaxResetsPerWindow)
+    {
+        return connection_error_(out, kEnhanceYourCalm);
+    }
+    return true;
+}
+
+/**
+ *  连接的接收窗口加上缓存中还没有交给http回调的请求体不超过recv_budget_，请求体被消费（分发或者流关闭）之后才补回，
+ *  所以一个连接缓存的请求体总量有上限
+ *
+ *  流窗口按流打开的顺序授予，额度不够时只补最早的流：否则对方把连接窗口分散到所有流上，
+ *  每个流都只收到一部分请求体，额度用完之后所有流互相等待，直到body超时
+ */
+void Http2Connection::update_windows_(Buffer& out)
+{
+    receiving_.erase(std::remove_if(receiving_.begin(), receiving_.end(),
+        [](Stream* stream) { return stream->end_stream_received; }), receiving_.end());
+    int64_t available = recv_budget_ - static_cast<int64_t>(buffered_body_);
+    for (Stream* stream : receiving_)
+    {
+        available -= stream->recv_window;
+    }
+    for (Stream* stream : receiving_)
+    {
+        /* 窗口不超过请求体还能接收的长度，剩下的窗口用掉一半时补满 */
+        int64_t target = static_cast<int64_t>(std::min<size_t>(kStreamWindowSize, max_body_size_ - stream->body.size()));
+        if (stream->recv_window >= target / 2)
+        {
+            continue;
+        }
+        int64_t increment = target - stream->recv_window;
+        if (increment > available && stream != receiving_.front())
+        {
+            break;
+        }
+        write_uint32_frame(out, kFrameWindowUpdate, stream->id, static_cast<uint32_t>(increment));
+        stream->recv_window = target;
+        available -= increment;
+    }
+
+    int64_t target = recv_budget_ - static_cast<int64_t>(buffered_body_);
+    if (recv_window_ < target / 2)
+    {
+        write_uint32_frame(out, kFrameWindowUpdate, 0, static_cast<uint32_t>(target - recv_window_));
+        recv_window_ = target;
+    }
+}
+
+/* 有响应体等待发送并且流窗口大于0时放进发送队列 */
+void Http2Connection::queue_stream_(Stream* stream)
+{
+    if (!stream->in_send_queue && stream->send_window > 0
+        && (!stream->data.empty() || stream->file_remaining > 0))
+    {
+        stream->in_send_queue = true;
+        send_queue_.push_back(stream);
+    }
+}
+
+/* 发送GOAWAY，之后不再处理任何帧；总是返回false */
+bool Http2Connection::connection_error_(Buffer& out, uint32_t error)
+{
+    if (!closing_)
+    {
+        char frame[kFrameHeaderSize + 8];
+        encode_frame_header(frame, 8, kFrameGoAway, 0, 0);
+        write_uint32(frame + kFrameHeaderSize, last_stream_id_);
+        write_uint32(frame + kFrameHeaderSize + 4, error);
+        out.append(frame, sizeof(frame));
+        closing_ = true;
+    }
+    return false;
+}
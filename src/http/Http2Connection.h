@@ -0,0 +1,158 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/http/Hpack.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class HttpRequest;
+class HttpResponse;
+
+/**
+ *  HttpServer的一个明文HTTP/2（h2c，RFC 9113）连接，只做服务端，不支持server push
+ *
+ *  一个连接上的多个流并发：每个流收到END_STREAM时构造HttpRequest交给与HTTP/1.x相同的分发，
+ *  生成的响应头用HPACK编码后立即写出，响应体挂在流上，按对方的流和连接窗口轮流以DATA帧发送；
+ *  文件响应体用pread分块读入DATA帧，不能用sendfile
+ *
+ *  请求体完整地缓存在流中，超过max_body_size时回复413（不支持body回调）；连接窗口只在缓存的请求体交给http回调之后
+ *  才补回，所以一个连接缓存的请求体总量不超过kConnectionWindowSize和max_body_size中较大的一个，
+ *  在这个额度内按流打开的顺序把流窗口调大到kStreamWindowSize
+ *
+ *  还没有收完的流从打开或者上一个DATA起body_timeout内没有新数据时回复408，header block要在header_timeout内收完；
+ *  整个连接keep_alive_timeout内没有新的流、没有收发请求体或响应体时发送GOAWAY，PING等控制帧不算进展
+ *
+ *  输出缓冲区积压时暂停读取，和HTTP/1.x一样每个连接占用的内存有上限；
+ *  对方短时间内取消或者被重置的流太多（rapid reset）时以ENHANCE_YOUR_CALM关闭连接
+ */
+class Http2Connection
+{
+public:
+    /* 与HttpServer的路由和http回调相同的分发 */
+    using handler = std::function<void(HttpRequest&, HttpResponse&)>;
+
+    static constexpr std::string_view kClientPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    static const uint32_t kMaxConcurrentStreams = 256;
+    static const uint32_t kStreamWindowSize = 1024 * 1024;
+    static const uint32_t kConnectionWindowSize = 4 * 1024 * 1024;
+
+    Http2Connection(const handler* dispatch, size_t max_header_size, size_t max_body_size);
+
+    Http2Connection(const Http2Connection&) = delete;
+    Http2Connection& operator=(const Http2Connection&) = delete;
+
+    /* 必须在start之前设置，默认与HttpServer的默认值相同 */
+    void set_timeouts(timer_clock::duration keep_alive, timer_clock::duration header, timer_clock::duration body);
+
+    /**
+     *  发送服务端的SETTINGS；通过"Upgrade: h2c"升级时upgrade是升级请求，作为流1处理，
+     *  settings是它的HTTP2-Settings头
+     *  返回false时连接应该关闭，GOAWAY已经写进输出缓冲区
+     */
+    bool start(TcpConnection* conn, HttpRequest* upgrade = nullptr, std::string_view settings = std::string_view());
+
+    /* 解析buf中所有完整的帧，返回值同start */
+    bool on_message(TcpConnection* conn, Buffer& buf);
+    /* 输出缓冲区发送完了，继续发送等待中的响应体 */
+    bool on_write_complete(TcpConnection* conn);
+
+    /* 下一个需要调用on_timeout的时间 */
+    timer_clock::time_point deadline() const;
+    /* 到了deadline时调用，返回值同start */
+    bool on_timeout(TcpConnection* conn);
+
+private:
+    struct Stream
+    {
+        uint32_t id = 0;
+        int64_t send_window = 0;
+        int64_t recv_window = 0;
+        bool end_stream_received = false;   /* 请求已经完整 */
+        bool header_too_large = false;
+        bool in_send_queue = false;
+        timer_clock::time_point deadline;   /* 请求没有收完时，下一个DATA必须在这之前到达 */
+        std::string headers;                /* 解码出来的请求头 */
+        std::vector<HpackDecoder::Field> fields;
+        std::string cookie;                 /* 拆成多个的cookie头合并后的值 */
+        std::string body;
+        /* 还没有发送的响应体：内存中的data，或者文件fd中从file_offset开始的file_remaining个字节 */
+        std::string response_body;
+        std::shared_ptr<const void> holder;
+        std::string_view data;
+        int file_fd = -1;
+        off_t file_offset = 0;
+        size_t file_remaining = 0;
+    };
+
+    bool on_frame_(Buffer& out, uint8_t type, uint8_t flags, uint32_t id, std::string_view payload);
+    bool on_headers_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload);
+    bool on_header_block_(Buffer& out, uint8_t flags, uint32_t id, std::string_view block);
+    bool on_data_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload);
+    bool on_settings_(Buffer& out, uint8_t flags, uint32_t id, std::string_view payload);
+    bool on_window_update_(Buffer& out, uint32_t id, std::string_view payload);
+    uint32_t apply_settings_(std::string_view payload);
+
+    void dispatch_(Buffer& out, Stream* stream);
+    bool build_request_(Stream* stream, HttpRequest* req, int* status);
+    void respond_(Buffer& out, Stream* stream, HttpRequest& req);
+    void respond_error_(Buffer& out, Stream* stream, int status);
+    void encode_header_lines_(std::string_view lines);
+    void write_header_block_(Buffer& out, uint32_t id, bool end_stream);
+    void send_pending_(Buffer& out);
+    void flush_(TcpConnection* conn);
+
+    Stream* find_stream_(uint32_t id);
+    Stream* new_stream_(uint32_t id);
+    void close_stream_(Stream* stream);
+    void reset_stream_(Buffer& out, uint32_t id, uint32_t error);
+    bool count_reset_(Buffer& out);
+    void queue_stream_(Stream* stream);
+    void update_windows_(Buffer& out);
+    bool connection_error_(Buffer& out, uint32_t error);
+
+private:
+    const handler* dispatch_callback_;
+    size_t max_header_size_;
+    size_t max_body_size_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    std::unordered_map<uint32_t, std::unique_ptr<Stream>> streams_;
+    std::vector<std::unique_ptr<Stream>> free_streams_;    /* 复用关闭的流，保留分配的内存 */
+    std::deque<Stream*> send_queue_;                        /* 有响应体等待发送并且流窗口大于0 */
+    std::vector<Stream*> receiving_;                        /* 请求体还没有收完的流，按流id排序 */
+    uint32_t last_stream_id_;
+    uint32_t continuation_stream_;      /* 正在等待CONTINUATION的流，没有时是0 */
+    uint8_t continuation_flags_;
+    timer_clock::time_point continuation_deadline_;
+    std::string header_block_;          /* HEADERS和CONTINUATION拼接起来的header block */
+    int64_t send_window_;               /* 连接的发送窗口 */
+    int64_t recv_window_;
+    int64_t recv_budget_;               /* 接收窗口加上缓存的请求体的上限 */
+    size_t buffered_body_;              /* 所有流中还没有交给http回调的请求体 */
+    uint32_t peer_initial_window_;
+    uint32_t peer_max_frame_size_;
+    bool preface_received_;
+    bool settings_received_;
+    bool peer_going_away_;
+    bool closing_;                      /* 已经发送GOAWAY */
+    bool throttled_;                    /* 输出积压，已经暂停读取 */
+    bool flushing_;
+    bool write_completed_;
+    timer_clock::duration keep_alive_timeout_;
+    timer_clock::duration header_timeout_;
+    timer_clock::duration body_timeout_;
+    timer_clock::time_point last_activity_;     /* 上一次有流打开、收到DATA或者发送DATA的时间 */
+    uint32_t resets_;                           /* 从reset_window_start_起对方取消和因为出错重置的流 */
+    timer_clock::time_point reset_window_start_;
+    std::string block_;                 /* 复用的响应头编码缓冲区 */
+    std::string name_;
+    std::string request_body_;          /* 正在分发的请求的请求体 */
+    std::string scratch_;               /* 丢弃的header block（trailer、被拒绝的流）的解码缓冲区 */
+    std::vector<HpackDecoder::Field> scratch_fields_;
+};
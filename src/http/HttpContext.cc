@@ -0,0 +1,418 @@
+#include "src/http/HttpContext.h"
+#include "src/Buffer.h"
+
+#include <string.h>
+#include <algorithm>
+
+const char kHeaderEnd[] = "\r\n\r\n";
+
+HttpContext::HttpContext(size_t max_header_size, size_t max_body_size, const http_body_callback* body_callback)
+    : max_header_size_(max_header_size)
+    , max_body_size_(max_body_size)
+    , body_callback_(body_callback)
+    , state_(kExpectHeaders)
+    , base_(nullptr)
+    , scanned_(0)
+    , head_length_(0)
+    , request_length_(0)
+    , body_length_(0)
+    , remaining_(0)
+    , trailers_length_(0)
+    , streaming_(false)
+    , continue_pending_(false)
+    , error_status_(400)
+    , paused_(false)
+    , resumed_(false)
+{}
+
+bool HttpContext::parse_request(Buffer& buf, timer_clock::time_point receive_time)
+{
+    if (state_ == kExpectHeaders)
+    {
+        /* 忽略请求之前多余的空行 */
+        while (scanned_ == 0 && buf.readable_bytes() >= 2 && buf.peek()[0] == '\r' && buf.peek()[1] == '\n')
+        {
+            buf.retrieve(2);
+        }
+
+        const char* start = buf.peek() + scanned_;
+        const void* found = ::memmem(start, static_cast<size_t>(buf.begin_write() - start), kHeaderEnd, 4);
+        if (!found)
+        {
+            if (buf.readable_bytes() > max_header_size_)
+            {
+                return fail_(431);
+            }
+            /* 结束标志可能跨越两次到达的数据，保留最后3个字节下次重新查找 */
+            scanned_ = buf.readable_bytes() > 3 ? buf.readable_bytes() - 3 : 0;
+            return true;
+        }
+
+        const char* end = static_cast<const char*>(found);
+        if (static_cast<size_t>(end + 4 - buf.peek()) > max_header_size_)
+        {
+            return fail_(431);
+        }
+        const char* crlf = static_cast<const char*>(::memchr(buf.peek(), '\r', static_cast<size_t>(end + 2 - buf.peek())));
+        if (!process_request_line_(buf.peek(), crlf))
+        {
+            return fail_(400);
+        }
+        if (!process_headers_(crlf + 2, end + 2))
+        {
+            return false;
+        }
+        request_.set_receive_time(receive_time);
+        base_ = buf.peek();
+        head_length_ = static_cast<size_t>(end + 4 - buf.peek());
+        request_length_ = head_length_;
+        if (!start_body_())
+        {
+            return false;
+        }
+    }
+    else if (buf.peek() != base_)
+    {
+        /* 等待请求体期间buf可能因为扩容或者整理而移动 */
+        request_.rebase(base_, buf.peek());
+        base_ = buf.peek();
+    }
+
+    if (state_ != kGotAll && !parse_body_(buf))
+    {
+        return false;
+    }
+
+    if (state_ == kGotAll && !streaming_)
+    {
+        request_.set_body(std::string_view(buf.peek() + head_length_, body_length_));
+    }
+    return true;
+}
+
+/* 根据请求头决定请求体的格式 */
+bool HttpContext::start_body_()
+{
+    std::string_view transfer_encoding = request_.get_header(kHeaderTransferEncoding);
+    std::string_view content_length = request_.get_header(kHeaderContentLength);
+
+    /* get_header只返回第一个，代理可能以另一个为准：不同的Content-Length、重复的Transfer-Encoding、空的Content-Length都拒绝 */
+    bool has_content_length = false;
+    bool has_transfer_encoding = false;
+    for (size_t i = 0; i < request_.num_headers(); ++i)
+    {
+        const HttpRequest::Header& header = request_.headers()[i];
+        if (header.id == kHeaderContentLength)
+        {
+            if (header.value.empty() || (has_content_length && header.value != content_length))
+            {
+                return fail_(400);
+            }
+            has_content_length = true;
+        }
+        else if (header.id == kHeaderTransferEncoding)
+        {
+            if (has_transfer_encoding)
+            {
+                return fail_(400);
+            }
+            has_transfer_encoding = true;
+        }
+    }
+
+    if (has_transfer_encoding)
+    {
+        /* 同时带Content-Length的请求可能被用来走私请求，直接拒绝 */
+        if (!iequals(transfer_encoding, "chunked") || has_content_length)
+        {
+            return fail_(400);
+        }
+        state_ = kExpectChunkSize;
+    }
+    else if (has_content_length)
+    {
+        uint64_t length = 0;
+        for (char c : content_length)
+        {
+            if (c < '0' || c > '9' || length > (UINT64_MAX - 9) / 10)
+            {
+                return fail_(400);
+            }
+            length = length * 10 + static_cast<uint64_t>(c - '0');
+        }
+
+        if (length > max_body_size_)
+        {
+            if (!body_callback_ || !*body_callback_)
+            {
+                return fail_(413);
+            }
+            streaming_ = true;
+            request_.set_body_streamed(true);
+        }
+        remaining_ = length;
+        state_ = length > 0 ? kExpectBody : kGotAll;
+    }
+    else
+    {
+        state_ = kGotAll;
+    }
+
+    continue_pending_ = state_ != kGotAll && request_.version() == kHttp11
+        && iequals(request_.get_header(kHeaderExpect), "100-continue");
+    return true;
+}
+
+bool HttpContext::parse_body_(Buffer& buf)
+{
+    bool has_more = true;
+    while (has_more && state_ != kGotAll)
+    {
+        const char* data = buf.peek() + request_length_;
+        size_t available = buf.readable_bytes() - request_length_;
+
+        if (state_ == kExpectBody || state_ == kExpectChunkData)
+        {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(available, remaining_));
+            if (n == 0)
+            {
+                has_more = false;
+            }
+            else
+            {
+                if (!on_body_data_(buf, data, n))
+                {
+                    return false;
+                }
+                request_length_ += n;
+                remaining_ -= n;
+                if (remaining_ == 0)
+                {
+                    state_ = state_ == kExpectBody ? kGotAll : kExpectChunkCrlf;
+                }
+            }
+        }
+        else if (state_ == kExpectChunkSize)
+        {
+            const char* crlf = static_cast<const char*>(::memchr(data, '\n', available));
+            if (!crlf)
+            {
+                if (available > kMaxChunkLine)
+                {
+                    return fail_(400);
+                }
+                has_more = false;
+                continue;
+            }
+            if (crlf == data || crlf[-1] != '\r')
+            {
+                return fail_(400);
+            }
+
+            /* 分块大小是十六进制，后面可能有";ext"扩展，忽略 */
+            uint64_t size = 0;
+            const char* p = data;
+            for (; p < crlf - 1 && isxdigit(static_cast<unsigned char>(*p)); ++p)
+            {
+                if (size >> 60)
+                {
+                    return fail_(400);
+                }
+                int digit = *p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10;
+                size = size * 16 + static_cast<uint64_t>(digit);
+            }
+            if (p == data || (p < crlf - 1 && *p != ';' && *p != ' ' && *p != '\t'))
+            {
+                return fail_(400);
+            }
+
+            request_length_ += static_cast<size_t>(crlf + 1 - data);
+            remaining_ = size;
+            state_ = size > 0 ? kExpectChunkData : kExpectTrailers;
+        }
+        else if (state_ == kExpectChunkCrlf)
+        {
+            if (available < 2)
+            {
+                has_more = false;
+            }
+            else if (data[0] != '\r' || data[1] != '\n')
+            {
+                return fail_(400);
+            }
+            else
+            {
+                request_length_ += 2;
+                state_ = kExpectChunkSize;
+            }
+        }
+        else if (state_ == kExpectTrailers)
+        {
+            /* trailer字段不使用，只是跳过，直到空行 */
+            const char* crlf = static_cast<const char*>(::memchr(data, '\n', available));
+            size_t line = crlf ? static_cast<size_t>(crlf + 1 - data) : available;
+            if (trailers_length_ + line > kMaxTrailers)
+            {
+                return fail_(400);
+            }
+            if (!crlf)
+            {
+                has_more = false;
+                continue;
+            }
+            if (crlf == data || crlf[-1] != '\r')
+            {
+                return fail_(400);
+            }
+            request_length_ += line;
+            trailers_length_ += line;
+            if (line == 2)
+            {
+                state_ = kGotAll;
+            }
+        }
+    }
+
+    /* 流式接收时已经交给回调的数据（包括分块标记）立即从buf中删除，只保留请求头 */
+    if (streaming_ && request_length_ > head_length_)
+    {
+        buf.erase(head_length_, request_length_ - head_length_);
+        request_length_ = head_length_;
+    }
+    return true;
+}
+
+bool HttpContext::on_body_data_(Buffer& buf, const char* data, size_t len)
+{
+    if (!streaming_ && body_length_ + len > max_body_size_)
+    {
+        if (!body_callback_ || !*body_callback_)
+        {
+            return fail_(413);
+        }
+        /* chunked请求体超过上限，改为流式，已经缓冲的部分先交出去 */
+        streaming_ = true;
+        request_.set_body_streamed(true);
+        if (body_length_ > 0)
+        {
+            (*body_callback_)(request_, std::string_view(buf.peek() + head_length_, body_length_));
+            body_length_ = 0;
+        }
+    }
+
+    if (streaming_)
+    {
+        (*body_callback_)(request_, std::string_view(data, len));
+    }
+    else
+    {
+        /* 原地拼接：chunked的分块数据前移，覆盖掉前面的分块标记 */
+        char* dest = buf.peek() + head_length_ + body_length_;
+        if (dest != data)
+        {
+            ::memmove(dest, data, len);
+        }
+        body_length_ += len;
+    }
+    return true;
+}
+
+void HttpContext::finish_request(Buffer& buf)
+{
+    assert(state_ == kGotAll);
+    buf.retrieve(request_length_);
+    state_ = kExpectHeaders;
+    base_ = nullptr;
+    scanned_ = 0;
+    head_length_ = 0;
+    request_length_ = 0;
+    body_length_ = 0;
+    remaining_ = 0;
+    trailers_length_ = 0;
+    streaming_ = false;
+    continue_pending_ = false;
+    resumed_ = false;
+    resumed_response_.reset();
+    request_.reset();
+}
+
+// 解析请求行 "GET /AAA/BBB HTTP/1.1"
+bool HttpContext::process_request_line_(const char* begin, const char* end)
+{
+    bool succeed = false;
+    const char* start = begin;
+    const char* space = std::find(start, end, ' ');
+    if (space != end && request_.set_method(std::string_view(start, static_cast<size_t>(space - start))))
+    {
+        start = space + 1;
+        space = std::find(start, end, ' ');
+        if (space != end)
+        {
+            const char* question = std::find(start, space, '?');
+            request_.set_path(std::string_view(start, static_cast<size_t>(question - start)));
+            if (question != space)
+            {
+                request_.set_query(std::string_view(question, static_cast<size_t>(space - question)));
+            }
+
+            start = space + 1;
+            succeed = end - start == 8 && std::equal(start, end - 1, "HTTP/1.");
+            if (succeed)
+            {
+                if (*(end - 1) == '1')
+                {
+                    request_.set_version(kHttp11);
+                }
+                else if (*(end - 1) == '0')
+                {
+                    request_.set_version(kHttp10);
+                }
+                else
+                {
+                    succeed = false;
+                }
+            }
+        }
+    }
+    return succeed;
+}
+
+/* [begin, end)是若干个以CRLF结尾的"name: value"行 */
+bool HttpContext::process_headers_(const char* begin, const char* end)
+{
+    while (begin < end)
+    {
+        const char* crlf = static_cast<const char*>(::memchr(begin, '\r', static_cast<size_t>(end - begin)));
+        if (!crlf || crlf + 1 == end || crlf[1] != '\n')
+        {
+            return fail_(400);
+        }
+
+        const char* colon = std::find(begin, crlf, ':');
+        /* 名字不能为空，也不能包含空白 */
+        if (colon == crlf || colon == begin
+            || std::find_if(begin, colon, [](char c) { return c == ' ' || c == '\t'; }) != colon)
+        {
+            return fail_(400);
+        }
+
+        const char* value = colon + 1;
+        const char* value_end = crlf;
+        while (value < value_end && (*value == ' ' || *value == '\t'))
+        {
+            ++value;
+        }
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+        {
+            --value_end;
+        }
+
+        if (!request_.add_header(std::string_view(begin, static_cast<size_t>(colon - begin)),
+                std::string_view(value, static_cast<size_t>(value_end - value))))
+        {
+            return fail_(431);
+        }
+        begin = crlf + 2;
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "src/http/HttpRequest.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+class Buffer;
+
+/* 流式接收请求体时，每到达一段数据调用一次，data只在回调期间有效 */
+using http_body_callback = std::function<void(const HttpRequest&, std::string_view data)>;
+
+/**
+ *  每个连接一个的请求解析器
+ *
+ *  等到整个请求头（以空行结尾）都到达之后才一次性解析，解析出的HttpRequest直接指向buf中的数据，
+ *  所以请求处理完之前不能回收buf中的请求，处理完后调用finish_request
+ *  请求头不完整时记住已经查找过的位置，下次数据到来时不重复查找
+ *
+ *  请求体支持Content-Length和chunked，都是随数据到达增量解析：
+ *  不超过max_body_size的请求体在buf中原地拼接（chunked去掉分块标记），完整后通过request().body()交给http回调；
+ *  超过的请求体每到一段就交给body回调并从buf中删除，所以每个连接占用的内存与请求体大小无关；
+ *  没有设置body回调时，超过max_body_size的请求以413拒绝
+ *  请求行加请求头超过max_header_size字节或者超过HttpRequest::kMaxHeaders个时以431拒绝，
+ *  所以等待请求头期间buf的大小也是有上限的
+ */
+class HttpContext
+{
+public:
+    enum http_request_parse_state
+    {
+        kExpectHeaders,
+        kExpectBody,            /* Content-Length */
+        kExpectChunkSize,
+        kExpectChunkData,
+        kExpectChunkCrlf,
+        kExpectTrailers,
+        kGotAll,
+    };
+
+    HttpContext(size_t max_header_size, size_t max_body_size, const http_body_callback* body_callback);
+
+    bool gotall() const { return state_ == kGotAll; }
+    /* 请求头已经完整，正在等待请求体 */
+    bool expect_body() const { return state_ != kExpectHeaders && state_ != kGotAll; }
+
+    const HttpRequest& request() const { return request_; }
+    HttpRequest& request() { return request_; }
+
+    // return false if any error
+    bool parse_request(Buffer& buf, timer_clock::time_point receive_time);
+
+    /* parse_request失败时应该回复的状态码，400、413或431 */
+    int error_status() const { return error_status_; }
+
+    /* 请求头中有"Expect: 100-continue"并且还没有回复过100时返回true，只返回一次 */
+    bool take_continue()
+    {
+        bool pending = continue_pending_;
+        continue_pending_ = false;
+        return pending;
+    }
+
+    /* 当前请求处理完后调用，从buf中回收这个请求，request()中的string_view随之失效 */
+    void finish_request(Buffer& buf);
+
+    /**
+     *  当前请求在等待别的连接生成的响应：请求留在buf中，暂停处理这个连接后面的请求，
+     *  resume之后再次parse_request得到同一个请求，response为空表示需要自己生成响应
+     */
+    void pause() { paused_ = true; }
+    bool paused() const { return paused_; }
+    void resume(std::shared_ptr<const std::string> response)
+    {
+        paused_ = false;
+        resumed_ = true;
+        resumed_response_ = std::move(response);
+    }
+    bool resumed() const { return resumed_; }
+    const std::shared_ptr<const std::string>& resumed_response() const { return resumed_response_; }
+
+private:
+    bool process_request_line_(const char* begin, const char* end);
+    bool process_headers_(const char* begin, const char* end);
+    bool start_body_();
+    bool parse_body_(Buffer& buf);
+    bool on_body_data_(Buffer& buf, const char* data, size_t len);
+    bool fail_(int status)
+    {
+        error_status_ = status;
+        return false;
+    }
+
+private:
+    static const size_t kMaxChunkLine = 1024;
+    static const size_t kMaxTrailers = 8192;
+
+    size_t max_header_size_;
+    size_t max_body_size_;
+    const http_body_callback* body_callback_;
+    http_request_parse_state state_;
+    HttpRequest request_;
+    const char* base_;          /* 解析请求头时buf.peek()的位置，buf移动后据此调整request_ */
+    size_t scanned_;            /* buf中已经确认不含请求头结束标志的字节数 */
+    size_t head_length_;        /* 请求行和请求头占用的字节数，请求体紧接在后面 */
+    size_t request_length_;     /* 当前请求在buf中已经解析的字节数 */
+    size_t body_length_;        /* 已经在buf中拼接好的请求体长度 */
+    uint64_t remaining_;        /* 当前Content-Length或者分块还没到达的字节数 */
+    size_t trailers_length_;
+    bool streaming_;            /* 请求体交给body回调而不是缓冲 */
+    bool continue_pending_;
+    int error_status_;
+    bool paused_;
+    bool resumed_;
+    std::shared_ptr<const std::string> resumed_response_;
+};
@@ -0,0 +1,202 @@
+#include "src/http/HttpRequest.h"
+
+#include <string.h>
+#include <strings.h>
+#include <cassert>
+
+struct KnownHeader
+{
+    std::string_view name;
+    http_header_id id;
+};
+
+const KnownHeader kKnownHeaders[] = {
+    { "Host", kHeaderHost },
+    { "Connection", kHeaderConnection },
+    { "Content-Length", kHeaderContentLength },
+    { "Content-Type", kHeaderContentType },
+    { "Transfer-Encoding", kHeaderTransferEncoding },
+    { "Accept", kHeaderAccept },
+    { "Accept-Encoding", kHeaderAcceptEncoding },
+    { "Accept-Language", kHeaderAcceptLanguage },
+    { "User-Agent", kHeaderUserAgent },
+    { "Cookie", kHeaderCookie },
+    { "If-None-Match", kHeaderIfNoneMatch },
+    { "If-Modified-Since", kHeaderIfModifiedSince },
+    { "Range", kHeaderRange },
+    { "Upgrade", kHeaderUpgrade },
+    { "Expect", kHeaderExpect },
+};
+
+std::string_view version_string(http_version v)
+{
+    switch (v)
+    {
+    case kHttp10:
+        return "HTTP/1.0";
+    case kHttp11:
+        return "HTTP/1.1";
+    case kHttp2:
+        return "HTTP/2";
+    default:
+        return "UNKNOW";
+    }
+}
+
+bool iequals(std::string_view a, std::string_view b)
+{
+    return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+http_header_id intern_header(std::string_view name)
+{
+    for (const auto& known : kKnownHeaders)
+    {
+        if (iequals(known.name, name))
+        {
+            return known.id;
+        }
+    }
+    return kHeaderOther;
+}
+
+HttpRequest::HttpRequest()
+    : method_(kInvalid)
+    , version_(kUnknow)
+    , body_streamed_(false)
+    , num_headers_(0)
+    , num_params_(0)
+{
+    ::memset(known_, 0, sizeof(known_));
+}
+
+bool HttpRequest::set_method(std::string_view m)
+{
+    assert(method_ == kInvalid);
+    if (m == "GET") { method_ = kGet; }
+    else if (m == "POST") { method_ = kPost; }
+    else if (m == "HEAD") { method_ = kHead; }
+    else if (m == "PUT") { method_ = kPut; }
+    else if (m == "DELETE") { method_ = kDelete; }
+    else if (m == "OPTIONS") { method_ = kOptions; }
+    else if (m == "PATCH") { method_ = kPatch; }
+    else { method_ = kInvalid; }
+    return method_ != kInvalid;
+}
+
+std::string_view HttpRequest::method_string() const
+{
+    switch (method_)
+    {
+    case kGet:
+        return "GET";
+    case kPost:
+        return "POST";
+    case kHead:
+        return "HEAD";
+    case kPut:
+        return "PUT";
+    case kDelete:
+        return "DELETE";
+    case kOptions:
+        return "OPTIONS";
+    case kPatch:
+        return "PATCH";
+    default:
+        return "UNKNOW";
+    }
+}
+
+bool HttpRequest::add_header(std::string_view name, std::string_view value)
+{
+    if (num_headers_ == kMaxHeaders)
+    {
+        return false;
+    }
+
+    http_header_id id = intern_header(name);
+    headers_[num_headers_] = Header{name, value, id};
+    ++num_headers_;
+    /* 重复的请求头以第一个为准 */
+    if (id != kHeaderOther && known_[id] == 0)
+    {
+        known_[id] = static_cast<unsigned char>(num_headers_);
+    }
+    return true;
+}
+
+std::string_view HttpRequest::get_header(std::string_view name) const
+{
+    http_header_id id = intern_header(name);
+    if (id != kHeaderOther)
+    {
+        return get_header(id);
+    }
+
+    for (size_t i = 0; i < num_headers_; ++i)
+    {
+        if (iequals(headers_[i].name, name))
+        {
+            return headers_[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+void HttpRequest::rebase(const char* old_base, const char* new_base)
+{
+    auto move = [old_base, new_base](std::string_view& view) {
+        if (!view.empty())
+        {
+            view = std::string_view(new_base + (view.data() - old_base), view.size());
+        }
+    };
+    move(path_);
+    move(query_);
+    move(body_);
+    for (size_t i = 0; i < num_headers_; ++i)
+    {
+        move(headers_[i].name);
+        move(headers_[i].value);
+    }
+    /* 参数名指向路由表，不在缓冲区中 */
+    for (size_t i = 0; i < num_params_; ++i)
+    {
+        move(params_[i].value);
+    }
+}
+
+std::string_view HttpRequest::param(std::string_view name) const
+{
+    for (size_t i = 0; i < num_params_; ++i)
+    {
+        if (params_[i].name == name)
+        {
+            return params_[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpRequest::add_param(std::string_view name, std::string_view value)
+{
+    if (num_params_ == kMaxParams)
+    {
+        return false;
+    }
+    params_[num_params_++] = Param{name, value};
+    return true;
+}
+
+void HttpRequest::reset()
+{
+    method_ = kInvalid;
+    version_ = kUnknow;
+    path_ = std::string_view();
+    query_ = std::string_view();
+    body_ = std::string_view();
+    body_streamed_ = false;
+    num_headers_ = 0;
+    num_params_ = 0;
+    ::memset(known_, 0, sizeof(known_));
+}
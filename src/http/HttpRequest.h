@@ -0,0 +1,137 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <string_view>
+
+enum http_version
+{
+    kUnknow, kHttp10, kHttp11, kHttp2
+};
+
+std::string_view version_string(http_version v);
+
+/* 常用的请求头预先编号，解析时查表一次，之后按编号O(1)查找 */
+enum http_header_id
+{
+    kHeaderOther,
+    kHeaderHost,
+    kHeaderConnection,
+    kHeaderContentLength,
+    kHeaderContentType,
+    kHeaderTransferEncoding,
+    kHeaderAccept,
+    kHeaderAcceptEncoding,
+    kHeaderAcceptLanguage,
+    kHeaderUserAgent,
+    kHeaderCookie,
+    kHeaderIfNoneMatch,
+    kHeaderIfModifiedSince,
+    kHeaderRange,
+    kHeaderUpgrade,
+    kHeaderExpect,
+    kNumKnownHeaders
+};
+
+/* 不区分大小写的查找，不是常用请求头时返回kHeaderOther */
+http_header_id intern_header(std::string_view name);
+
+/* 不区分大小写比较，HTTP的请求头名字和Connection等的值都不区分大小写 */
+bool iequals(std::string_view a, std::string_view b);
+
+/**
+ *  请求行和请求头都是指向连接输入缓冲区的string_view，不拷贝
+ *  只在http回调返回之前有效，需要保存时自行拷贝成std::string
+ *
+ *  请求头存放在定长数组中，解析一个普通的GET请求不需要分配内存
+ */
+class HttpRequest
+{
+public:
+    enum http_method
+    {
+        kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch
+    };
+
+    struct Header
+    {
+        std::string_view name;
+        std::string_view value;
+        http_header_id id;
+    };
+
+    /* HttpRouter从路径中提取的参数，name指向路由表，value指向请求路径 */
+    struct Param
+    {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    static const size_t kMaxHeaders = 32;
+    static const size_t kMaxParams = 8;
+
+    HttpRequest();
+
+    void set_version(http_version v) { version_ = v; }
+    http_version version() const { return version_; }
+
+    http_method method() const { return method_; }
+    bool set_method(std::string_view m);
+    std::string_view method_string() const;
+
+    void set_path(std::string_view path) { path_ = path; }
+    std::string_view path() const { return path_; }
+
+    /* 包括开头的'?' */
+    void set_query(std::string_view query) { query_ = query; }
+    std::string_view query() const { return query_; }
+
+    void set_receive_time(timer_clock::time_point tp) { receive_time_ = tp; }
+    timer_clock::time_point receive_time() const { return receive_time_; }
+
+    /* 请求头超过kMaxHeaders时返回false */
+    bool add_header(std::string_view name, std::string_view value);
+
+    /* 不存在时返回空 */
+    std::string_view get_header(http_header_id id) const
+    {
+        return known_[id] ? headers_[known_[id] - 1].value : std::string_view();
+    }
+    std::string_view get_header(std::string_view name) const;
+
+    const Header* headers() const { return headers_; }
+    size_t num_headers() const { return num_headers_; }
+
+    /* 路由模式中":name"或"*name"匹配到的部分，不存在时返回空 */
+    std::string_view param(std::string_view name) const;
+    const Param* params() const { return params_; }
+    size_t num_params() const { return num_params_; }
+    /* 超过kMaxParams时返回false */
+    bool add_param(std::string_view name, std::string_view value);
+    void truncate_params(size_t n) { num_params_ = n < num_params_ ? n : num_params_; }
+
+    /* 完整的请求体；请求体是流式交给body回调的时候为空 */
+    void set_body(std::string_view body) { body_ = body; }
+    std::string_view body() const { return body_; }
+    void set_body_streamed(bool on) { body_streamed_ = on; }
+    bool body_streamed() const { return body_streamed_; }
+
+    /* 缓冲区移动之后，让所有string_view指向新位置中的同一数据 */
+    void rebase(const char* old_base, const char* new_base);
+
+    void reset();
+
+private:
+    http_method method_;
+    http_version version_;
+    std::string_view path_;
+    std::string_view query_;
+    timer_clock::time_point receive_time_;
+    std::string_view body_;
+    bool body_streamed_;
+    size_t num_headers_;
+    Header headers_[kMaxHeaders];
+    size_t num_params_;
+    Param params_[kMaxParams];
+    unsigned char known_[kNumKnownHeaders];     /* 常用请求头在headers_中的下标+1，0表示没有 */
+};
@@ -0,0 +1,186 @@
+#include "src/http/HttpResponse.h"
+#include "src/Buffer.h"
+
+#include <string.h>
+#include <time.h>
+
+struct StatusReason
+{
+    int code;
+    std::string_view phrase;
+};
+
+const StatusReason kStatusReasons[] = {
+    { 100, "Continue" },
+    { 101, "Switching Protocols" },
+    { 200, "OK" },
+    { 201, "Created" },
+    { 204, "No Content" },
+    { 206, "Partial Content" },
+    { 301, "Moved Permanently" },
+    { 302, "Found" },
+    { 304, "Not Modified" },
+    { 400, "Bad Request" },
+    { 403, "Forbidden" },
+    { 404, "Not Found" },
+    { 405, "Method Not Allowed" },
+    { 408, "Request Timeout" },
+    { 413, "Payload Too Large" },
+    { 416, "Range Not Satisfiable" },
+    { 431, "Request Header Fields Too Large" },
+    { 500, "Internal Server Error" },
+    { 501, "Not Implemented" },
+    { 503, "Service Unavailable" },
+};
+
+const size_t kNumStatus = sizeof(kStatusReasons) / sizeof(kStatusReasons[0]);
+
+/* 状态码在100~599之间，按状态码直接索引 */
+struct StatusLines
+{
+    std::string lines[2][500];  /* [0]是HTTP/1.0，[1]是HTTP/1.1 */
+
+    StatusLines()
+    {
+        for (const auto& status : kStatusReasons)
+        {
+            std::string code = std::to_string(status.code);
+            lines[0][status.code - 100] = "HTTP/1.0 " + code + " " + std::string(status.phrase) + "\r\n";
+            lines[1][status.code - 100] = "HTTP/1.1 " + code + " " + std::string(status.phrase) + "\r\n";
+        }
+    }
+};
+
+const StatusLines kStatusLines;
+
+struct DateHeader
+{
+    char data[96];
+    size_t length = 0;
+};
+
+thread_local DateHeader t_date_header;
+
+std::string_view http_reason_phrase(int code)
+{
+    for (size_t i = 0; i < kNumStatus; ++i)
+    {
+        if (kStatusReasons[i].code == code)
+        {
+            return kStatusReasons[i].phrase;
+        }
+    }
+    return std::string_view();
+}
+
+std::string_view http_status_line(http_version version, int code)
+{
+    if (code < 100 || code > 599)
+    {
+        return std::string_view();
+    }
+    return kStatusLines.lines[version == kHttp10 ? 0 : 1][code - 100];
+}
+
+std::string_view http_date_header()
+{
+    if (t_date_header.length == 0)
+    {
+        refresh_date_header();
+    }
+    return std::string_view(t_date_header.data, t_date_header.length);
+}
+
+void refresh_date_header()
+{
+    time_t now = ::time(nullptr);
+    struct tm tm;
+    ::gmtime_r(&now, &tm);
+    t_date_header.length = ::strftime(t_date_header.data, sizeof(t_date_header.data),
+        "Date: %a, %d %b %Y %H:%M:%S GMT\r\nServer: mini-muduo\r\n", &tm);
+}
+
+/* 把n格式化到buf的末尾，返回第一个字符的位置 */
+char* format_uint(char* end, size_t n)
+{
+    do
+    {
+        *--end = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n);
+    return end;
+}
+
+void HttpResponse::reset(bool close)
+{
+    version_ = http_version::kUnknow;
+    status_code_ = kUnknow;
+    status_message_.clear();
+    close_connection_ = close;
+    body_.clear();
+    headers_.clear();
+    holder_.reset();
+    body_ref_ = std::string_view();
+    file_fd_ = -1;
+    file_offset_ = 0;
+    file_length_ = 0;
+}
+
+void HttpResponse::add_header(std::string_view key, std::string_view value)
+{
+    headers_.append(key);
+    headers_.append(": ");
+    headers_.append(value);
+    headers_.append("\r\n");
+}
+
+void HttpResponse::append_buffer(Buffer& output, bool with_body) const
+{
+    std::string_view line = http_status_line(version_, status_code_);
+    if (!line.empty() && (status_message_.empty() || status_message_ == http_reason_phrase(status_code_)))
+    {
+        output.append(line);
+    }
+    else
+    {
+        char code[16];
+        char* code_end = code + sizeof(code);
+        output.append(version_string(version_ == http_version::kUnknow ? kHttp11 : version_));
+        output.append(" ");
+        char* start = format_uint(code_end, static_cast<size_t>(status_code_));
+        output.append(start, static_cast<size_t>(code_end - start));
+        output.append(" ");
+        output.append(status_message_);
+        output.append("\r\n");
+    }
+
+    output.append(http_date_header());
+
+    /* 304没有响应体，也不能带Content-Length: 0 */
+    if (status_code_ != k304NotModified)
+    {
+        char length[24];
+        char* length_end = length + sizeof(length);
+        size_t body_length = has_file_body() ? file_length_ : (body_ref_.data() ? body_ref_.size() : body_.size());
+        char* digits = format_uint(length_end, body_length);
+        output.append("Content-Length: ");
+        output.append(digits, static_cast<size_t>(length_end - digits));
+        output.append("\r\n");
+    }
+
+    if (close_connection_)
+    {
+        output.append("Connection: close\r\n");
+    }
+    else
+    {
+        output.append("Connection: Keep-Alive\r\n");
+    }
+
+    output.append(headers_);
+    output.append("\r\n");
+    if (with_body && !has_file_body())
+    {
+        output.append(body_ref_.data() ? body_ref_ : std::string_view(body_));
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "src/http/HttpRequest.h"
+
+#include <string>
+#include <memory>
+#include <sys/types.h>
+
+class Buffer;
+
+/**
+ *  HttpServer为每个IO线程复用同一个HttpResponse，所有成员在reset时只清空不释放，
+ *  所以除了body本身，生成响应不需要分配内存
+ */
+class HttpResponse
+{
+public:
+    enum http_status_code
+    {
+        kUnknow,
+        k200Ok = 200,
+        k206PartialContent = 206,
+        k201MovedPerrmanently = 301,
+        k304NotModified = 304,
+        k200BadRequest = 400,
+        k404NotFound = 404,
+        k405MethodNotAllowed = 405,
+        k413PayloadTooLarge = 413,
+        k416RangeNotSatisfiable = 416
+    };
+    
+    explicit HttpResponse(bool close)
+        : version_(http_version::kUnknow)
+        , status_code_(kUnknow)
+        , close_connection_(close)
+    {}
+
+    /* 为下一个请求复用 */
+    void reset(bool close);
+
+    void set_status_code(http_status_code code) { status_code_ = code; }
+    http_status_code status_code() const { return status_code_; }
+
+    void set_version(http_version v) { version_ = v; }
+    http_version version() const { return version_; }
+
+    /* 不设置时使用状态码的标准描述 */
+    void set_status_message(std::string_view message) { status_message_.assign(message); }
+    const std::string& status_message() const { return status_message_; }
+
+    void set_close_connection(bool on) { close_connection_ = on; }
+    bool close_connection() const { return close_connection_; }
+
+    void set_content_type(std::string_view content_type)
+    {
+        add_header("Content-Type", content_type);
+    }
+
+    /* Date、Server、Content-Length和Connection由HttpServer生成，不需要添加 */
+    void add_header(std::string_view key, std::string_view value);
+
+    void set_body(std::string body)
+    {
+        body_ = std::move(body);
+    }
+
+    void set_body(std::string_view body)
+    {
+        body_.assign(body);
+    }
+
+    void set_body(const char* body)
+    {
+        body_.assign(body);
+    }
+
+    /* 响应体直接引用body指向的数据，holder保证数据在序列化之前有效 */
+    void set_body_ref(std::shared_ptr<const void> holder, std::string_view body)
+    {
+        holder_ = std::move(holder);
+        body_ref_ = body;
+    }
+
+    /* 响应体是文件fd中从offset开始的length个字节，由HttpServer用sendfile发送 */
+    void set_file_body(std::shared_ptr<const void> holder, int fd, off_t offset, size_t length)
+    {
+        holder_ = std::move(holder);
+        file_fd_ = fd;
+        file_offset_ = offset;
+        file_length_ = length;
+    }
+
+    bool has_file_body() const { return file_fd_ >= 0; }
+    int file_fd() const { return file_fd_; }
+    off_t file_offset() const { return file_offset_; }
+    size_t file_length() const { return file_length_; }
+    const std::shared_ptr<const void>& holder() const { return holder_; }
+
+    /* HTTP/2用：add_header添加的"key: value\r\n"和内存中的响应体 */
+    std::string_view headers() const { return headers_; }
+    std::string_view body() const { return body_ref_.data() ? body_ref_ : std::string_view(body_); }
+    /* 取走set_body设置的响应体，不拷贝 */
+    std::string take_body() { return std::move(body_); }
+
+    /* 序列化状态行、响应头和内存中的响应体；文件响应体或者with_body为false（HEAD）时只有响应头 */
+    void append_buffer(Buffer& output, bool with_body = true) const;
+
+private:
+    http_version version_;
+    http_status_code status_code_;
+    std::string status_message_;
+    bool close_connection_;
+    std::string body_;
+    std::string headers_;   /* 已经格式化好的"key: value\r\n" */
+    std::shared_ptr<const void> holder_;
+    std::string_view body_ref_;
+    int file_fd_ = -1;
+    off_t file_offset_ = 0;
+    size_t file_length_ = 0;
+};
+
+/* 预先生成的状态行"HTTP/1.1 200 OK\r\n"，未知状态码返回空 */
+std::string_view http_status_line(http_version version, int code);
+
+/* 状态码的标准描述，未知状态码返回空 */
+std::string_view http_reason_phrase(int code);
+
+/**
+ *  当前线程缓存的"Date: ...\r\nServer: ...\r\n"，每个IO线程一份
+ *  HttpServer在每个IO线程中每秒调用一次refresh_date_header
+ */
+std::string_view http_date_header();
+void refresh_date_header();
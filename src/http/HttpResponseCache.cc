@@ -0,0 +1,112 @@
+#include "src/http/HttpResponseCache.h"
+#include "src/EventLoop.h"
+#include "src/TcpConnection.h"
+
+HttpResponseCache::HttpResponseCache(size_t max_entries, size_t max_entries_per_route)
+    : max_entries_(max_entries)
+    , max_entries_per_route_(max_entries_per_route)
+{}
+
+HttpResponseCache::lookup_result HttpResponseCache::lookup(const std::string& key, timer_clock::time_point now,
+    response_ptr* response, EventLoop* loop, const std::shared_ptr<TcpConnection>& conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        route_key_.assign(key, 0, key.find('?'));
+        lru_list& route = routes_[route_key_];
+        bool full = route.size() >= max_entries_per_route_ ? !evict_(route)
+            : entries_.size() >= max_entries_ && !evict_(lru_);
+        if (full)
+        {
+            /* 能淘汰的都在生成中，这个请求不经过缓存 */
+            return kMiss;
+        }
+        it = entries_.emplace(key, Entry{nullptr, now, true, {}, nullptr, &route, {}, {}}).first;
+        Entry& entry = it->second;
+        entry.key = &it->first;
+        entry.lru = lru_.insert(lru_.begin(), &entry);
+        entry.route_lru = route.insert(route.begin(), &entry);
+        return kMiss;
+    }
+
+    Entry& entry = it->second;
+    touch_(entry);
+    if (entry.response && (now < entry.expires || entry.filling))
+    {
+        *response = entry.response;
+        return kHit;
+    }
+    if (entry.filling)
+    {
+        entry.waiters.push_back(Waiter{loop, conn});
+        return kWait;
+    }
+    entry.filling = true;
+    return kMiss;
+}
+
+void HttpResponseCache::fill(const std::string& key, response_ptr response, timer_clock::time_point expires)
+{
+    std::vector<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            return;
+        }
+        waiters.swap(it->second.waiters);
+        if (response)
+        {
+            it->second.response = response;
+            it->second.expires = expires;
+            it->second.filling = false;
+        }
+        else
+        {
+            erase_(it->second);
+        }
+    }
+
+    for (Waiter& waiter : waiters)
+    {
+        waiter.loop->queue_in_loop([this, conn = std::move(waiter.conn), response] {
+            if (std::shared_ptr<TcpConnection> c = conn.lock())
+            {
+                ready_callback_(c, response);
+            }
+        });
+    }
+}
+
+void HttpResponseCache::touch_(Entry& entry)
+{
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+    entry.route->splice(entry.route->begin(), *entry.route, entry.route_lru);
+}
+
+/* 从list最久没用的一端淘汰一个不在生成中的响应，最多检查kEvictBatch个 */
+bool HttpResponseCache::evict_(lru_list& list)
+{
+    auto it = list.end();
+    for (size_t i = 0; i < kEvictBatch && it != list.begin(); ++i)
+    {
+        --it;
+        if (!(*it)->filling)
+        {
+            erase_(**it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpResponseCache::erase_(Entry& entry)
+{
+    lru_.erase(entry.lru);
+    entry.route->erase(entry.route_lru);
+    /* key就在要删除的节点中，先找到迭代器再删除 */
+    entries_.erase(entries_.find(*entry.key));
+}
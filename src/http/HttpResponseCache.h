@@ -0,0 +1,90 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ *  HttpServer的响应微缓存，可以被多个IO线程共享
+ *
+ *  以"method path?query"为key，保存序列化好的完整响应，缓存后只读，命中时各连接共享同一份数据；
+ *  同一key缓存缺失时只有第一个请求去调用http回调生成响应，其他同时到达的请求登记为等待者，
+ *  响应生成后通过各自连接的EventLoop唤醒；过期的响应在重新生成期间继续提供给其他请求
+ *
+ *  满了之后按LRU淘汰（不淘汰正在生成的），每次最多检查kEvictBatch个，开销是常数；
+ *  同一路由（key中'?'之前的部分）最多max_entries_per_route个，只变query的请求只会挤掉同一路由的响应
+ */
+class HttpResponseCache
+{
+public:
+    using response_ptr = std::shared_ptr<const std::string>;
+    /* 在等待者连接所属的IO线程中调用，response为空表示这次的响应不能缓存，需要自己调用http回调 */
+    using ready_callback = std::function<void(const std::shared_ptr<TcpConnection>&, const response_ptr&)>;
+
+    enum lookup_result
+    {
+        kHit,       /* *response是缓存的响应 */
+        kMiss,      /* 调用者负责生成响应，之后必须调用fill */
+        kWait,      /* 同一key的响应正在生成，完成后调用ready回调 */
+    };
+
+    explicit HttpResponseCache(size_t max_entries = 4096, size_t max_entries_per_route = 1024);
+
+    HttpResponseCache(const HttpResponseCache&) = delete;
+    HttpResponseCache& operator=(const HttpResponseCache&) = delete;
+
+    void set_ready_callback(const ready_callback& cb) { ready_callback_ = cb; }
+
+    lookup_result lookup(const std::string& key, timer_clock::time_point now, response_ptr* response,
+        EventLoop* loop, const std::shared_ptr<TcpConnection>& conn);
+
+    /* lookup返回kMiss之后调用，response为空表示不缓存，等待者各自重新处理请求 */
+    void fill(const std::string& key, response_ptr response, timer_clock::time_point expires);
+
+private:
+    struct Waiter
+    {
+        EventLoop* loop;
+        std::weak_ptr<TcpConnection> conn;
+    };
+
+    struct Entry;
+    using lru_list = std::list<Entry*>;     /* 最近使用的在前面 */
+
+    struct Entry
+    {
+        response_ptr response;              /* 为空表示第一次生成还没有完成 */
+        timer_clock::time_point expires;
+        bool filling;
+        std::vector<Waiter> waiters;
+        const std::string* key;             /* entries_中的key */
+        lru_list* route;                    /* 所属路由的LRU链表 */
+        lru_list::iterator lru;             /* 在lru_中的位置 */
+        lru_list::iterator route_lru;       /* 在*route中的位置 */
+    };
+
+    void touch_(Entry& entry);
+    bool evict_(lru_list& list);
+    void erase_(Entry& entry);
+
+private:
+    static const size_t kEvictBatch = 4;
+
+    size_t max_entries_;
+    size_t max_entries_per_route_;
+    ready_callback ready_callback_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    lru_list lru_;
+    std::unordered_map<std::string, lru_list> routes_;
+    std::string route_key_;                 /* 复用的路由名缓冲区 */
+};
@@ -0,0 +1,263 @@
+#include "src/http/HttpRouter.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+/**
+ *  基数树的节点：prefix是这个节点匹配的静态部分，
+ *  静态子节点的prefix首字符各不相同，记在indices中，查找子节点只比较一个字符
+ *  ":name"和"*name"各自是一个prefix为空的子节点，参数值匹配完之后从参数节点继续向下匹配
+ */
+struct HttpRouter::Node
+{
+    std::string prefix;
+    std::string indices;
+    std::vector<std::unique_ptr<Node>> children;
+    std::string param_name;
+    std::unique_ptr<Node> param_child;
+    std::string wildcard_name;
+    std::unique_ptr<Node> wildcard_child;
+    const Route* route = nullptr;
+};
+
+/* 与HttpRequest::http_method的顺序一致 */
+const char* const kMethodNames[] = { "", "GET", "POST", "HEAD", "PUT", "DELETE", "OPTIONS", "PATCH" };
+
+HttpRouter::HttpRouter()
+    : compiled_(false)
+    , root_(std::make_unique<Node>())
+{}
+
+HttpRouter::~HttpRouter() = default;
+
+void HttpRouter::add(HttpRequest::http_method method, std::string pattern, handler h)
+{
+    assert(!compiled_);
+    assert(method != HttpRequest::kInvalid);
+    for (std::unique_ptr<Route>& route : routes_)
+    {
+        if (route->pattern == pattern)
+        {
+            if (route->handlers[method])
+            {
+                invalid_pattern_(route.get(), "duplicate route");
+            }
+            route->handlers[method] = std::move(h);
+            return;
+        }
+    }
+    routes_.push_back(std::make_unique<Route>());
+    routes_.back()->pattern = std::move(pattern);
+    routes_.back()->handlers[method] = std::move(h);
+}
+
+void HttpRouter::compile()
+{
+    static_assert(sizeof(kMethodNames) / sizeof(kMethodNames[0]) == kNumMethods, "kMethodNames");
+    assert(!compiled_);
+    compiled_ = true;
+    for (std::unique_ptr<Route>& route : routes_)
+    {
+        const std::string& pattern = route->pattern;
+        if (pattern.empty() || pattern[0] != '/')
+        {
+            invalid_pattern_(route.get(), "must start with '/'");
+        }
+
+        for (size_t m = 1; m < kNumMethods; ++m)
+        {
+            if (route->handlers[m] || (m == HttpRequest::kHead && route->handlers[HttpRequest::kGet]))
+            {
+                if (!route->allow.empty())
+                {
+                    route->allow.append(", ");
+                }
+                route->allow.append(kMethodNames[m]);
+            }
+        }
+
+        if (pattern.find_first_of(":*") == std::string::npos)
+        {
+            exact_.emplace(pattern, route.get());
+        }
+        else
+        {
+            insert_(root_.get(), pattern, route.get(), 0);
+        }
+    }
+}
+
+/* 把pattern插入到node下面，调用时pattern应该从node->prefix开始 */
+void HttpRouter::insert_(Node* node, std::string_view pattern, Route* route, size_t num_params)
+{
+    size_t static_length = std::min(pattern.find_first_of(":*"), pattern.size());
+    size_t common = 0;
+    while (common < node->prefix.size() && common < static_length && node->prefix[common] == pattern[common])
+    {
+        ++common;
+    }
+
+    /* 只有一部分prefix相同，把节点拆成两段 */
+    if (common < node->prefix.size())
+    {
+        auto child = std::make_unique<Node>();
+        child->prefix = node->prefix.substr(common);
+        child->indices.swap(node->indices);
+        child->children.swap(node->children);
+        child->param_name.swap(node->param_name);
+        child->param_child.swap(node->param_child);
+        child->wildcard_name.swap(node->wildcard_name);
+        child->wildcard_child.swap(node->wildcard_child);
+        child->route = node->route;
+        node->prefix.resize(common);
+        node->indices.assign(1, child->prefix[0]);
+        node->children.push_back(std::move(child));
+        node->route = nullptr;
+    }
+    pattern.remove_prefix(common);
+
+    if (pattern.empty())
+    {
+        if (node->route)
+        {
+            invalid_pattern_(route, "conflicts with another route");
+        }
+        node->route = route;
+        return;
+    }
+
+    if (pattern[0] == ':' || pattern[0] == '*')
+    {
+        size_t end = pattern[0] == ':' ? std::min(pattern.find('/'), pattern.size()) : pattern.size();
+        std::string_view name = pattern.substr(1, end - 1);
+        if (name.empty() || name.find_first_of(":*") != std::string_view::npos)
+        {
+            invalid_pattern_(route, "bad parameter name");
+        }
+        if (node->prefix.empty() || node->prefix.back() != '/')
+        {
+            invalid_pattern_(route, "parameter must follow '/'");
+        }
+        if (++num_params > HttpRequest::kMaxParams)
+        {
+            invalid_pattern_(route, "too many parameters");
+        }
+
+        std::string& node_name = pattern[0] == ':' ? node->param_name : node->wildcard_name;
+        std::unique_ptr<Node>& child = pattern[0] == ':' ? node->param_child : node->wildcard_child;
+        if (!child)
+        {
+            child = std::make_unique<Node>();
+            node_name.assign(name);
+        }
+        else if (node_name != name)
+        {
+            invalid_pattern_(route, "parameter name differs from another route at the same position");
+        }
+        insert_(child.get(), pattern.substr(end), route, num_params);
+        return;
+    }
+
+    size_t i = node->indices.find(pattern[0]);
+    if (i == std::string::npos)
+    {
+        i = node->children.size();
+        node->indices.push_back(pattern[0]);
+        node->children.push_back(std::make_unique<Node>());
+        node->children.back()->prefix.assign(pattern.substr(0, static_length - common));
+    }
+    insert_(node->children[i].get(), pattern, route, num_params);
+}
+
+/* 静态子节点优先，失败时回退到参数和通配符，回退时撤销已经记录的参数 */
+const HttpRouter::Route* HttpRouter::match_(const Node* node, std::string_view path, HttpRequest& req) const
+{
+    if (path.compare(0, node->prefix.size(), node->prefix) != 0)
+    {
+        return nullptr;
+    }
+    path.remove_prefix(node->prefix.size());
+
+    if (path.empty())
+    {
+        if (node->route)
+        {
+            return node->route;
+        }
+    }
+    else
+    {
+        size_t i = node->indices.find(path[0]);
+        if (i != std::string::npos)
+        {
+            if (const Route* route = match_(node->children[i].get(), path, req))
+            {
+                return route;
+            }
+        }
+
+        if (node->param_child)
+        {
+            size_t end = std::min(path.find('/'), path.size());
+            size_t mark = req.num_params();
+            if (end > 0 && req.add_param(node->param_name, path.substr(0, end)))
+            {
+                if (const Route* route = match_(node->param_child.get(), path.substr(end), req))
+                {
+                    return route;
+                }
+                req.truncate_params(mark);
+            }
+        }
+    }
+
+    if (node->wildcard_child && node->wildcard_child->route && req.add_param(node->wildcard_name, path))
+    {
+        return node->wildcard_child->route;
+    }
+    return nullptr;
+}
+
+bool HttpRouter::dispatch(HttpRequest& req, HttpResponse& resp) const
+{
+    assert(compiled_);
+    req.truncate_params(0);
+    const Route* route = nullptr;
+    auto it = exact_.find(req.path());
+    if (it != exact_.end())
+    {
+        route = it->second;
+    }
+    else
+    {
+        route = match_(root_.get(), req.path(), req);
+    }
+    if (!route)
+    {
+        return false;
+    }
+
+    const handler* h = &route->handlers[req.method()];
+    if (!*h && req.method() == HttpRequest::kHead)
+    {
+        h = &route->handlers[HttpRequest::kGet];
+    }
+    if (*h)
+    {
+        (*h)(req, resp);
+    }
+    else
+    {
+        resp.set_status_code(HttpResponse::k405MethodNotAllowed);
+        resp.add_header("Allow", route->allow);
+    }
+    return true;
+}
+
+void HttpRouter::invalid_pattern_(const Route* route, const char* reason) const
+{
+    printf("HttpRouter: invalid route %s: %s\n", route->pattern.c_str(), reason);
+    exit(EXIT_FAILURE);
+}
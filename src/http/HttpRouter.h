@@ -0,0 +1,76 @@
+#pragma once
+
+#include "src/http/HttpRequest.h"
+#include "src/http/HttpResponse.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ *  按方法和路径模式分发请求
+ *
+ *  模式以'/'开头，":name"匹配一个非空的路径段，"*name"匹配剩下的全部路径（只能出现在最后），
+ *  匹配到的部分通过HttpRequest::param(name)取得，是指向请求路径的string_view，不分配内存
+ *
+ *  add只记录路由，compile时一次性建好：不含参数的路由放进哈希表，精确匹配一次查表；
+ *  其他路由编译成基数树，按公共前缀逐段比较，与路由数量无关；
+ *  同一位置上静态路径优先于":name"，":name"优先于"*name"
+ *
+ *  @code
+ *  server.router().add(HttpRequest::kGet, "/users/:id", [](const HttpRequest& req, HttpResponse& resp) {
+ *      std::string_view id = req.param("id");
+ *      ...
+ *  });
+ *  @endcode
+ */
+class HttpRouter
+{
+public:
+    using handler = std::function<void(const HttpRequest&, HttpResponse&)>;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    HttpRouter(const HttpRouter&) = delete;
+    HttpRouter& operator=(const HttpRouter&) = delete;
+
+    /* 必须在compile之前调用，模式不合法或者与已有路由冲突时退出程序 */
+    void add(HttpRequest::http_method method, std::string pattern, handler h);
+
+    void compile();
+    bool compiled() const { return compiled_; }
+    bool empty() const { return routes_.empty(); }
+
+    /**
+     *  找到路由时填好req的参数并调用handler，HEAD没有单独的路由时使用GET的；
+     *  路径匹配但方法不匹配时回复405；路径不匹配时返回false，不修改resp
+     */
+    bool dispatch(HttpRequest& req, HttpResponse& resp) const;
+
+private:
+    static const size_t kNumMethods = HttpRequest::kPatch + 1;
+
+    /* 一个模式上各个方法的handler */
+    struct Route
+    {
+        std::string pattern;
+        handler handlers[kNumMethods];
+        std::string allow;      /* 405响应的Allow头 */
+    };
+
+    struct Node;
+
+    void insert_(Node* node, std::string_view pattern, Route* route, size_t num_params);
+    const Route* match_(const Node* node, std::string_view path, HttpRequest& req) const;
+    void invalid_pattern_(const Route* route, const char* reason) const;
+
+private:
+    bool compiled_;
+    std::vector<std::unique_ptr<Route>> routes_;
+    std::unordered_map<std::string_view, const Route*> exact_;     /* 键指向Route::pattern */
+    std::unique_ptr<Node> root_;
+};
@@ -0,0 +1,597 @@
+#include "src/http/HttpServer.h"
+#include "src/TcpConnection.h"
+#include "src/Buffer.h"
+#include "src/EventLoop.h"
+#include "src/EventLoopThreadPool.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+using namespace std::placeholders;
+
+void default_http_callback(const HttpRequest&, HttpResponse& resp)
+{
+    resp.set_version(kHttp11);
+    resp.set_status_code(HttpResponse::k404NotFound);
+    resp.set_status_message("Not Found");
+    resp.set_close_connection(true);
+}
+
+/* 连接当前等待的超时 */
+enum session_phase
+{
+    kNoTimeout,         /* 在等待其他连接生成缓存的响应 */
+    kIdle,              /* 两个请求之间 */
+    kReadingHeaders,
+    kReadingBody,
+    kBlocked,           /* 响应积压，等待对方读走 */
+    kClosing,           /* 已经shutdown，等待对方关闭 */
+};
+
+/* 每个连接的状态，保存在TcpConnection的context中 */
+struct HttpServer::Session
+{
+    HttpContext context;
+    TimerWheel* wheel;
+    TimerWheel::Node timeout;
+    session_phase phase;
+    bool throttled;     /* 输出积压，已经暂停读取和处理请求 */
+    std::shared_ptr<WebSocket> websocket;   /* 升级为WebSocket之后不再为空 */
+    std::shared_ptr<Http2Connection> http2; /* 切换到HTTP/2之后不再为空 */
+    bool preface_possible;                  /* 开启了h2c，收到的数据到目前为止都是HTTP/2 preface的前缀 */
+};
+
+/* 输出缓冲区积压超过这么多时，暂停处理后面的请求 */
+const size_t kMaxPendingOutput = 256 * 1024;
+
+HttpServer::HttpServer(EventLoop* loop, std::string ip, uint16_t port)
+    : server_(loop, std::move(ip), port)
+    , http_callback_(default_http_callback)
+    , max_body_size_(kDefaultMaxBodySize)
+    , max_header_size_(kDefaultMaxHeaderSize)
+    , keep_alive_timeout_(std::chrono::seconds(60))
+    , header_timeout_(std::chrono::seconds(10))
+    , body_timeout_(std::chrono::seconds(30))
+    , h2c_(false)
+{
+    http2_dispatch_ = [this](HttpRequest& req, HttpResponse& resp) {
+        if (!router_.compiled() || !router_.dispatch(req, resp))
+        {
+            http_callback_(req, resp);
+        }
+    };
+    server_.set_connection_callback(std::bind(&HttpServer::on_connection, this, _1));
+    server_.set_message_callback(std::bind(&HttpServer::on_message, this, _1, _2));
+    server_.set_write_complete_callback(std::bind(&HttpServer::on_write_complete, this, _1));
+    cache_.set_ready_callback(std::bind(&HttpServer::on_cache_ready, this, _1, _2));
+}
+
+HttpServer::~HttpServer()
+{
+    /* 连接断开的回调要用到缓存等成员，必须在它们析构之前关闭连接 */
+    server_.force_close_all();
+}
+
+void HttpServer::start()
+{
+    if (!router_.empty())
+    {
+        router_.compile();
+    }
+    /* 时间轮的精度是最短超时的1/8 */
+    server_.set_wheel_tick(std::min({keep_alive_timeout_, header_timeout_, body_timeout_}) / 8);
+    server_.start();
+
+    for (EventLoop* loop : server_.thread_pool()->get_all_loops())
+    {
+        /* 每个IO线程每秒刷新一次自己的Date头 */
+        loop->run_in_loop([loop] {
+            refresh_date_header();
+            loop->run_every(std::chrono::seconds(1), refresh_date_header);
+        });
+    }
+}
+
+void HttpServer::on_connection(const tcp_conn_ptr& conn)
+{
+    if (conn->connected())
+    {
+        conn->set_context(Session{HttpContext(max_header_size_, max_body_size_, &body_callback_),
+            conn->timer_wheel(), TimerWheel::Node(), kNoTimeout, false, nullptr, nullptr, h2c_});
+        Session* session = std::any_cast<Session>(conn->get_mutable_context());
+        /* 节点在连接断开时取消，所以回调中的裸指针一直有效 */
+        session->timeout.callback = [this, c = conn.get()] { on_timeout(c); };
+        update_timeout_(conn.get(), session, false);
+    }
+    else if (Session* session = std::any_cast<Session>(conn->get_mutable_context()))
+    {
+        session->wheel->cancel(&session->timeout);
+        if (session->websocket)
+        {
+            session->websocket->on_disconnected();
+        }
+    }
+}
+
+/**
+ *  一次处理buffer中所有完整的请求（HTTP/1.1 pipelining），响应按请求顺序直接序列化到连接的输出缓冲区，最后只send一次
+ *  出错或者某个响应要求关闭连接时，先发送前面已经生成的响应，后面的请求丢弃
+ *  发送不完的响应积压到kMaxPendingOutput时停止读取，剩下的请求等输出缓冲区发送完再处理
+ */
+void HttpServer::on_message(const tcp_conn_ptr& conn, Buffer& buffer)
+{
+    /* 已经决定关闭连接，之后到达的数据都丢弃 */
+    if (!conn->connected())
+    {
+        buffer.retrieve_all();
+        return;
+    }
+
+    Session* session = std::any_cast<Session>(conn->get_mutable_context());
+    if (session->websocket)
+    {
+        session->websocket->on_message(conn, buffer);
+        return;
+    }
+    if (session->http2)
+    {
+        update_http2_(conn.get(), session, session->http2->on_message(conn.get(), buffer));
+        return;
+    }
+    if (session->preface_possible)
+    {
+        /* prior knowledge：连接一开始就是HTTP/2 */
+        std::string_view preface = Http2Connection::kClientPreface;
+        size_t n = std::min(buffer.readable_bytes(), preface.size());
+        if (::memcmp(buffer.peek(), preface.data(), n) != 0)
+        {
+            session->preface_possible = false;
+        }
+        else if (n < preface.size())
+        {
+            update_timeout_(conn.get(), session, false);
+            return;
+        }
+        else
+        {
+            session->preface_possible = false;
+            new_http2_(session);
+            bool ok = session->http2->start(conn.get()) && session->http2->on_message(conn.get(), buffer);
+            update_http2_(conn.get(), session, ok);
+            return;
+        }
+    }
+    HttpContext* context = &session->context;
+    if (context->paused() || session->throttled)
+    {
+        /* 数据留在buffer中，等缓存的响应到达或者输出缓冲区发送完后再处理 */
+        return;
+    }
+
+    Buffer& output = *conn->output_buffer();
+    bool close = false;
+    bool new_request = false;
+    bool throttled;
+    do
+    {
+        throttled = false;
+        while (!close)
+        {
+            if (output.readable_bytes() >= kMaxPendingOutput)
+            {
+                throttled = true;
+                break;
+            }
+
+            if (!context->parse_request(buffer, timer_clock::now()))
+            {
+                output.append(http_status_line(kHttp11, context->error_status()));
+                output.append("Connection: close\r\n\r\n");
+                buffer.retrieve_all();
+                close = true;
+            }
+            else if (context->gotall())
+            {
+                if (!websockets_.empty() && upgrade_websocket_(conn, session, buffer))
+                {
+                    return;
+                }
+                if (h2c_ && upgrade_h2c_(conn, session, buffer))
+                {
+                    return;
+                }
+                close = on_request(conn, context);
+                if (context->paused())
+                {
+                    break;
+                }
+                context->finish_request(buffer);
+                new_request = true;
+                if (close)
+                {
+                    buffer.retrieve_all();
+                }
+            }
+            else
+            {
+                if (context->take_continue())
+                {
+                    output.append(http_status_line(kHttp11, 100));
+                    output.append("\r\n");
+                }
+                break;
+            }
+        }
+
+        conn->flush_output();
+        /* 积压的响应一次就发送完了，继续处理 */
+    } while (throttled && !conn->has_pending_output());
+
+    if (close)
+    {
+        close_after_flush_(conn.get(), session);
+        return;
+    }
+    if (throttled)
+    {
+        session->throttled = true;
+        conn->stop_read();
+    }
+    else if (context->paused())
+    {
+        conn->stop_read();
+    }
+    update_timeout_(conn.get(), session, new_request);
+}
+
+/* 积压的响应发送完了，继续处理留在输入缓冲区中的请求 */
+void HttpServer::on_write_complete(const tcp_conn_ptr& conn)
+{
+    Session* session = std::any_cast<Session>(conn->get_mutable_context());
+    if (session && session->http2)
+    {
+        update_http2_(conn.get(), session, session->http2->on_write_complete(conn.get()));
+        return;
+    }
+    if (session && session->throttled)
+    {
+        session->throttled = false;
+        conn->start_read();
+        on_message(conn, *conn->input_buffer());
+    }
+}
+
+/**
+ *  根据连接的状态设置超时：请求头的超时从第一个字节开始计算，之后到达的数据不会推迟，
+ *  请求体每次有数据到达都重新计时；阶段没有变化并且没有开始新的请求时不重设
+ */
+void HttpServer::update_timeout_(TcpConnection* conn, Session* session, bool new_request)
+{
+    session_phase phase;
+    if (session->context.paused())
+    {
+        phase = kNoTimeout;
+    }
+    else if (session->throttled)
+    {
+        phase = kBlocked;
+    }
+    else if (session->context.expect_body())
+    {
+        phase = kReadingBody;
+    }
+    else
+    {
+        phase = conn->input_buffer()->readable_bytes() > 0 ? kReadingHeaders : kIdle;
+    }
+
+    if (phase == session->phase && phase != kReadingBody && !new_request)
+    {
+        return;
+    }
+    session->phase = phase;
+    switch (phase)
+    {
+    case kNoTimeout:
+        session->wheel->cancel(&session->timeout);
+        break;
+    case kIdle:
+    case kBlocked:
+        session->wheel->schedule(&session->timeout, keep_alive_timeout_);
+        break;
+    case kReadingHeaders:
+    case kClosing:
+        session->wheel->schedule(&session->timeout, header_timeout_);
+        break;
+    case kReadingBody:
+        session->wheel->schedule(&session->timeout, body_timeout_);
+        break;
+    }
+}
+
+void HttpServer::on_timeout(TcpConnection* conn)
+{
+    if (conn->disconnected())
+    {
+        return;
+    }
+
+    Session* session = std::any_cast<Session>(conn->get_mutable_context());
+    /* HTTP/2连接的各个流和连接自己的超时由Http2Connection判断 */
+    if (session->phase == kIdle && session->http2 && conn->connected())
+    {
+        update_http2_(conn, session, session->http2->on_timeout(conn));
+        return;
+    }
+    switch (session->phase)
+    {
+    case kIdle:
+    case kClosing:
+        /* 最后的响应还在用sendfile发送，按空闲超时继续等 */
+        if (conn->has_pending_output())
+        {
+            session->wheel->schedule(&session->timeout, keep_alive_timeout_);
+            return;
+        }
+        conn->force_close();
+        break;
+    case kReadingHeaders:
+    case kReadingBody:
+        if (conn->connected())
+        {
+            Buffer& output = *conn->output_buffer();
+            output.append(http_status_line(kHttp11, 408));
+            output.append("Connection: close\r\n\r\n");
+            conn->input_buffer()->retrieve_all();
+            conn->flush_output();
+            close_after_flush_(conn, session);
+            break;
+        }
+        conn->force_close();
+        break;
+    case kNoTimeout:
+    case kBlocked:
+        conn->force_close();
+        break;
+    }
+}
+
+/**
+ *  请求是发往add_websocket路径的升级请求时完成握手，之后连接的数据都交给WebSocket解析，返回true；
+ *  握手不合法时回复400并关闭，也返回true；不是升级请求时返回false，按普通请求处理
+ */
+bool HttpServer::upgrade_websocket_(const tcp_conn_ptr& conn, Session* session, Buffer& buffer)
+{
+    const HttpRequest& req = session->context.request();
+    if (!iequals(req.get_header(kHeaderUpgrade), "websocket"))
+    {
+        return false;
+    }
+    thread_local std::string t_path;
+    t_path.assign(req.path());
+    auto it = websockets_.find(t_path);
+    if (it == websockets_.end())
+    {
+        return false;
+    }
+
+    Buffer& output = *conn->output_buffer();
+    std::string_view key = req.get_header("Sec-WebSocket-Key");
+    if (req.method() != HttpRequest::kGet || req.version() != kHttp11 || key.empty()
+        || req.get_header("Sec-WebSocket-Version") != "13")
+    {
+        output.append(http_status_line(kHttp11, 400));
+        output.append("Sec-WebSocket-Version: 13\r\nConnection: close\r\n\r\n");
+        buffer.retrieve_all();
+        conn->flush_output();
+        close_after_flush_(conn.get(), session);
+        return true;
+    }
+
+    output.append(http_status_line(kHttp11, 101));
+    output.append("Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ");
+    output.append(websocket_accept_key(key));
+    output.append("\r\n\r\n");
+    conn->flush_output();
+
+    /* HTTP的超时不再适用，WebSocket连接的存活由应用自己用ping判断；发出close帧后按kClosing等待对方关闭 */
+    session->wheel->cancel(&session->timeout);
+    session->phase = kNoTimeout;
+    session->websocket = std::make_shared<WebSocket>(conn, &it->second);
+    WebSocket* ws = session->websocket.get();
+    ws->set_close_sent_callback([this, c = conn.get()] {
+        /* 断开时节点已经取消，不能再放回时间轮 */
+        if (c->disconnected())
+        {
+            return;
+        }
+        Session* s = std::any_cast<Session>(c->get_mutable_context());
+        s->phase = kClosing;
+        s->wheel->schedule(&s->timeout, header_timeout_);
+    });
+    /* 正在执行的就是连接的message回调，不能在这里替换它 */
+    conn->get_loop()->queue_in_loop([conn, ws] {
+        conn->set_message_callback(std::bind(&WebSocket::on_message, ws, _1, _2));
+    });
+    if (it->second.on_open)
+    {
+        it->second.on_open(session->websocket, req);
+    }
+    session->context.finish_request(buffer);
+
+    /* 握手请求后面紧跟着的帧 */
+    if (buffer.readable_bytes() > 0)
+    {
+        ws->on_message(conn, buffer);
+    }
+    return true;
+}
+
+/**
+ *  带"Upgrade: h2c"和HTTP2-Settings的HTTP/1.1请求切换到HTTP/2（RFC 7540 3.2），返回true；
+ *  升级请求本身作为流1处理，响应以HTTP/2发送
+ */
+bool HttpServer::upgrade_h2c_(const tcp_conn_ptr& conn, Session* session, Buffer& buffer)
+{
+    HttpRequest& req = session->context.request();
+    std::string_view settings = req.get_header("HTTP2-Settings");
+    if (!iequals(req.get_header(kHeaderUpgrade), "h2c") || req.version() != kHttp11 || settings.empty())
+    {
+        return false;
+    }
+
+    Buffer& output = *conn->output_buffer();
+    output.append(http_status_line(kHttp11, 101));
+    output.append("Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    session->preface_possible = false;
+    new_http2_(session);
+    bool ok = session->http2->start(conn.get(), &req, settings);
+    session->context.finish_request(buffer);
+
+    /* 升级请求后面紧跟着的preface和帧 */
+    if (ok && buffer.readable_bytes() > 0)
+    {
+        ok = session->http2->on_message(conn.get(), buffer);
+    }
+    update_http2_(conn.get(), session, ok);
+    return true;
+}
+
+void HttpServer::new_http2_(Session* session)
+{
+    session->http2 = std::make_shared<Http2Connection>(&http2_dispatch_, max_header_size_, max_body_size_);
+    session->http2->set_timeouts(keep_alive_timeout_, header_timeout_, body_timeout_);
+}
+
+/* HTTP/2连接出错或者对方GOAWAY之后流都完成时关闭，否则等到Http2Connection最近的超时 */
+void HttpServer::update_http2_(TcpConnection* conn, Session* session, bool ok)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    if (!ok)
+    {
+        close_after_flush_(conn, session);
+        return;
+    }
+    session->phase = kIdle;
+    timer_clock::duration timeout = session->http2->deadline() - timer_clock::now();
+    session->wheel->schedule(&session->timeout, std::max(timeout, timer_clock::duration::zero()));
+}
+
+/* 发送完输出缓冲区后关闭写端，对方header_timeout内还不关闭连接就强制关闭 */
+void HttpServer::close_after_flush_(TcpConnection* conn, Session* session)
+{
+    conn->shutdown();
+    session->phase = kClosing;
+    session->wheel->schedule(&session->timeout, header_timeout_);
+}
+
+/* 生成一个响应追加到连接的输出缓冲区，返回是否需要关闭连接；等待缓存时暂停context，返回false */
+bool HttpServer::on_request(const tcp_conn_ptr& conn, HttpContext* context)
+{
+    const HttpRequest& req = context->request();
+    std::string_view connection = req.get_header(kHeaderConnection);
+    bool close = iequals(connection, "close") ||
+        (req.version() == kHttp10 && !iequals(connection, "keep-alive"));
+
+    /* 缓存的响应是按keep-alive序列化的 */
+    thread_local std::string t_key;
+    timer_clock::duration ttl{};
+    bool fill_cache = false;
+    if (!close && req.method() == HttpRequest::kGet && !cached_routes_.empty())
+    {
+        if (context->resumed())
+        {
+            if (context->resumed_response())
+            {
+                send_cached_(conn, context->resumed_response());
+                return false;
+            }
+            /* 响应不能缓存，自己调用http回调 */
+        }
+        else
+        {
+            t_key.assign(req.path());
+            auto route = cached_routes_.find(t_key);
+            if (route != cached_routes_.end())
+            {
+                t_key.insert(0, req.method_string());
+                t_key.insert(req.method_string().size(), 1, ' ');
+                t_key.append(req.query());
+                HttpResponseCache::response_ptr cached;
+                switch (cache_.lookup(t_key, timer_clock::now(), &cached, conn->get_loop(), conn))
+                {
+                case HttpResponseCache::kHit:
+                    send_cached_(conn, cached);
+                    return false;
+                case HttpResponseCache::kWait:
+                    context->pause();
+                    return false;
+                case HttpResponseCache::kMiss:
+                    ttl = route->second;
+                    fill_cache = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* 每个IO线程复用一个响应对象，保留上次分配的内存 */
+    thread_local HttpResponse t_response(false);
+    t_response.reset(close);
+    if (!router_.compiled() || !router_.dispatch(context->request(), t_response))
+    {
+        http_callback_(req, t_response);
+    }
+
+    Buffer& output = *conn->output_buffer();
+    size_t before = output.readable_bytes();
+    bool with_body = req.method() != HttpRequest::kHead;
+    t_response.append_buffer(output, with_body);
+    if (with_body && t_response.has_file_body())
+    {
+        conn->send_file(t_response.holder(), t_response.file_fd(), t_response.file_offset(), t_response.file_length());
+    }
+    bool close_connection = t_response.close_connection();
+    if (fill_cache)
+    {
+        HttpResponseCache::response_ptr response;
+        if (t_response.status_code() == HttpResponse::k200Ok && !t_response.has_file_body() && !close_connection)
+        {
+            response = std::make_shared<const std::string>(output.peek() + before, output.readable_bytes() - before);
+        }
+        cache_.fill(t_key, std::move(response), timer_clock::now() + ttl);
+    }
+    /* 不要让线程局部的响应对象一直持有文件 */
+    t_response.reset(false);
+    return close_connection;
+}
+
+/* 其他连接生成了等待中的响应，在本连接的IO线程中继续处理暂停的请求 */
+void HttpServer::on_cache_ready(const tcp_conn_ptr& conn, const HttpResponseCache::response_ptr& response)
+{
+    Session* session = std::any_cast<Session>(conn->get_mutable_context());
+    if (session && session->context.paused())
+    {
+        session->context.resume(response);
+        conn->start_read();
+        on_message(conn, *conn->input_buffer());
+    }
+}
+
+/* 小响应复制到输出缓冲区，比单独一次send便宜；大响应直接引用缓存中的数据 */
+void HttpServer::send_cached_(const tcp_conn_ptr& conn, const HttpResponseCache::response_ptr& response)
+{
+    static constexpr size_t kInlineSize = 4096;
+    if (response->size() <= kInlineSize)
+    {
+        conn->output_buffer()->append(*response);
+    }
+    else
+    {
+        conn->send_shared(response, response->data(), response->size());
+    }
+}
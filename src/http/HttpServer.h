@@ -0,0 +1,125 @@
+#pragma once
+
+#include "src/TcpServer.h"
+#include "src/http/HttpRequest.h"
+#include "src/http/HttpResponse.h"
+#include "src/http/HttpContext.h"
+#include "src/http/HttpResponseCache.h"
+#include "src/http/HttpRouter.h"
+#include "src/http/WebSocket.h"
+#include "src/http/Http2Connection.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+/**
+ *  HTTP/1.x服务器，需要链接mini_muduo_http
+ *  http回调在连接所属的IO线程中执行，request只在回调返回之前有效
+ *
+ *  请求体不超过max_body_size时完整地放在request.body()中；
+ *  超过时如果设置了body回调，请求体分段交给body回调，全部到达后再调用http回调，否则回复413
+ *
+ *  router()中注册的路由在start时编译，请求先交给路由分发，没有匹配的路由时才调用http回调
+ *  cache_route的路径上的GET请求经过响应微缓存，ttl内相同path和query的请求不再调用http回调
+ *
+ *  add_websocket的路径上带"Upgrade: websocket"的请求完成握手后，连接交给WebSocket的帧解析，不再按HTTP处理
+ *
+ *  enable_h2c之后同一端口也接受明文HTTP/2：连接以HTTP/2的preface开头（prior knowledge），
+ *  或者请求带"Upgrade: h2c"时，连接交给Http2Connection，一个连接上的多个请求并发处理，
+ *  分发到相同的路由和http回调；HTTP/2的请求不经过响应缓存，三个超时按流和连接的进展计算（见Http2Connection）
+ *
+ *  连接的超时使用TcpServer每个IO线程的TimerWheel，每次请求重设超时不分配内存：
+ *  两个请求之间空闲超过keep_alive_timeout时关闭连接；
+ *  请求头从第一个字节起header_timeout内没有收完、请求体两次到达间隔超过body_timeout时回复408并关闭；
+ *  请求头超过max_header_size时回复431；未发送的响应积压太多时暂停读取和处理后面的请求，
+ *  所以每个连接占用的内存有上限
+ */
+class HttpServer
+{
+public:
+    using http_callback = std::function<void(const HttpRequest&, HttpResponse&)>;
+    using body_callback = http_body_callback;
+
+    static const size_t kDefaultMaxBodySize = 1024 * 1024;
+    static const size_t kDefaultMaxHeaderSize = 8 * 1024;
+
+    HttpServer(EventLoop* loop, std::string ip, uint16_t port);
+    /* 必须在base loop所在线程中析构 */
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    void set_http_callback(const http_callback& cb)
+    {
+        http_callback_ = cb;
+    }
+
+    /* 必须在start之前添加路由 */
+    HttpRouter& router() { return router_; }
+
+    /* 都必须在start之前设置 */
+    void set_body_callback(const body_callback& cb) { body_callback_ = cb; }
+    void set_max_body_size(size_t size) { max_body_size_ = size; }
+    void set_max_header_size(size_t size) { max_header_size_ = size; }
+    void set_keep_alive_timeout(timer_clock::duration timeout) { keep_alive_timeout_ = timeout; }
+    void set_header_timeout(timer_clock::duration timeout) { header_timeout_ = timeout; }
+    void set_body_timeout(timer_clock::duration timeout) { body_timeout_ = timeout; }
+
+    /**
+     *  缓存path（精确匹配）上GET请求的200响应ttl时间，按method、path和query区分；
+     *  同时缺失的相同请求只调用一次http回调，所以缓存路径的响应不能依赖其他请求头
+     *  要求关闭连接的请求和用send_file发送的响应不经过缓存
+     */
+    void cache_route(std::string path, timer_clock::duration ttl) { cached_routes_[std::move(path)] = ttl; }
+
+    /* 必须在start之前添加，on_message必须设置 */
+    void add_websocket(std::string path, WebSocket::Callbacks callbacks) { websockets_[std::move(path)] = std::move(callbacks); }
+
+    /* 必须在start之前设置 */
+    void enable_h2c(bool on = true) { h2c_ = on; }
+
+    /* 必须在base loop所在线程中调用 */
+    void start();
+    
+    void set_thread_num(int num_threads)
+    {
+        server_.set_thread_num(num_threads);
+    }
+
+    TcpServer* tcp_server() { return &server_; }
+    
+private:
+    struct Session;
+
+    void on_connection(const tcp_conn_ptr& conn);
+    void on_message(const tcp_conn_ptr& conn, Buffer& buffer);
+    void on_write_complete(const tcp_conn_ptr& conn);
+    bool on_request(const tcp_conn_ptr& conn, HttpContext* context);
+    void on_cache_ready(const tcp_conn_ptr& conn, const HttpResponseCache::response_ptr& response);
+    void on_timeout(TcpConnection* conn);
+    void send_cached_(const tcp_conn_ptr& conn, const HttpResponseCache::response_ptr& response);
+    void update_timeout_(TcpConnection* conn, Session* session, bool new_request);
+    void close_after_flush_(TcpConnection* conn, Session* session);
+    bool upgrade_websocket_(const tcp_conn_ptr& conn, Session* session, Buffer& buffer);
+    bool upgrade_h2c_(const tcp_conn_ptr& conn, Session* session, Buffer& buffer);
+    void new_http2_(Session* session);
+    void update_http2_(TcpConnection* conn, Session* session, bool ok);
+
+private:
+    TcpServer server_;
+    http_callback http_callback_;
+    HttpRouter router_;
+    body_callback body_callback_;
+    size_t max_body_size_;
+    size_t max_header_size_;
+    timer_clock::duration keep_alive_timeout_;
+    timer_clock::duration header_timeout_;
+    timer_clock::duration body_timeout_;
+    std::unordered_map<std::string, timer_clock::duration> cached_routes_;
+    HttpResponseCache cache_;
+    std::unordered_map<std::string, WebSocket::Callbacks> websockets_;
+    bool h2c_;
+    Http2Connection::handler http2_dispatch_;     /* 先路由再http回调，与HTTP/1.x相同 */
+};
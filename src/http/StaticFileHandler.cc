@@ -0,0 +1,471 @@
+#include "src/http/StaticFileHandler.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+
+struct StaticFileHandler::Entry
+{
+    std::string path;
+    int fd = -1;                    /* 小文件读完内容后就关闭，为-1 */
+    struct stat st;
+    std::string content;            /* 小文件的内容 */
+    std::string etag;
+    std::string last_modified;
+    std::string_view content_type;
+    timer_clock::time_point validated;
+
+    ~Entry()
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+};
+
+struct MimeType
+{
+    std::string_view extension;
+    std::string_view type;
+};
+
+const MimeType kMimeTypes[] = {
+    { "html", "text/html; charset=utf-8" },
+    { "htm", "text/html; charset=utf-8" },
+    { "css", "text/css; charset=utf-8" },
+    { "js", "text/javascript; charset=utf-8" },
+    { "json", "application/json" },
+    { "txt", "text/plain; charset=utf-8" },
+    { "xml", "application/xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "svg", "image/svg+xml" },
+    { "ico", "image/x-icon" },
+    { "webp", "image/webp" },
+    { "wasm", "application/wasm" },
+    { "pdf", "application/pdf" },
+    { "mp4", "video/mp4" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+};
+
+std::string_view mime_type(std::string_view path)
+{
+    size_t dot = path.rfind('.');
+    if (dot != std::string_view::npos && path.find('/', dot) == std::string_view::npos)
+    {
+        std::string_view extension = path.substr(dot + 1);
+        for (const auto& mime : kMimeTypes)
+        {
+            if (iequals(mime.extension, extension))
+            {
+                return mime.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* 百分号解码后追加到out，拒绝NUL和".."路径段 */
+bool decode_path(std::string_view path, std::string* out)
+{
+    if (path.empty() || path[0] != '/')
+    {
+        return false;
+    }
+
+    size_t start = out->size();
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        char c = path[i];
+        if (c == '%')
+        {
+            if (i + 2 >= path.size())
+            {
+                return false;
+            }
+            int high = hex_value(path[i + 1]);
+            int low = hex_value(path[i + 2]);
+            if (high < 0 || low < 0)
+            {
+                return false;
+            }
+            c = static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+        if (c == '\0')
+        {
+            return false;
+        }
+        out->push_back(c);
+    }
+
+    std::string_view decoded(out->data() + start, out->size() - start);
+    for (size_t pos = decoded.find(".."); pos != std::string_view::npos; pos = decoded.find("..", pos + 1))
+    {
+        bool segment_start = decoded[pos - 1] == '/';
+        bool segment_end = pos + 2 == decoded.size() || decoded[pos + 2] == '/';
+        if (segment_start && segment_end)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string format_http_date(time_t t)
+{
+    char buf[64];
+    struct tm tm;
+    ::gmtime_r(&t, &tm);
+    size_t n = ::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+bool parse_http_date(std::string_view value, time_t* t)
+{
+    char buf[64];
+    if (value.size() >= sizeof(buf))
+    {
+        return false;
+    }
+    ::memcpy(buf, value.data(), value.size());
+    buf[value.size()] = '\0';
+
+    struct tm tm;
+    ::memset(&tm, 0, sizeof(tm));
+    const char* end = ::strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end || *end != '\0')
+    {
+        return false;
+    }
+    *t = ::timegm(&tm);
+    return true;
+}
+
+/* If-None-Match的值是逗号分隔的ETag列表，比较时忽略弱校验前缀W/ */
+bool etag_matches(std::string_view list, std::string_view etag)
+{
+    while (!list.empty())
+    {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.size() > 2 && item[0] == 'W' && item[1] == '/')
+        {
+            item.remove_prefix(2);
+        }
+        if (item == "*" || item == etag)
+        {
+            return true;
+        }
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+bool parse_uint(std::string_view s, uint64_t* value)
+{
+    if (s.empty() || s.size() > 18)
+    {
+        return false;
+    }
+    uint64_t v = 0;
+    for (char c : s)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+    }
+    *value = v;
+    return true;
+}
+
+enum range_result { kRangeNone, kRangeOk, kRangeUnsatisfiable };
+
+/**
+ *  只支持单个范围："bytes=a-b"、"bytes=a-"、"bytes=-n"
+ *  多个范围或者格式不对时忽略Range，返回完整文件
+ */
+range_result parse_range(std::string_view value, uint64_t size, uint64_t* first, uint64_t* last)
+{
+    if (value.substr(0, 6) != "bytes=" || value.find(',') != std::string_view::npos)
+    {
+        return kRangeNone;
+    }
+    value.remove_prefix(6);
+    size_t dash = value.find('-');
+    if (dash == std::string_view::npos)
+    {
+        return kRangeNone;
+    }
+
+    std::string_view from = value.substr(0, dash);
+    std::string_view to = value.substr(dash + 1);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (from.empty())
+    {
+        /* 最后n个字节 */
+        if (!parse_uint(to, &b))
+        {
+            return kRangeNone;
+        }
+        if (b == 0 || size == 0)
+        {
+            return kRangeUnsatisfiable;
+        }
+        *first = b >= size ? 0 : size - b;
+        *last = size - 1;
+        return kRangeOk;
+    }
+
+    if (!parse_uint(from, &a) || (!to.empty() && (!parse_uint(to, &b) || b < a)))
+    {
+        return kRangeNone;
+    }
+    if (a >= size)
+    {
+        return kRangeUnsatisfiable;
+    }
+    *first = a;
+    *last = to.empty() || b >= size ? size - 1 : b;
+    return kRangeOk;
+}
+
+StaticFileHandler::StaticFileHandler(std::string root, size_t max_open_files, size_t small_file_size)
+    : root_(std::move(root))
+    , max_open_files_(max_open_files)
+    , small_file_size_(small_file_size)
+    , revalidate_interval_(std::chrono::seconds(1))
+{
+    while (!root_.empty() && root_.back() == '/')
+    {
+        root_.pop_back();
+    }
+}
+
+StaticFileHandler::~StaticFileHandler() = default;
+
+size_t StaticFileHandler::cached_files() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+std::shared_ptr<StaticFileHandler::Entry> StaticFileHandler::open_(const std::string& path) const
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->path = path;
+    entry->fd = fd;
+    if (::fstat(fd, &entry->st) < 0 || !S_ISREG(entry->st.st_mode))
+    {
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(entry->st.st_size);
+    if (size <= small_file_size_)
+    {
+        entry->content.resize(size);
+        ssize_t n = ::pread(fd, entry->content.data(), size, 0);
+        if (n != static_cast<ssize_t>(size))
+        {
+            return nullptr;
+        }
+        ::close(entry->fd);
+        entry->fd = -1;
+    }
+
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx%05lx\"",
+        static_cast<unsigned long>(entry->st.st_size),
+        static_cast<unsigned long>(entry->st.st_mtim.tv_sec),
+        static_cast<unsigned long>(entry->st.st_mtim.tv_nsec / 10000));
+    entry->etag = etag;
+    entry->last_modified = format_http_date(entry->st.st_mtim.tv_sec);
+    entry->content_type = mime_type(path);
+    entry->validated = timer_clock::now();
+    return entry;
+}
+
+/**
+ *  锁只保护lru_、index_和entry的validated，open、fstat、pread和stat都在锁外进行，
+ *  一个IO线程打开大文件或者读小文件内容时不会挡住其他IO线程的命中
+ */
+std::shared_ptr<const StaticFileHandler::Entry> StaticFileHandler::lookup_(const std::string& path)
+{
+    auto now = timer_clock::now();
+    std::shared_ptr<Entry> stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end())
+        {
+            std::shared_ptr<Entry> entry = *it->second;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            if (now - entry->validated < revalidate_interval_)
+            {
+                return entry;
+            }
+            stale = std::move(entry);
+        }
+    }
+
+    /* 过了有效期，文件没有变化就继续使用 */
+    struct stat st;
+    if (stale && ::stat(path.c_str(), &st) == 0 && st.st_ino == stale->st.st_ino && st.st_size == stale->st.st_size
+        && st.st_mtim.tv_sec == stale->st.st_mtim.tv_sec && st.st_mtim.tv_nsec == stale->st.st_mtim.tv_nsec)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stale->validated = now;
+        return stale;
+    }
+
+    std::shared_ptr<Entry> entry = open_(path);
+
+    /* 被挤出缓存的entry在锁外析构，关闭fd */
+    std::vector<std::shared_ptr<Entry>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(path);
+    if (it != index_.end())
+    {
+        /* 其他线程在锁外已经放入了新的entry，用它的，丢掉自己打开的 */
+        if (*it->second != stale && now - (*it->second)->validated < revalidate_interval_)
+        {
+            evicted.push_back(std::move(entry));
+            return *it->second;
+        }
+        evicted.push_back(std::move(*it->second));
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    if (!entry)
+    {
+        return nullptr;
+    }
+    lru_.push_front(entry);
+    index_.emplace(path, lru_.begin());
+    while (lru_.size() > max_open_files_)
+    {
+        index_.erase(lru_.back()->path);
+        evicted.push_back(std::move(lru_.back()));
+        lru_.pop_back();
+    }
+    return entry;
+}
+
+bool StaticFileHandler::handle(const HttpRequest& req, HttpResponse& resp)
+{
+    if (req.method() != HttpRequest::kGet && req.method() != HttpRequest::kHead)
+    {
+        return false;
+    }
+
+    /* 复用同一个字符串拼接文件路径，不分配内存 */
+    thread_local std::string t_path;
+    t_path.assign(root_);
+    if (!decode_path(req.path(), &t_path))
+    {
+        return false;
+    }
+    if (t_path.back() == '/')
+    {
+        t_path.append("index.html");
+    }
+
+    std::shared_ptr<const Entry> entry = lookup_(t_path);
+    if (!entry)
+    {
+        return false;
+    }
+
+    resp.set_version(kHttp11);
+    resp.add_header("ETag", entry->etag);
+    resp.add_header("Last-Modified", entry->last_modified);
+
+    /* If-None-Match优先于If-Modified-Since */
+    std::string_view if_none_match = req.get_header(kHeaderIfNoneMatch);
+    std::string_view if_modified_since = req.get_header(kHeaderIfModifiedSince);
+    time_t since = 0;
+    bool not_modified = !if_none_match.empty()
+        ? etag_matches(if_none_match, entry->etag)
+        : !if_modified_since.empty() && parse_http_date(if_modified_since, &since) && entry->st.st_mtim.tv_sec <= since;
+    if (not_modified)
+    {
+        resp.set_status_code(HttpResponse::k304NotModified);
+        return true;
+    }
+
+    uint64_t size = static_cast<uint64_t>(entry->st.st_size);
+    uint64_t first = 0;
+    uint64_t last = size ? size - 1 : 0;
+    range_result range = kRangeNone;
+    std::string_view range_header = req.get_header(kHeaderRange);
+    std::string_view if_range = req.get_header("If-Range");
+    if (!range_header.empty() && req.method() == HttpRequest::kGet
+        && (if_range.empty() || if_range == entry->etag || if_range == entry->last_modified))
+    {
+        range = parse_range(range_header, size, &first, &last);
+    }
+
+    resp.set_content_type(entry->content_type);
+    resp.add_header("Accept-Ranges", "bytes");
+    char content_range[96];
+    if (range == kRangeUnsatisfiable)
+    {
+        snprintf(content_range, sizeof(content_range), "bytes */%lu", static_cast<unsigned long>(size));
+        resp.set_status_code(HttpResponse::k416RangeNotSatisfiable);
+        resp.add_header("Content-Range", content_range);
+        return true;
+    }
+
+    if (range == kRangeOk)
+    {
+        snprintf(content_range, sizeof(content_range), "bytes %lu-%lu/%lu", static_cast<unsigned long>(first),
+            static_cast<unsigned long>(last), static_cast<unsigned long>(size));
+        resp.set_status_code(HttpResponse::k206PartialContent);
+        resp.add_header("Content-Range", content_range);
+    }
+    else
+    {
+        resp.set_status_code(HttpResponse::k200Ok);
+    }
+
+    size_t length = size ? static_cast<size_t>(last - first + 1) : 0;
+    if (entry->fd < 0)
+    {
+        resp.set_body_ref(entry, std::string_view(entry->content).substr(static_cast<size_t>(first), length));
+    }
+    else
+    {
+        resp.set_file_body(entry, entry->fd, static_cast<off_t>(first), length);
+    }
+    return true;
+}
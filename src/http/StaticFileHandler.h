@@ -0,0 +1,59 @@
+#pragma once
+
+#include "src/common.h"
+#include "src/http/HttpRequest.h"
+#include "src/http/HttpResponse.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ *  静态文件服务，在http回调中调用handle，可以被多个IO线程共享
+ *
+ *  打开的fd和stat结果保存在LRU缓存中，每隔revalidate_interval重新stat一次发现文件变化；
+ *  不超过small_file_size的文件内容也缓存在内存中，直接复制到输出缓冲区，
+ *  大文件通过TcpConnection::send_file用sendfile发送，不经过用户态
+ *  支持HEAD、单个Range（206/416）、If-None-Match和If-Modified-Since（304）
+ *
+ *  @code
+ *  StaticFileHandler files("/var/www");
+ *  server.set_http_callback([&](const HttpRequest& req, HttpResponse& resp) {
+ *      if (!files.handle(req, resp)) { ... 404 ... }
+ *  });
+ *  @endcode
+ */
+class StaticFileHandler
+{
+public:
+    explicit StaticFileHandler(std::string root, size_t max_open_files = 1024, size_t small_file_size = 32 * 1024);
+    ~StaticFileHandler();
+
+    StaticFileHandler(const StaticFileHandler&) = delete;
+    StaticFileHandler& operator=(const StaticFileHandler&) = delete;
+
+    void set_revalidate_interval(timer_clock::duration interval) { revalidate_interval_ = interval; }
+
+    /* 处理GET和HEAD，请求的不是root下的普通文件时返回false，不修改resp */
+    bool handle(const HttpRequest& req, HttpResponse& resp);
+
+    size_t cached_files() const;
+
+private:
+    struct Entry;
+    using entry_list = std::list<std::shared_ptr<Entry>>;
+
+    std::shared_ptr<const Entry> lookup_(const std::string& path);
+    std::shared_ptr<Entry> open_(const std::string& path) const;
+
+private:
+    std::string root_;
+    size_t max_open_files_;
+    size_t small_file_size_;
+    timer_clock::duration revalidate_interval_;
+    mutable std::mutex mutex_;
+    entry_list lru_;                                                /* 最近使用的在前面 */
+    std::unordered_map<std::string, entry_list::iterator> index_;   /* 文件路径 -> lru_中的位置 */
+};
@@ -0,0 +1,512 @@
+#include "src/http/WebSocket.h"
+#include "src/http/HttpRequest.h"
+#include "src/TcpConnection.h"
+#include "src/EventLoop.h"
+#include "src/Buffer.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* 只用于握手，数据量很小，不追求速度 */
+void sha1(const void* data, size_t len, unsigned char digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+    /* 补位后的消息：原始数据、0x80、若干0、64位的比特长度 */
+    std::string msg(static_cast<const char*>(data), len);
+    msg.push_back('\x80');
+    while (msg.size() % 64 != 56)
+    {
+        msg.push_back('\0');
+    }
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    for (int i = 7; i >= 0; --i)
+    {
+        msg.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+    }
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(msg.data());
+    for (size_t block = 0; block < msg.size(); block += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+        {
+            const unsigned char* q = p + block + i * 4;
+            w[i] = (uint32_t(q[0]) << 24) | (uint32_t(q[1]) << 16) | (uint32_t(q[2]) << 8) | uint32_t(q[3]);
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        digest[i * 4] = static_cast<unsigned char>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+    }
+}
+
+std::string base64_encode(const unsigned char* data, size_t len)
+{
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < len) n |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < len) n |= data[i + 2];
+        out.push_back(kAlphabet[(n >> 18) & 63]);
+        out.push_back(kAlphabet[(n >> 12) & 63]);
+        out.push_back(i + 1 < len ? kAlphabet[(n >> 6) & 63] : '=');
+        out.push_back(i + 2 < len ? kAlphabet[n & 63] : '=');
+    }
+    return out;
+}
+
+std::string websocket_accept_key(std::string_view key)
+{
+    static const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    std::string input(key);
+    input.append(kGuid);
+    unsigned char digest[20];
+    sha1(input.data(), input.size(), digest);
+    return base64_encode(digest, sizeof(digest));
+}
+
+void websocket_unmask(char* data, size_t len, const unsigned char mask[4])
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    uint32_t m;
+    ::memcpy(&m, mask, 4);
+    __m128i m128 = _mm_set1_epi32(static_cast<int>(m));
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(data + i);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), m128));
+    }
+#else
+    uint64_t m;
+    ::memcpy(&m, mask, 4);
+    ::memcpy(reinterpret_cast<char*>(&m) + 4, mask, 4);
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t v;
+        ::memcpy(&v, data + i, 8);
+        v ^= m;
+        ::memcpy(data + i, &v, 8);
+    }
+#endif
+    /* 前面每次处理的字节数都是4的倍数，剩下的部分仍然从mask[0]开始 */
+    for (; i < len; ++i)
+    {
+        data[i] = static_cast<char>(data[i] ^ mask[i & 3]);
+    }
+}
+
+bool is_valid_utf8(std::string_view data)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    const unsigned char* end = p + data.size();
+    while (p < end)
+    {
+        /* 大部分文本是ASCII，每次检查8字节 */
+        while (end - p >= 8)
+        {
+            uint64_t v;
+            ::memcpy(&v, p, 8);
+            if (v & 0x8080808080808080ULL)
+            {
+                break;
+            }
+            p += 8;
+        }
+        if (p == end)
+        {
+            break;
+        }
+
+        unsigned char c = *p;
+        if (c < 0x80)
+        {
+            ++p;
+            continue;
+        }
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;    /* 第二个字节的范围 */
+        if (c >= 0xC2 && c <= 0xDF)
+        {
+            n = 2;
+        }
+        else if (c >= 0xE0 && c <= 0xEF)
+        {
+            n = 3;
+            if (c == 0xE0) lo = 0xA0;           /* 超长编码 */
+            else if (c == 0xED) hi = 0x9F;      /* U+D800-U+DFFF */
+        }
+        else if (c >= 0xF0 && c <= 0xF4)
+        {
+            n = 4;
+            if (c == 0xF0) lo = 0x90;           /* 超长编码 */
+            else if (c == 0xF4) hi = 0x8F;      /* 超过U+10FFFF */
+        }
+        else
+        {
+            return false;
+        }
+        if (static_cast<size_t>(end - p) < n || p[1] < lo || p[1] > hi)
+        {
+            return false;
+        }
+        for (size_t i = 2; i < n; ++i)
+        {
+            if ((p[i] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        p += n;
+    }
+    return true;
+}
+
+/* 服务端的帧不加掩码，帧头最长10字节 */
+size_t make_frame_header(char* header, WebSocket::opcode op, size_t len)
+{
+    header[0] = static_cast<char>(0x80 | op);
+    if (len < 126)
+    {
+        header[1] = static_cast<char>(len);
+        return 2;
+    }
+    if (len <= 0xFFFF)
+    {
+        header[1] = 126;
+        header[2] = static_cast<char>(len >> 8);
+        header[3] = static_cast<char>(len);
+        return 4;
+    }
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+    {
+        header[2 + i] = static_cast<char>(static_cast<uint64_t>(len) >> ((7 - i) * 8));
+    }
+    return 10;
+}
+
+WebSocket::WebSocket(const tcp_conn_ptr& conn, const Callbacks* callbacks)
+    : conn_(conn)
+    , loop_(conn->get_loop())
+    , callbacks_(callbacks)
+    , max_message_size_(kDefaultMaxMessageSize)
+    , fragments_op_(kContinuation)
+    , in_callback_(false)
+    , close_sent_(false)
+    , closed_(false)
+{}
+
+void WebSocket::send(std::string_view data, opcode op)
+{
+    if (loop_->is_in_loop_thread())
+    {
+        if (tcp_conn_ptr conn = conn_.lock())
+        {
+            send_in_loop_(conn.get(), op, data);
+        }
+    }
+    else
+    {
+        loop_->run_in_loop([self = shared_from_this(), message = std::string(data), op] {
+            if (tcp_conn_ptr conn = self->conn_.lock())
+            {
+                self->send_in_loop_(conn.get(), op, message);
+            }
+        });
+    }
+}
+
+void WebSocket::send(Buffer* payload, opcode op)
+{
+    loop_->assert_in_loop_thread();
+    tcp_conn_ptr conn = conn_.lock();
+    if (!conn || close_sent_ || !conn->connected())
+    {
+        payload->retrieve_all();
+        return;
+    }
+    char header[10];
+    size_t n = make_frame_header(header, op, payload->readable_bytes());
+    payload->prepend(header, n);
+    /* 前面还有没发出去的帧时追加在它们后面，保持顺序 */
+    if (conn->output_buffer()->readable_bytes() > 0)
+    {
+        conn->output_buffer()->append(payload->peek(), payload->readable_bytes());
+        payload->retrieve_all();
+        if (!in_callback_)
+        {
+            conn->flush_output();
+        }
+    }
+    else
+    {
+        conn->send(payload);
+    }
+}
+
+void WebSocket::send_in_loop_(TcpConnection* conn, opcode op, std::string_view data)
+{
+    if (close_sent_ || !conn->connected())
+    {
+        return;
+    }
+    char header[10];
+    size_t n = make_frame_header(header, op, data.size());
+    Buffer& output = *conn->output_buffer();
+    output.append(header, n);
+    output.append(data);
+    if (!in_callback_)
+    {
+        conn->flush_output();
+    }
+}
+
+void WebSocket::close(uint16_t code, std::string_view reason)
+{
+    loop_->run_in_loop([self = shared_from_this(), code, reason = std::string(reason)] {
+        self->close_in_loop_(code, reason);
+    });
+}
+
+void WebSocket::close_in_loop_(uint16_t code, std::string_view reason)
+{
+    tcp_conn_ptr conn = conn_.lock();
+    if (!conn || close_sent_)
+    {
+        return;
+    }
+    char payload[125];
+    payload[0] = static_cast<char>(code >> 8);
+    payload[1] = static_cast<char>(code);
+    size_t len = std::min(reason.size(), sizeof(payload) - 2);
+    ::memcpy(payload + 2, reason.data(), len);
+    send_close_(conn.get(), std::string_view(payload, len + 2));
+}
+
+/* 发出close帧之后不再发送其他帧 */
+void WebSocket::send_close_(TcpConnection* conn, std::string_view payload)
+{
+    send_in_loop_(conn, kClose, payload);
+    close_sent_ = true;
+    if (close_sent_callback_)
+    {
+        close_sent_callback_();
+    }
+}
+
+/**
+ *  帧格式（RFC 6455 5.2）：
+ *  FIN|RSV1-3|opcode(4) MASK|len(7) [扩展长度16/64位] [mask 4字节] payload
+ *  客户端的帧必须带掩码；没有协商扩展，RSV必须为0
+ */
+void WebSocket::on_message(const tcp_conn_ptr& conn, Buffer& buf)
+{
+    if (closed_)
+    {
+        buf.retrieve_all();
+        return;
+    }
+
+    in_callback_ = true;
+    while (!closed_ && buf.readable_bytes() >= 2)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(buf.peek());
+        size_t available = buf.readable_bytes();
+        bool fin = p[0] & 0x80;
+        opcode op = static_cast<opcode>(p[0] & 0x0F);
+        uint64_t len = p[1] & 0x7F;
+        size_t header = 2;
+        if ((p[0] & 0x70) || !(p[1] & 0x80))
+        {
+            fail_(conn.get(), kProtocolError);
+            break;
+        }
+
+        if (len == 126)
+        {
+            if (available < 4)
+            {
+                break;
+            }
+            len = (uint64_t(p[2]) << 8) | p[3];
+            header = 4;
+        }
+        else if (len == 127)
+        {
+            if (available < 10)
+            {
+                break;
+            }
+            len = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                len = (len << 8) | p[2 + i];
+            }
+            header = 10;
+        }
+
+        /* 一个帧要完整地放在输入缓冲区中，所以先检查长度 */
+        if (len > max_message_size_ || fragments_.size() + len > max_message_size_)
+        {
+            fail_(conn.get(), kMessageTooBig);
+            break;
+        }
+        if (available < header + 4 + len)
+        {
+            break;
+        }
+
+        const unsigned char* mask = p + header;
+        char* payload = buf.peek() + header + 4;
+        size_t payload_len = static_cast<size_t>(len);
+        websocket_unmask(payload, payload_len, mask);
+        on_frame_(conn.get(), op, fin, std::string_view(payload, payload_len));
+        if (!closed_)
+        {
+            buf.retrieve(header + 4 + payload_len);
+        }
+    }
+    in_callback_ = false;
+
+    if (closed_)
+    {
+        buf.retrieve_all();
+    }
+    conn->flush_output();
+}
+
+void WebSocket::on_frame_(TcpConnection* conn, opcode op, bool fin, std::string_view payload)
+{
+    switch (op)
+    {
+    case kPing:
+    case kPong:
+    case kClose:
+        /* 控制帧不能分片，可以插在分片消息的中间 */
+        if (!fin || payload.size() > 125)
+        {
+            fail_(conn, kProtocolError);
+            return;
+        }
+        if (op == kPing)
+        {
+            send_in_loop_(conn, kPong, payload);
+        }
+        else if (op == kClose)
+        {
+            /* 对方先发起时回复同样的状态码，之后不再处理任何数据 */
+            if (!close_sent_)
+            {
+                send_close_(conn, payload.substr(0, std::min<size_t>(payload.size(), 2)));
+            }
+            closed_ = true;
+            /* 直接写进输出缓冲区的数据要先flush，否则shutdown会立即关闭写端 */
+            conn->flush_output();
+            conn->shutdown();
+        }
+        return;
+
+    case kText:
+    case kBinary:
+        if (fragments_op_ != kContinuation)
+        {
+            fail_(conn, kProtocolError);
+            return;
+        }
+        if (fin)
+        {
+            if (op == kText && !is_valid_utf8(payload))
+            {
+                fail_(conn, kInvalidPayloadData);
+                return;
+            }
+            callbacks_->on_message(shared_from_this(), payload, op);
+            return;
+        }
+        fragments_op_ = op;
+        fragments_.assign(payload);
+        return;
+
+    case kContinuation:
+        if (fragments_op_ == kContinuation)
+        {
+            fail_(conn, kProtocolError);
+            return;
+        }
+        fragments_.append(payload);
+        if (fin)
+        {
+            opcode message_op = fragments_op_;
+            fragments_op_ = kContinuation;
+            if (message_op == kText && !is_valid_utf8(fragments_))
+            {
+                fail_(conn, kInvalidPayloadData);
+                return;
+            }
+            callbacks_->on_message(shared_from_this(), fragments_, message_op);
+            /* 保留容量给下一个分片消息 */
+            fragments_.clear();
+        }
+        return;
+    }
+
+    fail_(conn, kProtocolError);
+}
+
+/* 协议错误：发送close帧后关闭连接，不等对方回复 */
+void WebSocket::fail_(TcpConnection* conn, uint16_t code)
+{
+    if (!close_sent_)
+    {
+        char payload[2] = { static_cast<char>(code >> 8), static_cast<char>(code) };
+        send_close_(conn, std::string_view(payload, 2));
+    }
+    closed_ = true;
+    conn->flush_output();
+    conn->shutdown();
+}
+
+void WebSocket::on_disconnected()
+{
+    closed_ = true;
+    if (callbacks_->on_close)
+    {
+        callbacks_->on_close(shared_from_this());
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "src/common.h"
+
+#include <any>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class HttpRequest;
+
+/**
+ *  HttpServer升级出来的一个WebSocket连接（RFC 6455，只做服务端）
+ *
+ *  接收：等一个帧完整到达后在输入缓冲区中原地去掩码（SSE2每次16字节），
+ *  没有分片的消息直接以指向输入缓冲区的string_view交给消息回调，不拷贝；
+ *  分片的消息拼接到内部缓冲区，完整后再交给回调；文本消息交给回调之前检查UTF-8，不合法时以1007关闭；
+ *  ping自动回复pong，收到close时回复close并关闭连接
+ *
+ *  发送：在IO线程中帧头和数据直接写进连接的输出缓冲区，消息回调期间的发送合并成一次send；
+ *  send(Buffer*)利用Buffer的prepend空间在数据前面写帧头，整个Buffer原样发送；
+ *  在其他线程调用send时拷贝数据转到IO线程发送
+ */
+class WebSocket : public std::enable_shared_from_this<WebSocket>
+{
+public:
+    enum opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    /* 关闭帧的状态码 */
+    enum close_code
+    {
+        kNormalClosure = 1000,
+        kGoingAway = 1001,
+        kProtocolError = 1002,
+        kInvalidPayloadData = 1007,     /* 文本消息不是合法的UTF-8 */
+        kMessageTooBig = 1009,
+    };
+
+    using ptr = std::shared_ptr<WebSocket>;
+    using open_callback = std::function<void(const ptr&, const HttpRequest&)>;
+    /* message只在回调期间有效，op是kText或kBinary */
+    using message_callback = std::function<void(const ptr&, std::string_view message, opcode op)>;
+    using close_callback = std::function<void(const ptr&)>;
+
+    struct Callbacks
+    {
+        open_callback on_open;
+        message_callback on_message;
+        close_callback on_close;
+    };
+
+    static const size_t kDefaultMaxMessageSize = 1024 * 1024;
+
+    WebSocket(const tcp_conn_ptr& conn, const Callbacks* callbacks);
+
+    WebSocket(const WebSocket&) = delete;
+    WebSocket& operator=(const WebSocket&) = delete;
+
+    /* 可以在任意线程调用 */
+    void send(std::string_view data, opcode op = kText);
+    /* 只能在IO线程中调用：在payload前面写帧头后发送整个payload，之后payload为空 */
+    void send(Buffer* payload, opcode op = kBinary);
+    /* 发送close帧，等对方回复close后关闭连接，可以在任意线程调用 */
+    void close(uint16_t code = kNormalClosure, std::string_view reason = std::string_view());
+
+    /* 超过时以1009关闭连接，默认kDefaultMaxMessageSize */
+    void set_max_message_size(size_t size) { max_message_size_ = size; }
+    /* 发出close帧之后调用，HttpServer用它开始等待对方关闭的计时，只能在IO线程中设置 */
+    void set_close_sent_callback(std::function<void()> cb) { close_sent_callback_ = std::move(cb); }
+
+    /* 连接已经断开时返回nullptr */
+    tcp_conn_ptr connection() const { return conn_.lock(); }
+
+    void set_context(const std::any& context) { context_ = context; }
+    std::any* get_mutable_context() { return &context_; }
+
+    /* 作为连接的message回调，解析输入缓冲区中所有完整的帧 */
+    void on_message(const tcp_conn_ptr& conn, Buffer& buf);
+    /* 连接断开时由HttpServer调用 */
+    void on_disconnected();
+
+private:
+    void send_in_loop_(TcpConnection* conn, opcode op, std::string_view data);
+    void close_in_loop_(uint16_t code, std::string_view reason);
+    void on_frame_(TcpConnection* conn, opcode op, bool fin, std::string_view payload);
+    void fail_(TcpConnection* conn, uint16_t code);
+    void send_close_(TcpConnection* conn, std::string_view payload);
+
+private:
+    std::weak_ptr<TcpConnection> conn_;
+    EventLoop* loop_;
+    const Callbacks* callbacks_;
+    size_t max_message_size_;
+    std::string fragments_;         /* 分片消息已经到达的部分 */
+    opcode fragments_op_;           /* 正在接收分片消息时是kText或kBinary，否则是kContinuation */
+    bool in_callback_;              /* 正在on_message中，发送的帧最后统一flush */
+    bool close_sent_;
+    bool closed_;                   /* 已经决定关闭连接，之后到达的数据都丢弃 */
+    std::function<void()> close_sent_callback_;
+    std::any context_;
+};
+
+/* RFC 6455 4.2.2：握手响应中的Sec-WebSocket-Accept */
+std::string websocket_accept_key(std::string_view key);
+
+/* RFC 3629：拒绝超长编码、代理项和超过U+10FFFF的码点 */
+bool is_valid_utf8(std::string_view data);
+
+/* 用4字节的mask对data原地异或，mask从data[0]开始对齐 */
+void websocket_unmask(char* data, size_t len, const unsigned char mask[4]);
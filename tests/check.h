@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+
+/* 单元测试用的断言：失败时打印位置并计数，不中断后面的检查，main最后返回check_result() */
+inline int g_check_failures = 0;
+
+#define CHECK(cond)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if (!(cond))                                                            \
+        {                                                                       \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+            ++g_check_failures;                                                 \
+        }                                                                       \
+    } while (0)
+
+inline int check_result(const char* name)
+{
+    if (g_check_failures > 0)
+    {
+        printf("%s: %d check(s) failed\n", name, g_check_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
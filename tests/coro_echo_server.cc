@@ -0,0 +1,39 @@
+#include "src/coro/Coroutine.h"
+#include "src/EventLoop.h"
+#include "src/TcpServer.h"
+
+#include <string>
+
+/* 按行回显，每行之前等待100ms，连接空闲时协程挂起在read_until上 */
+CoTask echo_lines(CoConnection conn)
+{
+    while (true)
+    {
+        std::string_view line = co_await conn.read_until("\n");
+        if (line.empty())
+        {
+            break;
+        }
+
+        std::string reply(line);
+        co_await co_sleep_for(conn.get_loop(), std::chrono::milliseconds(100));
+        if (!co_await conn.write(reply))
+        {
+            break;
+        }
+    }
+    printf("connection %d done\n", conn.connection()->fd());
+}
+
+int main()
+{
+    printf("Coroutine Echo Server is running...\n");
+    EventLoop loop;
+    TcpServer server(&loop, "0.0.0.0", 10088);
+    co_serve(&server, echo_lines);
+    server.set_thread_num(2);
+    server.start();
+    loop.loop();
+
+    return EXIT_SUCCESS;
+}
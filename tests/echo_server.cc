@@ -3,27 +3,35 @@
 #include "src/common.h"
 #include "src/TcpConnection.h"
 #include "src/Buffer.h"
+#include "src/ListenerHandoff.h"
 
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
+#include <unistd.h>
 #include <functional>
-#include <list>
 
 using namespace std::placeholders;
 
 class EchoServer
 {
 public:
-    EchoServer(EventLoop* loop, std::string ip, uint16_t port, int idle_seconds)
-        : tcp_server_(loop, std::move(ip), port)
-        , idle_seconds_(idle_seconds)
+    EchoServer(EventLoop* loop, const SockAddr& listen_addr, int idle_seconds)
+        : tcp_server_(loop, listen_addr)
+    {
+        init(idle_seconds);
+    }
+
+    /* 接管上一个进程的监听fd */
+    EchoServer(EventLoop* loop, int listenfd, int idle_seconds)
+        : tcp_server_(loop, listenfd)
+    {
+        init(idle_seconds);
+    }
+
+    void init(int idle_seconds)
     {
         printf("EchoServer()\n");
         tcp_server_.set_connection_callback(std::bind(&EchoServer::on_connection, this, _1));
         tcp_server_.set_message_callback(std::bind(&EchoServer::send_message, this, _1, _2));
-        loop->run_every(std::chrono::seconds(1), std::bind(&EchoServer::on_timer, this));
-        dump_connection_list();
+        tcp_server_.set_idle_timeout(std::chrono::seconds(idle_seconds));
     }
 
     void start()
@@ -31,122 +39,78 @@ public:
         tcp_server_.start();
     }
 
+    TcpServer* tcp_server() { return &tcp_server_; }
+
 private:
     void on_connection(const tcp_conn_ptr& conn)
     {
         printf("on_connection()\n");
-        char buf[10];
-        auto client_addr = conn->peer_addr();
-        printf("connection from [%s : %d], socket fd = %d is %s\n",
-            inet_ntop(AF_INET, &client_addr.sin_addr, buf, sizeof(buf)),
-            ntohs(client_addr.sin_port),
+        printf("connection from [%s], socket fd = %d is %s\n",
+            conn->peer_addr().to_string().c_str(),
             conn->fd(),
             conn->connected() ? "up" : "down");
-
-        if (conn->connected())
-        {
-            Node node;
-            node.last_receive_time = timer_clock::now();
-            connection_list_.push_back(conn);
-            node.position = --connection_list_.end();
-            conn->set_context(node);
-        }
-        else
-        {
-            const Node& n = std::any_cast<const Node&>(conn->get_context());
-            connection_list_.erase(n.position);
-        }
-
-        dump_connection_list();
     }
 
     void send_message(const tcp_conn_ptr& conn, Buffer& buffer)
     {
         printf("send_message() by %d\n", conn->fd());
         conn->send(buffer.retrieve_all_as_string());
+    }
 
-        Node* node = std::any_cast<Node>(conn->get_mutable_context());
-        node->last_receive_time = timer_clock::now();
-        connection_list_.splice(connection_list_.end(), connection_list_, node->position);
+private:
+    TcpServer tcp_server_;
+};
 
-        dump_connection_list();
-    }
 
-    void on_timer()
+/**
+ *  echo_server [-u unix-socket-path] [-r handoff-path]
+ *  -u 监听AF_UNIX地址，路径以'@'开头时使用抽象地址
+ *  -r 通过handoff-path接管正在运行的echo_server的监听fd，旧进程在连接全部关闭（最多30秒）后退出
+ */
+int main(int argc, char* argv[])
+{
+    SockAddr listen_addr("0.0.0.0", 10086);
+    std::string handoff_path;
+    int opt;
+    while ((opt = getopt(argc, argv, "u:r:")) != -1)
     {
-        printf("on_timer()\n");
-        timer_clock::time_point now = timer_clock::now();
-        for (auto it = connection_list_.begin(); it != connection_list_.end();)
+        switch (opt)
         {
-            tcp_conn_ptr conn = it->lock();
-            if (conn)
-            {
-                Node* n = std::any_cast<Node>(conn->get_mutable_context());
-                auto age = now - n->last_receive_time;
-                if (age > idle_seconds_)    // 超时
-                {
-                    if (conn->connected())
-                    {
-                        printf("%d long time no data, shutdown it\n", conn->fd());
-                        conn->shutdown();
-                    }
-                }
-                else
-                {
-                    break;
-                }
-                ++it;
-            }
-            else
-            {
-                it = connection_list_.erase(it);    // 用的list，删除运算使指向删除位置的迭代器失效，但是不会失效其他迭代器
-            }
+        case 'u':
+            listen_addr = SockAddr::unix_path(optarg);
+            break;
+        case 'r':
+            handoff_path = optarg;
+            break;
+        default:
+            printf("usage: %s [-u unix-socket-path] [-r handoff-path]\n", argv[0]);
+            return EXIT_FAILURE;
         }
-        dump_connection_list();
     }
 
-    void dump_connection_list() const
+    printf("Echo Server is running...\n");
+    EventLoop loop;
+    std::unique_ptr<ListenerHandoff> handoff;
+    std::vector<int> fds;
+    if (!handoff_path.empty())
     {
-        printf("    size = %ld\n", connection_list_.size());
-        for (auto it = connection_list_.cbegin(); it != connection_list_.cend(); ++it)
-        {
-            tcp_conn_ptr conn = it->lock();
-            if (conn)
-            {
-                printf("    conn fd = %d ", conn->fd());
-                const Node& n = std::any_cast<const Node&>(conn->get_context());
-                printf(" time %ld\n", n.last_receive_time.time_since_epoch().count());
-            }
-            else
-            {
-                 printf("    expired\n");
-            }
-        }
+        handoff = std::make_unique<ListenerHandoff>(&loop, SockAddr::unix_path(handoff_path));
+        fds = handoff->take_over();
     }
 
-private:
-    using weak_conn_ptr = std::weak_ptr<TcpConnection>;
-    using weak_conn_list = std::list<weak_conn_ptr>;
-
-    struct Node
+    auto echo_server = fds.empty() ? std::make_unique<EchoServer>(&loop, listen_addr, 5)
+                                   : std::make_unique<EchoServer>(&loop, fds[0], 5);
+    echo_server->start();
+    if (handoff)
     {
-        timer_clock::time_point last_receive_time;
-        weak_conn_list::iterator position;
-    };
-
-    TcpServer tcp_server_;
-    std::chrono::seconds idle_seconds_;
-    weak_conn_list connection_list_;
-};
-
-
-int main(int argc, char* argv[])
-{
-    printf("Echo Server is running...\n");
-    EventLoop loop;
-    EchoServer echo_server(&loop, "0.0.0.0", 10086, 5);
-    echo_server.start();
+        handoff->confirm();
+        TcpServer* server = echo_server->tcp_server();
+        handoff->serve({server}, [&loop, server] {
+            printf("handed off, draining %zu connections\n", server->num_connections());
+            server->drain(std::chrono::seconds(30), [&loop] { loop.quit(); });
+        });
+    }
     loop.loop();
     
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
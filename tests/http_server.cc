@@ -1,547 +1,89 @@
 #include "src/common.h"
-#include "src/Buffer.h"
 #include "src/EventLoop.h"
-#include "src/TcpServer.h"
-#include "src/TcpConnection.h"
+#include "src/PreforkServer.h"
+#include "src/http/HttpServer.h"
+#include "src/http/StaticFileHandler.h"
 
+#include <atomic>
 #include <string>
-#include <map>
-#include <cassert>
-#include <iostream>
-#include <functional>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
+#include <unistd.h>
 
-enum http_version
-{
-    kUnknow, kHttp10, kHttp11
-};
+extern char favicon[555];
 
-std::string version_string(http_version v)
-{
-    switch (v)
-    {
-    case kHttp10:
-        return "HTTP/1.0";
-    case kHttp11:
-        return "HTTP/1.1";
-    default:
-        return "UNKNOW";
-    }
-}
+/* -d指定目录时，其他路径都先当作静态文件查找 */
+std::unique_ptr<StaticFileHandler> g_static_files;
 
-class HttpRequest
+/* 超过max_body_size的上传分段到达，这里只统计长度 */
+thread_local size_t t_streamed_bytes = 0;
+void on_body(const HttpRequest&, std::string_view data)
 {
-public:
-    enum http_method
-    {
-        kInvalid, kGet, kPost, kHead, kPut, kDelete
-    };
-
-    HttpRequest()
-        : method_(kInvalid)
-        , version_(kUnknow)
-    {}
-
-    HttpRequest(const HttpRequest&) = default;
-    HttpRequest& operator=(const HttpRequest&) = default;
-    // move
-    HttpRequest(HttpRequest&& rhs)
-        : method_(rhs.method_)
-        , version_(rhs.version_)
-        , path_(std::move(rhs.path_))
-        , query_(std::move(rhs.query_))
-        , receive_time_(rhs.receive_time_)
-        , headers_(std::move(rhs.headers_))
-    {}
-    
-    HttpRequest& operator=(HttpRequest&& rhs)
-    {
-        if (&rhs != this)
-        {
-            method_ = rhs.method_;
-            version_ = rhs.version_;
-            path_ = std::move(rhs.path_);
-            query_ = std::move(rhs.query_);
-            receive_time_ = rhs.receive_time_;
-            headers_ = std::move(rhs.headers_);
-        }
-        
-        return *this;
-    }
-
-    void set_version(http_version v) { version_ = v; }
-    http_version version() const { return version_; }
-    
-    http_method method() const { return method_; }
-    bool set_method(const char* start, const char* end)
-    {
-        assert(method_ == kInvalid);
-        std::string m(start, end);
-        if (m == "GET") { method_ = kGet; }
-        else if (m == "POST") { method_ = kPost; }
-        else if (m == "HEAD") { method_ = kHead; }
-        else if (m == "PUT") { method_ = kPut; }
-        else if (m == "DELETE") { method_ = kDelete; }
-        else { method_ = kInvalid; }
-        return method_ != kInvalid;
-    }
-
-    std::string method_string() const
-    {
-        switch (method_)
-        {
-        case kGet:
-            return "GET";
-        case kPost:
-            return "POST";
-        case kHead:
-            return "HEAD";
-        case kPut:
-            return "PUT";
-        case kDelete:
-            return "DELETE";
-        default:
-            return "UNKNOW";
-        }
-    }
-
-    void set_path(const char* start, const char* end) { path_.assign(start, end);; }
-    const std::string& path() const { return path_; }
-
-    void set_query(const char* start, const char* end) { query_.assign(start, end); }
-    const std::string& query() const { return query_; }
-
-    void set_receive_time(timer_clock::time_point tp) { receive_time_ = tp; }
-    timer_clock::time_point receive_time() const { return receive_time_; }
-    
-    void add_header(const char* start, const char* colon, const char* end)
-    {
-        std::string key(start, colon);
-        ++colon;
-        while (colon < end && isspace(*colon))
-        {
-            ++colon;
-        }
-        std::string value(colon, end);
-        while (!value.empty() && isspace(value[value.size()-1]))
-        {
-            value.resize(value.size() - 1);
-        }
-        headers_[std::move(key)] = std::move(value);
-    }
-
-    std::string get_header(const std::string& key) const
-    {
-        std::string result;
-        if (headers_.count(key))
-        {
-            result = headers_.at(key);
-        }
-        return result;
-    }
-
-    const std::map<std::string, std::string>&
-    headers() const { return headers_; }
-
-    void swap(HttpRequest& other)
-    {
-        std::swap(method_, other.method_);
-        std::swap(version_, other.version_);
-        path_.swap(other.path_);
-        query_.swap(other.query_);
-        std::swap(receive_time_, other.receive_time_);
-        headers_.swap(other.headers_);
-    }
-
-private:
-    http_method method_;
-    http_version version_;
-    std::string path_;
-    std::string query_;
-    timer_clock::time_point receive_time_;
-    std::map<std::string, std::string> headers_;
-};
+    t_streamed_bytes += data.size();
+}
 
+/* /generated经过响应缓存，这里记录http回调实际被调用的次数 */
+std::atomic<int> g_generated{0};
 
-class HttpResponse
+void on_index(const HttpRequest&, HttpResponse& resp)
 {
-public:
-    enum http_status_code
-    {
-        kUnknow,
-        k200Ok = 200,
-        k201MovedPerrmanently = 301,
-        k200BadRequest = 400,
-        k404NotFound = 404
-    };
-    
-    explicit HttpResponse(bool close)
-        : version_(http_version::kUnknow)
-        , status_code_(kUnknow)
-        , close_connection_(close)
-    {}
-
-    HttpResponse(const HttpResponse&) = default;
-    HttpResponse& operator=(const HttpResponse&) = default;
-    
-    HttpResponse(HttpResponse&& rhs)
-        : version_(rhs.version_)
-        , status_code_(rhs.status_code_)
-        , status_message_(std::move(rhs.status_message_))
-        , close_connection_(rhs.close_connection_)
-        , body_(std::move(rhs.body_))
-        , headers_(std::move(rhs.headers_))
-    {}
-
-    HttpResponse& operator=(HttpResponse&& rhs)
-    {
-        if (&rhs != this)
-        {
-            version_ = rhs.version_;
-            status_code_ = rhs.status_code_;
-            status_message_ = std::move(rhs.status_message_);
-            close_connection_ = rhs.close_connection_;
-            body_ = std::move(rhs.body_);
-            headers_ = std::move(rhs.headers_);
-        }
-        return *this;
-    }
-
-    void set_status_code(http_status_code code) { status_code_ = code; }
-    http_status_code status_code() const { return status_code_; }
-
-    void set_version(http_version v) { version_ = v; }
-    http_version version() const { return version_; }
-
-    void set_status_message(std::string message) { status_message_ = std::move(message); }
-    const std::string& status_message() const { return status_message_; }
-
-    void set_close_connection(bool on) { close_connection_ = on; }
-    bool close_connection() const { return close_connection_; }
-
-    void set_content_type(std::string content_type)
-    {
-        add_header("Content-Type", std::move(content_type));
-    }
-
-    void add_header(std::string key, std::string value)
-    {
-        headers_[std::move(key)] = std::move(value);
-    }
-
-    void set_body(std::string body)
-    {
-        body_ = std::move(body);
-    }
-
-    void append_buffer(Buffer& output) const
-    {
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%s %d ", version_string(version_).data(), status_code_);
-        output.append(buf);
-        output.append(status_message_);
-        output.append("\r\n");
-
-        if (close_connection_)
-        {
-            output.append("Connection: close\r\n");
-        }
-        else
-        {
-            snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
-            output.append(buf);
-            output.append("Connection: Keep-Alive\r\n");
-        }
-
-        for (const auto& header : headers_)
-        {
-            output.append(header.first);
-            output.append(": ");
-            output.append(header.second);
-            output.append("\r\n");    
-        }
-
-        output.append("\r\n");
-        output.append(body_);
-    }
-
-private:
-    http_version version_;
-    http_status_code status_code_;
-    std::string status_message_;
-    bool close_connection_;
-    std::string body_;
-    std::map<std::string, std::string> headers_;
-};
+    resp.set_version(kHttp11);
+    resp.set_status_code(HttpResponse::k200Ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("text/html");
+    resp.set_body("<html><head><title>This is title</title></head>"
+        "<body><h1>Hello</h1>Hello World!\n</body></html>");
+}
 
+/* favicon是静态数据，holder不需要释放任何东西，所有响应共用它，不再每次复制到body */
+const std::shared_ptr<const void> g_favicon_holder(static_cast<const void*>(favicon), [](const void*) {});
 
-class HttpContext
+void on_favicon(const HttpRequest&, HttpResponse& resp)
 {
-public:
-    enum http_request_parse_state
-    {
-        kExpectRequestLine,
-        kExpectHeaders,
-        kExpectBody,
-        kGotAll,
-    };
-
-    HttpContext()
-        : state_(kExpectRequestLine)
-    {}
-
-    bool gotall() const { return state_ == kGotAll; }
-
-    void reset()
-    {
-        state_ = kExpectRequestLine;
-        HttpRequest dummy;
-        request_.swap(dummy);
-    }
-
-    const HttpRequest& request() const { return request_; }
-    HttpRequest& request() { return request_; }
-
-    // return false if any error
-    bool parse_request(Buffer& buf, timer_clock::time_point receive_time)
-    {
-        bool ok = true;
-        bool has_more = true;
-
-        while (has_more)
-        {
-            if (state_ == kExpectRequestLine)
-            {
-                const char* crlf = buf.find_crlf();
-                if (crlf)
-                {
-                    ok = process_request_line(buf.peek(), crlf);
-                    if (ok)
-                    {
-                        request_.set_receive_time(receive_time);
-                        buf.retrieve_until(crlf + 2);
-                        state_ = kExpectHeaders;
-                    }
-                    else
-                    {
-                        has_more = false;
-                    }
-                }
-                else
-                {
-                    has_more = false;
-                }
-            }
-            else if (state_ == kExpectHeaders)
-            {
-                // 解析头部信息
-                const char* crlf = buf.find_crlf();
-                if (crlf)
-                {
-                    const char* colon = std::find(buf.peek(), crlf, ':');
-                    if (colon != crlf)
-                    {
-                        request_.add_header(buf.peek(), colon, crlf);
-                    }
-                    else    
-                    {
-                        // 空行
-                        state_ = kExpectBody;
-                    }
-                    buf.retrieve_until(crlf + 2);
-                }
-                else
-                {
-                    has_more = false;
-                }
-            }
-            else if (state_ == kExpectBody)
-            {
-                // TODO 处理BODY信息
-                state_ = kGotAll;
-            }
-            else if (state_ == kGotAll)
-            {
-                return true;
-            }
-            else
-            {
-                // printf("Unkonw state!");
-                return false;
-            }
-        }
-        
-        return ok;
-    }
-
-private:
-    // 解析请求行 "GET /AAA/BBB HTTP/1.1"
-    bool process_request_line(const char* begin, const char* end)
-    {
-        bool succeed = false;
-        const char* start = begin;
-        const char* space = std::find(start, end, ' ');
-        if (space != end && request_.set_method(start, space))
-        {
-            start = space + 1;
-            space = std::find(start, end, ' ');
-            if (space != end)
-            {
-                const char* question = std::find(start, space, '?');
-                if (question != space)
-                {
-                    request_.set_path(start, question);
-                    request_.set_query(question, space);
-                }
-                else
-                {
-                    request_.set_path(start, space);
-                }
-
-                start = space + 1;
-                succeed = end - start == 8 && std::equal(start, end - 1, "HTTP/1.");
-                if (succeed)
-                {
-                    if (*(end - 1) == '1')
-                    {
-                        request_.set_version(kHttp11);
-                    }
-                    else if (*(end - 1) == '0')
-                    {
-                        request_.set_version(kHttp10);
-                    }
-                    else
-                    {
-                        succeed = false;
-                    }
-                }
-            }
-        }
-        return succeed;
-    }
-
-private:
-    http_request_parse_state state_;
-    HttpRequest request_;
-};
-
+    resp.set_version(kHttp11);
+    resp.set_status_code(HttpResponse::k200Ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("image/png");
+    resp.set_body_ref(g_favicon_holder, std::string_view(favicon, sizeof(favicon)));
+}
 
-void default_http_callback(const HttpRequest&, HttpResponse& resp)
+void on_hello(const HttpRequest& req, HttpResponse& resp)
 {
     resp.set_version(kHttp11);
-    resp.set_status_code(HttpResponse::k404NotFound);
-    resp.set_status_message("Not Found");
-    resp.set_close_connection(true);
+    resp.set_status_code(HttpResponse::k200Ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("text/plain");
+    resp.set_body("hello " + std::string(req.param("name")) + "\n");
 }
 
-using namespace std::placeholders;
-class HttpServer
+void on_generated(const HttpRequest& req, HttpResponse& resp)
 {
-public:
-    using http_callback = std::function<void(const HttpRequest&, HttpResponse&)>;
-
-    HttpServer(EventLoop* loop, std::string ip, uint16_t port)
-        : server_(loop, std::move(ip), port)
-        , http_callback_(default_http_callback)
-    {
-        server_.set_connection_callback(std::bind(&HttpServer::on_connection, this, _1));
-        server_.set_message_callback(std::bind(&HttpServer::on_message, this, _1, _2));
-    }
-
-    void set_http_callback(const http_callback& cb)
-    {
-        http_callback_ = cb;
-    }
-
-    void start()
-    {
-        server_.start();
-    }
-    
-    void set_thread_num(int num_threads)
-    {
-        server_.set_thread_num(num_threads);
-    }
-    
-private:
-    void on_connection(const tcp_conn_ptr& conn)
-    {
-        // char buf[10];
-        // auto client_addr = conn->peer_addr();
-        // printf("connection from [%s : %d], socket fd = %d is %s\n",
-        //     inet_ntop(AF_INET, &client_addr.sin_addr, buf, sizeof(buf)),
-        //     ntohs(client_addr.sin_port),
-        //     conn->fd(),
-        //     conn->connected() ? "up" : "down");
-        
-        if (conn->connected())
-        {
-            conn->set_context(HttpContext());
-        }
-    }
-
-    void on_message(const tcp_conn_ptr& conn, Buffer& buffer)
-    {
-        HttpContext* context = std::any_cast<HttpContext>(conn->get_mutable_context());
-        if (!context->parse_request(buffer, timer_clock::now()))
-        {
-            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-            conn->shutdown();
-        }
-
-        if (context->gotall())
-        {
-            on_request(conn, context->request());
-            context->reset();
-        }
-    }
+    resp.set_version(kHttp11);
+    resp.set_status_code(HttpResponse::k200Ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("text/plain");
+    resp.set_body("generated " + std::to_string(++g_generated) + " times, query " + std::string(req.query()) + "\n");
+}
 
-    void on_request(const tcp_conn_ptr& conn, const HttpRequest& req)
-    {
-        const std::string& connection = req.get_header("Connection");
-        bool close = connection == "close" ||
-            (req.version() == kHttp10 && connection != "Keep-Alive");
-        HttpResponse response(close);
-        http_callback_(req, response);
-        Buffer buf;
-        response.append_buffer(buf);
-        conn->send(&buf);   // TODO: 直接发送，别额外复制
-        if (response.close_connection())
-        {
-            conn->shutdown();
-        }
-    }
+void on_upload(const HttpRequest& req, HttpResponse& resp)
+{
+    size_t received = req.body_streamed() ? t_streamed_bytes : req.body().size();
+    t_streamed_bytes = 0;
+    resp.set_version(kHttp11);
+    resp.set_status_code(HttpResponse::k200Ok);
+    resp.set_status_message("OK");
+    resp.set_content_type("text/plain");
+    resp.set_body("received " + std::to_string(received) + " bytes\n");
+}
 
-private:
-    TcpServer server_;
-    http_callback http_callback_;
-};
+/* /ws：把收到的消息原样发回 */
+void on_ws_message(const WebSocket::ptr& ws, std::string_view message, WebSocket::opcode op)
+{
+    ws->send(message, op);
+}
 
-extern char favicon[555];
+/* 没有匹配的路由时调用 */
 void on_request(const HttpRequest& req, HttpResponse& resp)
 {
-    if (req.path() == "/")
-    {
-        resp.set_version(kHttp11);
-        resp.set_status_code(HttpResponse::k200Ok);
-        resp.set_status_message("OK");
-        resp.set_content_type("text/html");
-        resp.add_header("Server", "Muduo");
-        resp.set_body("<html><head><title>This is title</title></head>"
-            "<body><h1>Hello</h1>Hello World!\n</body></html>");
-    }
-    else if (req.path() == "/favicon.ico")
-    {
-        resp.set_version(kHttp11);
-        resp.set_status_code(HttpResponse::k200Ok);
-        resp.set_status_message("OK");
-        resp.set_content_type("image/png");
-        resp.add_header("Server", "Muduo");
-        resp.set_body(std::string(favicon, sizeof(favicon)));
-    }
-    else
+    if (!g_static_files || !g_static_files->handle(req, resp))
     {
         resp.set_version(kHttp11);
         resp.set_status_code(HttpResponse::k404NotFound);
@@ -550,16 +92,73 @@ void on_request(const HttpRequest& req, HttpResponse& resp)
     }
 }
 
-int main()
+void run_server(int num_threads, PreforkServer::WorkerContext* context)
 {
-    printf("HTTP Server is running...\n");
     EventLoop loop;
     HttpServer server(&loop, "0.0.0.0", 10087);
     server.set_http_callback(on_request);
-    server.set_thread_num(0);
+    HttpRouter& router = server.router();
+    router.add(HttpRequest::kGet, "/", on_index);
+    router.add(HttpRequest::kGet, "/favicon.ico", on_favicon);
+    router.add(HttpRequest::kGet, "/hello/:name", on_hello);
+    router.add(HttpRequest::kGet, "/generated", on_generated);
+    router.add(HttpRequest::kPost, "/upload", on_upload);
+    server.add_websocket("/ws", WebSocket::Callbacks{nullptr, on_ws_message, nullptr});
+    server.enable_h2c();
+    server.set_body_callback(on_body);
+    server.cache_route("/generated", std::chrono::seconds(1));
+    server.set_thread_num(num_threads);
     server.start();
+    if (context)
+    {
+        context->report_every(server.tcp_server(), std::chrono::seconds(1));
+    }
     // loop.run_after(std::chrono::seconds(15), [&]() {loop.quit();});
     loop.loop();
+}
+
+/**
+ *  http_server [-t threads] [-p processes] [-d directory]
+ *  -t 每个进程的IO线程数，默认0（只用base loop）
+ *  -p 大于0时使用多进程模式，fork出这么多个worker，每个worker都用SO_REUSEPORT监听同一端口
+ *  -d 提供该目录下的静态文件
+ */
+int main(int argc, char* argv[])
+{
+    int num_threads = 0;
+    int num_processes = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:p:d:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            num_threads = atoi(optarg);
+            break;
+        case 'p':
+            num_processes = atoi(optarg);
+            break;
+        case 'd':
+            g_static_files = std::make_unique<StaticFileHandler>(optarg);
+            break;
+        default:
+            printf("usage: %s [-t threads] [-p processes] [-d directory]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("HTTP Server is running...\n");
+    if (num_processes > 0)
+    {
+        PreforkServer prefork(num_processes);
+        prefork.set_pin_per_core(true);
+        prefork.set_worker_main([num_threads](PreforkServer::WorkerContext& context) {
+            run_server(num_threads, &context);
+        });
+        return prefork.run();
+    }
+
+    run_server(num_threads, nullptr);
     return 0;
 }
 
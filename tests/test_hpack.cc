@@ -0,0 +1,247 @@
+#include "src/http/Hpack.h"
+#include "tests/check.h"
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using header_list = std::vector<std::pair<std::string, std::string>>;
+
+std::string from_hex(std::string_view hex)
+{
+    std::string out;
+    int high = -1;
+    for (char c : hex)
+    {
+        if (c == ' ')
+        {
+            continue;
+        }
+        int v = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+        if (high < 0)
+        {
+            high = v;
+        }
+        else
+        {
+            out.push_back(static_cast<char>(high << 4 | v));
+            high = -1;
+        }
+    }
+    return out;
+}
+
+/* 解码一个header block，解出来的请求头转换成name/value对，返回decode的结果 */
+HpackDecoder::result decode(HpackDecoder& decoder, std::string_view block, header_list* headers,
+    size_t max_list_size = SIZE_MAX)
+{
+    std::string arena;
+    std::vector<HpackDecoder::Field> fields;
+    HpackDecoder::result result = decoder.decode(block, max_list_size, &arena, &fields);
+    headers->clear();
+    for (const HpackDecoder::Field& f : fields)
+    {
+        headers->emplace_back(arena.substr(f.name_offset, f.name_length), arena.substr(f.value_offset, f.value_length));
+    }
+    return result;
+}
+
+/* RFC 7541 C.1 */
+void test_integer()
+{
+    std::string out;
+    hpack_encode_integer(&out, 0, 5, 10);
+    CHECK(out == from_hex("0a"));
+    out.clear();
+    hpack_encode_integer(&out, 0, 5, 1337);
+    CHECK(out == from_hex("1f9a0a"));
+    out.clear();
+    hpack_encode_integer(&out, 0, 8, 42);
+    CHECK(out == from_hex("2a"));
+
+    for (size_t value : {size_t(0), size_t(30), size_t(31), size_t(127), size_t(128), size_t(65535), size_t(UINT32_MAX)})
+    {
+        for (int prefix = 1; prefix <= 8; ++prefix)
+        {
+            std::string encoded;
+            hpack_encode_integer(&encoded, 0, prefix, value);
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(encoded.data());
+            size_t decoded = 0;
+            CHECK(hpack_decode_integer(p, p + encoded.size(), prefix, &decoded));
+            CHECK(decoded == value);
+            CHECK(p == reinterpret_cast<const unsigned char*>(encoded.data() + encoded.size()));
+        }
+    }
+
+    /* 数据不完整、超过2^32 */
+    std::string truncated = from_hex("1f9a");
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(truncated.data());
+    size_t value = 0;
+    CHECK(!hpack_decode_integer(p, p + truncated.size(), 5, &value));
+    std::string overflow = from_hex("1fffffffffff0f");
+    p = reinterpret_cast<const unsigned char*>(overflow.data());
+    CHECK(!hpack_decode_integer(p, p + overflow.size(), 5, &value));
+}
+
+/* RFC 7541 C.4.1 */
+void test_huffman()
+{
+    std::string encoded;
+    huffman_encode("www.example.com", &encoded);
+    CHECK(encoded == from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    CHECK(huffman_encoded_length("www.example.com") == encoded.size());
+
+    std::string decoded;
+    CHECK(huffman_decode(encoded, &decoded));
+    CHECK(decoded == "www.example.com");
+
+    std::string all;
+    for (int c = 0; c < 256; ++c)
+    {
+        all.push_back(static_cast<char>(c));
+    }
+    encoded.clear();
+    decoded.clear();
+    huffman_encode(all, &encoded);
+    CHECK(huffman_decode(encoded, &decoded));
+    CHECK(decoded == all);
+
+    /* 填充不是全1、超过7位的填充 */
+    decoded.clear();
+    CHECK(!huffman_decode(from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4fe"), &decoded));
+    decoded.clear();
+    CHECK(!huffman_decode(from_hex("ffff"), &decoded));
+}
+
+/* RFC 7541 C.3和C.4：同一个连接上的三个请求，动态表在请求之间保留 */
+void test_decoder_requests()
+{
+    const std::string_view blocks[2][3] = {
+        {
+            "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+            "8286 84be 5808 6e6f 2d63 6163 6865",
+            "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65",
+        },
+        {
+            "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+            "8286 84be 5886 a8eb 1064 9cbf",
+            "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf",
+        },
+    };
+    const header_list expected[3] = {
+        {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}},
+        {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"},
+            {"cache-control", "no-cache"}},
+        {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"}, {":authority", "www.example.com"},
+            {"custom-key", "custom-value"}},
+    };
+
+    for (const auto& requests : blocks)
+    {
+        HpackDecoder decoder;
+        for (size_t i = 0; i < 3; ++i)
+        {
+            header_list headers;
+            CHECK(decode(decoder, from_hex(requests[i]), &headers) == HpackDecoder::kOk);
+            CHECK(headers == expected[i]);
+        }
+    }
+}
+
+/* 编码器生成的header block（使用动态表和Huffman）能被解码器还原 */
+void test_round_trip()
+{
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    for (int round = 0; round < 3; ++round)
+    {
+        std::string block;
+        encoder.begin_block(&block);
+        encoder.encode_status(round == 0 ? 200 : 418, &block);
+        encoder.encode("content-type", "text/html", &block);
+        encoder.encode("x-request-id", std::to_string(round), &block, false);
+        encoder.encode("set-cookie", "a=" + std::string(static_cast<size_t>(round) * 100, 'b'), &block);
+
+        header_list headers;
+        CHECK(decode(decoder, block, &headers) == HpackDecoder::kOk);
+        header_list expected = {
+            {":status", round == 0 ? "200" : "418"},
+            {"content-type", "text/html"},
+            {"x-request-id", std::to_string(round)},
+            {"set-cookie", "a=" + std::string(static_cast<size_t>(round) * 100, 'b')},
+        };
+        CHECK(headers == expected);
+    }
+
+    /* 对方缩小动态表后，编码器先发送大小更新 */
+    encoder.set_max_table_size(0);
+    std::string block;
+    encoder.begin_block(&block);
+    encoder.encode("content-type", "text/html", &block);
+    CHECK(!block.empty() && (static_cast<unsigned char>(block[0]) & 0xE0) == 0x20);
+    header_list headers;
+    CHECK(decode(decoder, block, &headers) == HpackDecoder::kOk);
+    CHECK(headers.size() == 1 && headers[0].second == "text/html");
+}
+
+void test_decoder_errors()
+{
+    header_list headers;
+    /* 索引0、超出静态表和动态表的索引 */
+    HpackDecoder d1;
+    CHECK(decode(d1, from_hex("80"), &headers) == HpackDecoder::kError);
+    HpackDecoder d2;
+    CHECK(decode(d2, from_hex("be"), &headers) == HpackDecoder::kError);
+    /* 字符串长度超出header block */
+    HpackDecoder d3;
+    CHECK(decode(d3, from_hex("400a 6375 7374"), &headers) == HpackDecoder::kError);
+    /* 动态表大小更新超过SETTINGS_HEADER_TABLE_SIZE */
+    HpackDecoder d4;
+    CHECK(decode(d4, from_hex("3fe2 1f"), &headers) == HpackDecoder::kError);
+    /* 大小更新只能出现在header block开头 */
+    HpackDecoder d5;
+    CHECK(decode(d5, from_hex("82 20"), &headers) == HpackDecoder::kError);
+
+    /* 超过max_list_size时完整解码，动态表仍然同步 */
+    HpackDecoder d6;
+    CHECK(decode(d6, from_hex("8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d"), &headers, 40)
+        == HpackDecoder::kListTooLarge);
+    CHECK(decode(d6, from_hex("be"), &headers) == HpackDecoder::kOk);
+    CHECK(headers.size() == 1 && headers[0].first == ":authority" && headers[0].second == "www.example.com");
+}
+
+void test_table()
+{
+    HpackTable table(100);
+    std::string_view name, value;
+    CHECK(table.lookup(2, &name, &value) && name == ":method" && value == "GET");
+    CHECK(!table.lookup(0, &name, &value));
+    CHECK(!table.lookup(HpackTable::kStaticTableSize + 1, &name, &value));
+
+    table.add("a", "1");        /* 34字节 */
+    table.add("b", "2");
+    CHECK(table.count() == 2 && table.size() == 68);
+    CHECK(table.lookup(62, &name, &value) && name == "b");
+    table.add("c", "3");        /* 超过100，淘汰最旧的a */
+    CHECK(table.count() == 2);
+    bool exact = false;
+    CHECK(table.find("a", "1", &exact) == 0);
+    CHECK(table.find("c", "3", &exact) == 62 && exact);
+    CHECK(table.find(":method", "PUT", &exact) == 2 && !exact);
+
+    table.add("big", std::string(100, 'x'));
+    CHECK(table.count() == 0 && table.size() == 0);
+}
+
+int main()
+{
+    test_integer();
+    test_huffman();
+    test_decoder_requests();
+    test_round_trip();
+    test_decoder_errors();
+    test_table();
+    return check_result("test_hpack");
+}
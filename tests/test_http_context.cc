@@ -0,0 +1,213 @@
+#include "src/common.h"
+#include "src/Buffer.h"
+#include "src/http/HttpContext.h"
+#include "tests/check.h"
+
+#include <string>
+#include <string_view>
+
+const size_t kMaxHeaderSize = 8192;
+const size_t kMaxBodySize = 64;
+
+/* 一个连接上的解析过程：Buffer和HttpContext一起复用 */
+struct Parser
+{
+    explicit Parser(const http_body_callback* body_callback = nullptr)
+        : context(kMaxHeaderSize, kMaxBodySize, body_callback)
+    {}
+
+    /* 追加data后解析，返回parse_request的结果 */
+    bool feed(std::string_view data)
+    {
+        buf.append(data);
+        return context.parse_request(buf, timer_clock::now());
+    }
+
+    /* 一次只追加一个字节，检查增量解析 */
+    bool feed_bytewise(std::string_view data)
+    {
+        for (char c : data)
+        {
+            if (!feed(std::string_view(&c, 1)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Buffer buf;
+    HttpContext context;
+};
+
+/* 单独解析一个完整的请求，失败时返回状态码，成功时返回0 */
+int parse_status(std::string_view request)
+{
+    Parser parser;
+    if (!parser.feed(request))
+    {
+        return parser.context.error_status();
+    }
+    return parser.context.gotall() ? 0 : -1;
+}
+
+void test_get()
+{
+    Parser parser;
+    CHECK(parser.feed("GET /index.html?a=1 HTTP/1.1\r\nHost: example.com\r\nX-Custom:  v \r\n\r\n"));
+    CHECK(parser.context.gotall());
+    const HttpRequest& req = parser.context.request();
+    CHECK(req.method() == HttpRequest::kGet);
+    CHECK(req.version() == kHttp11);
+    CHECK(req.path() == "/index.html");
+    CHECK(req.query() == "?a=1");
+    CHECK(req.get_header(kHeaderHost) == "example.com");
+    CHECK(req.get_header("x-custom") == "v");
+    CHECK(req.body().empty());
+
+    /* 请求头不完整时等待 */
+    Parser partial;
+    CHECK(partial.feed("GET / HTTP/1.1\r\nHost: a\r\n"));
+    CHECK(!partial.context.gotall());
+    CHECK(partial.feed("\r\n"));
+    CHECK(partial.context.gotall());
+}
+
+void test_content_length()
+{
+    Parser parser;
+    CHECK(parser.feed("POST /upload HTTP/1.1\r\nContent-Length: 11\r\n\r\nhello"));
+    CHECK(!parser.context.gotall());
+    CHECK(parser.context.expect_body());
+    CHECK(parser.feed(" world"));
+    CHECK(parser.context.gotall());
+    CHECK(parser.context.request().body() == "hello world");
+
+    /* 后面紧跟着的请求在finish_request之后解析 */
+    CHECK(parser.feed("GET /next HTTP/1.1\r\n\r\n"));
+    parser.context.finish_request(parser.buf);
+    CHECK(parser.feed(""));
+    CHECK(parser.context.gotall());
+    CHECK(parser.context.request().path() == "/next");
+
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n") == 0);
+}
+
+void test_content_length_conflicts()
+{
+    /* 相同的重复Content-Length可以接受，不同的、空的、不是数字的都拒绝 */
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc") == 0);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\nabcd") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: \r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 3a\r\n\r\nabc") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: +3\r\n\r\nabc") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 3, 3\r\n\r\nabc") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n") == 400);
+    /* 超过max_body_size并且没有body回调 */
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 65\r\n\r\n") == 413);
+}
+
+void test_chunked()
+{
+    const std::string_view request =
+        "POST /chunked HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\n"
+        "6;name=value\r\n world\r\n"
+        "0\r\nX-Trailer: t\r\n\r\n"
+        "GET /after HTTP/1.1\r\n\r\n";
+
+    Parser whole;
+    CHECK(whole.feed(request));
+    CHECK(whole.context.gotall());
+    CHECK(whole.context.request().body() == "hello world");
+    CHECK(whole.context.request().path() == "/chunked");
+    whole.context.finish_request(whole.buf);
+    CHECK(whole.feed(""));
+    CHECK(whole.context.gotall());
+    CHECK(whole.context.request().path() == "/after");
+
+    /* 逐字节到达，结果相同 */
+    Parser bytewise;
+    CHECK(bytewise.feed_bytewise(request));
+    CHECK(bytewise.context.gotall());
+    CHECK(bytewise.context.request().body() == "hello world");
+
+    /* 大写的十六进制和没有trailer */
+    Parser upper;
+    CHECK(upper.feed("POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\nA\r\n0123456789\r\n0\r\n\r\n"));
+    CHECK(upper.context.gotall());
+    CHECK(upper.context.request().body() == "0123456789");
+}
+
+void test_chunked_errors()
+{
+    const std::string head = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    CHECK(parse_status(head + "zz\r\nhello\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status(head + "\r\n") == 400);
+    CHECK(parse_status(head + "5\nhello\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status(head + "5\r\nhelloXX0\r\n\r\n") == 400);
+    CHECK(parse_status(head + "5x\r\nhello\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status(head + "10000000000000000\r\n") == 400);
+    /* 拼接后超过max_body_size并且没有body回调 */
+    std::string big = head;
+    for (int i = 0; i < 3; ++i)
+    {
+        big += "20\r\n" + std::string(32, 'x') + "\r\n";
+    }
+    CHECK(parse_status(big + "0\r\n\r\n") == 413);
+}
+
+/* 超过max_body_size的chunked请求体改为流式交给body回调 */
+void test_chunked_streaming()
+{
+    std::string received;
+    http_body_callback on_body = [&received](const HttpRequest&, std::string_view data) { received.append(data); };
+    Parser parser(&on_body);
+    std::string chunk(40, 'y');
+    CHECK(parser.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n28\r\n" + chunk + "\r\n"));
+    CHECK(parser.feed("28\r\n" + chunk + "\r\n0\r\n\r\n"));
+    CHECK(parser.context.gotall());
+    CHECK(parser.context.request().body_streamed());
+    CHECK(received == chunk + chunk);
+}
+
+/* 请求走私：Transfer-Encoding和Content-Length同时出现、重复或者不认识的Transfer-Encoding都拒绝 */
+void test_transfer_encoding_smuggling()
+{
+    CHECK(parse_status("POST / HTTP/1.1\r\nContent-Length: 4\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 4\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: chunked, identity\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: xchunked\r\n\r\n0\r\n\r\n") == 400);
+    CHECK(parse_status("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n") == 0);
+}
+
+void test_header_limits()
+{
+    std::string huge = "GET / HTTP/1.1\r\nX-Big: " + std::string(kMaxHeaderSize, 'a') + "\r\n\r\n";
+    CHECK(parse_status(huge) == 431);
+
+    std::string many = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= HttpRequest::kMaxHeaders; ++i)
+    {
+        many += "X-H" + std::to_string(i) + ": v\r\n";
+    }
+    CHECK(parse_status(many + "\r\n") == 431);
+
+    CHECK(parse_status("GET / HTTP/1.1\r\nNoColon\r\n\r\n") == 400);
+    CHECK(parse_status("BREW / HTTP/1.1\r\n\r\n") == 400);
+}
+
+int main()
+{
+    test_get();
+    test_content_length();
+    test_content_length_conflicts();
+    test_chunked();
+    test_chunked_errors();
+    test_chunked_streaming();
+    test_transfer_encoding_smuggling();
+    test_header_limits();
+    return check_result("test_http_context");
+}
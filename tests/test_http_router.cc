@@ -0,0 +1,126 @@
+#include "src/http/HttpRouter.h"
+#include "tests/check.h"
+
+#include <string>
+#include <string_view>
+
+/* 每个路由的handler把自己的名字写进g_matched */
+std::string g_matched;
+
+HttpRouter::handler named(const char* name)
+{
+    return [name](const HttpRequest&, HttpResponse&) { g_matched = name; };
+}
+
+/* 分发method path，返回dispatch的结果；req和resp留给调用者检查参数和405 */
+bool route(const HttpRouter& router, std::string_view method, std::string_view path, HttpRequest* req, HttpResponse* resp)
+{
+    g_matched.clear();
+    req->reset();
+    req->set_method(method);
+    req->set_path(path);
+    resp->reset(false);
+    return router.dispatch(*req, *resp);
+}
+
+void test_routes()
+{
+    HttpRouter router;
+    router.add(HttpRequest::kGet, "/", named("root"));
+    router.add(HttpRequest::kGet, "/users", named("list users"));
+    router.add(HttpRequest::kPost, "/users", named("create user"));
+    router.add(HttpRequest::kGet, "/users/me", named("me"));
+    router.add(HttpRequest::kGet, "/users/:id", named("user"));
+    router.add(HttpRequest::kDelete, "/users/:id", named("delete user"));
+    router.add(HttpRequest::kGet, "/users/:id/posts/:post", named("post"));
+    router.add(HttpRequest::kGet, "/files/*path", named("file"));
+    router.add(HttpRequest::kGet, "/files/readme", named("readme"));
+    router.add(HttpRequest::kHead, "/head", named("head"));
+    router.compile();
+    CHECK(router.compiled());
+
+    HttpRequest req;
+    HttpResponse resp(false);
+
+    CHECK(route(router, "GET", "/", &req, &resp) && g_matched == "root");
+    CHECK(route(router, "GET", "/users", &req, &resp) && g_matched == "list users");
+    CHECK(route(router, "POST", "/users", &req, &resp) && g_matched == "create user");
+
+    /* 参数指向请求路径 */
+    std::string path = "/users/42";
+    CHECK(route(router, "GET", path, &req, &resp) && g_matched == "user");
+    CHECK(req.param("id") == "42");
+    CHECK(req.param("id").data() == path.data() + 7);
+    CHECK(req.num_params() == 1);
+    CHECK(route(router, "DELETE", "/users/7", &req, &resp) && g_matched == "delete user");
+    CHECK(req.param("id") == "7");
+
+    CHECK(route(router, "GET", "/users/42/posts/abc", &req, &resp) && g_matched == "post");
+    CHECK(req.param("id") == "42" && req.param("post") == "abc");
+    CHECK(req.num_params() == 2);
+
+    /* 静态路径优先于":name"，":name"优先于"*name" */
+    CHECK(route(router, "GET", "/users/me", &req, &resp) && g_matched == "me");
+    CHECK(req.num_params() == 0);
+    CHECK(route(router, "GET", "/files/readme", &req, &resp) && g_matched == "readme");
+    CHECK(route(router, "GET", "/files/a/b/c.txt", &req, &resp) && g_matched == "file");
+    CHECK(req.param("path") == "a/b/c.txt");
+
+    /* ":name"不匹配空的路径段，也不跨过'/' */
+    CHECK(!route(router, "GET", "/users/", &req, &resp));
+    CHECK(!route(router, "GET", "/users/42/", &req, &resp));
+    CHECK(!route(router, "GET", "/users/42/posts", &req, &resp));
+    CHECK(!route(router, "GET", "/nothing", &req, &resp));
+    CHECK(!route(router, "GET", "", &req, &resp));
+    CHECK(g_matched.empty());
+    CHECK(resp.status_code() == HttpResponse::kUnknow);
+}
+
+void test_methods()
+{
+    HttpRouter router;
+    router.add(HttpRequest::kGet, "/items/:id", named("get item"));
+    router.add(HttpRequest::kPut, "/items/:id", named("put item"));
+    router.add(HttpRequest::kHead, "/custom-head", named("head"));
+    router.add(HttpRequest::kGet, "/custom-head", named("get"));
+    router.compile();
+
+    HttpRequest req;
+    HttpResponse resp(false);
+
+    /* HEAD没有单独的路由时用GET的 */
+    CHECK(route(router, "HEAD", "/items/1", &req, &resp) && g_matched == "get item");
+    CHECK(route(router, "HEAD", "/custom-head", &req, &resp) && g_matched == "head");
+
+    /* 路径匹配但方法不匹配时回复405，并列出允许的方法 */
+    CHECK(route(router, "POST", "/items/1", &req, &resp));
+    CHECK(g_matched.empty());
+    CHECK(resp.status_code() == HttpResponse::k405MethodNotAllowed);
+    std::string_view headers = resp.headers();
+    CHECK(headers.find("Allow: ") != std::string_view::npos);
+    CHECK(headers.find("GET") != std::string_view::npos);
+    CHECK(headers.find("PUT") != std::string_view::npos);
+    CHECK(headers.find("POST") == std::string_view::npos);
+}
+
+/* 超过HttpRequest::kMaxParams的参数不会写出数组 */
+void test_many_params()
+{
+    HttpRouter router;
+    router.add(HttpRequest::kGet, "/:a/:b/:c/:d/:e/:f/:g/:h", named("eight"));
+    router.compile();
+
+    HttpRequest req;
+    HttpResponse resp(false);
+    CHECK(route(router, "GET", "/1/2/3/4/5/6/7/8", &req, &resp) && g_matched == "eight");
+    CHECK(req.num_params() == HttpRequest::kMaxParams);
+    CHECK(req.param("a") == "1" && req.param("h") == "8");
+}
+
+int main()
+{
+    test_routes();
+    test_methods();
+    test_many_params();
+    return check_result("test_http_router");
+}
@@ -0,0 +1,170 @@
+#include "src/http/StaticFileHandler.h"
+#include "tests/check.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <string_view>
+
+/* 不超过kSmallFileSize的文件内容缓存在内存中，更大的用sendfile发送，两种路径都要测 */
+const size_t kSmallFileSize = 64;
+
+std::string g_root;
+
+void write_file(const char* name, std::string_view content)
+{
+    std::string path = g_root + "/" + name;
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        handle_err("open");
+    if (::write(fd, content.data(), content.size()) != static_cast<ssize_t>(content.size()))
+        handle_err("write");
+    ::close(fd);
+}
+
+void remove_file(const char* name)
+{
+    std::string path = g_root + "/" + name;
+    ::unlink(path.c_str());
+}
+
+/* 用Range请求path，返回响应的状态码，resp留给调用者检查 */
+int get_range(StaticFileHandler& files, std::string_view path, std::string_view range, HttpResponse* resp,
+    std::string_view method = "GET", std::string_view if_range = std::string_view())
+{
+    HttpRequest req;
+    req.set_method(method);
+    req.set_version(kHttp11);
+    req.set_path(path);
+    if (!range.empty())
+    {
+        req.add_header("Range", range);
+    }
+    if (!if_range.empty())
+    {
+        req.add_header("If-Range", if_range);
+    }
+    resp->reset(false);
+    if (!files.handle(req, *resp))
+    {
+        return 0;
+    }
+    return resp->status_code();
+}
+
+bool has_header(const HttpResponse& resp, std::string_view line)
+{
+    return resp.headers().find(line) != std::string_view::npos;
+}
+
+/* 响应体的内容：内存中的直接取，文件响应体按offset和length从文件中读出来 */
+std::string body_of(const HttpResponse& resp)
+{
+    if (!resp.has_file_body())
+    {
+        return std::string(resp.body());
+    }
+    std::string body(resp.file_length(), '\0');
+    ssize_t n = ::pread(resp.file_fd(), &body[0], body.size(), resp.file_offset());
+    body.resize(n > 0 ? static_cast<size_t>(n) : 0);
+    return body;
+}
+
+void test_ranges(const char* path, const std::string& content)
+{
+    StaticFileHandler files(g_root, 16, kSmallFileSize);
+    HttpResponse resp(false);
+    const size_t size = content.size();
+    const std::string total = "/" + std::to_string(size) + "\r\n";
+
+    CHECK(get_range(files, path, "", &resp) == 200);
+    CHECK(has_header(resp, "Accept-Ranges: bytes"));
+    CHECK(body_of(resp) == content);
+
+    CHECK(get_range(files, path, "bytes=0-9", &resp) == 206);
+    CHECK(has_header(resp, "Content-Range: bytes 0-9" + total));
+    CHECK(body_of(resp) == content.substr(0, 10));
+
+    CHECK(get_range(files, path, "bytes=10-", &resp) == 206);
+    CHECK(has_header(resp, "Content-Range: bytes 10-" + std::to_string(size - 1) + total));
+    CHECK(body_of(resp) == content.substr(10));
+
+    /* 最后n个字节，n超过文件大小时是整个文件 */
+    CHECK(get_range(files, path, "bytes=-5", &resp) == 206);
+    CHECK(body_of(resp) == content.substr(size - 5));
+    CHECK(get_range(files, path, "bytes=-100000", &resp) == 206);
+    CHECK(has_header(resp, "Content-Range: bytes 0-" + std::to_string(size - 1) + total));
+    CHECK(body_of(resp) == content);
+
+    /* 结尾超过文件大小时截断到文件末尾 */
+    CHECK(get_range(files, path, "bytes=5-100000", &resp) == 206);
+    CHECK(body_of(resp) == content.substr(5));
+    CHECK(get_range(files, path, "bytes=7-7", &resp) == 206);
+    CHECK(body_of(resp) == content.substr(7, 1));
+
+    /* 起点不在文件中、后缀长度为0时回复416 */
+    CHECK(get_range(files, path, "bytes=" + std::to_string(size) + "-", &resp) == 416);
+    CHECK(has_header(resp, "Content-Range: bytes */" + std::to_string(size) + "\r\n"));
+    CHECK(get_range(files, path, "bytes=-0", &resp) == 416);
+
+    /* 格式不对、多个范围、反向的范围都忽略Range，返回整个文件 */
+    const char* ignored[] = {
+        "bytes=5-2", "bytes=0-1,5-6", "items=0-1", "bytes=", "bytes=-", "bytes=a-b",
+        "bytes=1-2x", "bytes= 1-2", "bytes=99999999999999999999999-",
+    };
+    for (const char* range : ignored)
+    {
+        CHECK(get_range(files, path, range, &resp) == 200);
+        CHECK(!has_header(resp, "Content-Range"));
+        CHECK(body_of(resp) == content);
+    }
+
+    /* HEAD不处理Range；If-Range与ETag不符时返回整个文件 */
+    CHECK(get_range(files, path, "bytes=0-9", &resp, "HEAD") == 200);
+    CHECK(get_range(files, path, "bytes=0-9", &resp, "GET", "\"stale\"") == 200);
+    CHECK(body_of(resp) == content);
+}
+
+void test_empty_file()
+{
+    StaticFileHandler files(g_root, 16, kSmallFileSize);
+    HttpResponse resp(false);
+    CHECK(get_range(files, "/empty.txt", "", &resp) == 200);
+    CHECK(body_of(resp).empty());
+    CHECK(get_range(files, "/empty.txt", "bytes=0-", &resp) == 416);
+    CHECK(get_range(files, "/empty.txt", "bytes=-1", &resp) == 416);
+    CHECK(get_range(files, "/missing.txt", "bytes=0-", &resp) == 0);
+}
+
+int main()
+{
+    char dir[] = "/tmp/test_static_file.XXXXXX";
+    if (!::mkdtemp(dir))
+        handle_err("mkdtemp");
+    g_root = dir;
+
+    std::string small;
+    for (int i = 0; i < 4; ++i)
+    {
+        small += "0123456789";
+    }
+    std::string large;
+    for (int i = 0; i < 100; ++i)
+    {
+        large += "abcdefghijklmnopqrstuvwxyz";
+    }
+    write_file("small.txt", small);
+    write_file("large.txt", large);
+    write_file("empty.txt", "");
+
+    test_ranges("/small.txt", small);
+    test_ranges("/large.txt", large);
+    test_empty_file();
+
+    remove_file("small.txt");
+    remove_file("large.txt");
+    remove_file("empty.txt");
+    ::rmdir(dir);
+    return check_result("test_static_file");
+}